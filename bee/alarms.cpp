@@ -1,82 +1,100 @@
 #include "alarms.hpp"
 
-#include <memory>
-#include <queue>
+#include <chrono>
+#include <vector>
 
-#include "queue.hpp"
-#include "time.hpp"
-
-using std::function;
-using std::make_shared;
-using std::optional;
-using std::pair;
-using std::shared_ptr;
 using std::vector;
 
-template <class T, class C = std::less<T>>
-using priority_queue = std::priority_queue<T, vector<T>, C>;
-
 namespace bee {
 
-namespace {
+Alarms::Alarms() : Alarms(Options{}) {}
 
-using item = std::pair<Span, std::function<void()>>;
+Alarms::Alarms(const Options& options)
+    : _wheel(Time::monotonic()),
+      _executor(
+        options.num_workers > 0 ? ThreadPool::create(options.num_workers)
+                                : nullptr),
+      _runner_thread([this]() { _run(); })
+{}
 
-void runner(shared_ptr<Queue<item>> q)
+Alarms::~Alarms()
 {
-  using v = pair<Time, function<void()>>;
-
-  struct cmp {
-    inline bool operator()(const v& p1, const v& p2) const
-    {
-      return p1.first > p2.first;
-    }
-  };
-
-  priority_queue<v, cmp> pqueue;
-
-  while (true) {
-    optional<Span> timeout;
-    if (!pqueue.empty()) { timeout = pqueue.top().first - Time::monotonic(); }
-
-    optional<item> el;
-    if (!timeout.has_value()) {
-      el = q->pop();
-      if (!el.has_value()) { break; }
-    } else if (*timeout > Span::zero()) {
-      auto r = q->pop_with_timeout(*timeout);
-      if (r.closed()) {
-        break;
-      } else if (!r.timed_out()) {
-        el = std::move(*r);
-      }
-    } else {
-      pqueue.top().second();
-      pqueue.pop();
-    }
+  {
+    std::unique_lock lk(_mutex);
+    _stopping = true;
+  }
+  _cv.notify_one();
+  _runner_thread.join();
+  _executor = nullptr;
+}
 
-    if (el.has_value()) {
-      auto trigger = Time::monotonic() + el->first;
-      pqueue.emplace(trigger, std::move(el->second));
+AlarmId Alarms::add_alarm(Span timeout, std::function<void()>&& fn)
+{
+  auto deadline = Time::monotonic() + timeout;
+  bool wake_runner = false;
+  AlarmId id;
+  {
+    std::unique_lock lk(_mutex);
+    id = _wheel.add(deadline, std::move(fn));
+    // The runner only needs to know when the next wake up moves earlier
+    if (!_wake_up_at.has_value() || deadline < *_wake_up_at) {
+      _wake_up_at = deadline;
+      wake_runner = true;
     }
   }
+  if (wake_runner) { _cv.notify_one(); }
+  return id;
 }
 
-} // namespace
+bool Alarms::cancel_alarm(AlarmId id)
+{
+  std::unique_lock lk(_mutex);
+  return _wheel.cancel(id);
+}
 
-Alarms::Alarms()
-    : _queue(make_shared<Queue<item>>()), _runner_thread(runner, _queue)
-{}
+LatencyHistogram Alarms::lateness() const
+{
+  std::unique_lock lk(_lateness_mutex);
+  return _lateness;
+}
 
-Alarms::~Alarms()
+void Alarms::_record_lateness(Span lateness)
 {
-  _queue->close();
-  _runner_thread.join();
+  std::unique_lock lk(_lateness_mutex);
+  _lateness.record(lateness);
 }
 
-void Alarms::add_alarm(Span timeout, std::function<void()>&& fn)
+void Alarms::_run()
 {
-  _queue->push(make_pair(timeout, std::move(fn)));
+  vector<TimerWheel::Expired> batch;
+  std::unique_lock lk(_mutex);
+  while (!_stopping) {
+    _wheel.expire(Time::monotonic(), batch);
+    if (!batch.empty()) {
+      lk.unlock();
+      for (auto& alarm : batch) {
+        if (_executor == nullptr) {
+          _record_lateness(Time::monotonic() - alarm.deadline);
+          alarm.fn();
+          continue;
+        }
+        _executor->execute([this, alarm = std::move(alarm)]() {
+          _record_lateness(Time::monotonic() - alarm.deadline);
+          alarm.fn();
+        });
+      }
+      batch.clear();
+      lk.lock();
+      continue;
+    }
+    _wake_up_at = _wheel.next_wakeup();
+    if (_wake_up_at.has_value()) {
+      auto timeout = *_wake_up_at - Time::monotonic();
+      _cv.wait_for(lk, std::chrono::nanoseconds(timeout.to_nanos()));
+    } else {
+      _cv.wait(lk);
+    }
+  }
 }
 
 } // namespace bee
@@ -1,24 +1,66 @@
 #pragma once
 
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <optional>
 #include <thread>
 
-#include "queue.hpp"
+#include "histogram.hpp"
 #include "span.hpp"
+#include "thread_pool.hpp"
+#include "time.hpp"
+#include "timer_wheel.hpp"
 
 namespace bee {
 
+using AlarmId = TimerId;
+
+// Runs callbacks after a timeout on a dedicated thread. Alarms are kept in a
+// TimerWheel, adding and cancelling them is O(1) and can be done from any
+// thread, including from the callbacks.
 struct Alarms {
  public:
+  struct Options {
+    // Threads the callbacks run on. With zero they run on the thread keeping
+    // the timers, one slow callback then delays every alarm after it. With
+    // more, alarms due together may run concurrently and in any order.
+    int num_workers = 0;
+  };
+
   Alarms();
+  explicit Alarms(const Options& options);
   ~Alarms();
 
-  void add_alarm(Span timeout, std::function<void()>&&);
+  AlarmId add_alarm(Span timeout, std::function<void()>&&);
+
+  // Returns false if the alarm already ran, or is about to: alarms due
+  // together are taken out in one batch and can't be cancelled by one another
+  bool cancel_alarm(AlarmId id);
+
+  // How late the alarms run so far started, from their deadline to the
+  // moment their callback was called
+  LatencyHistogram lateness() const;
 
  private:
-  using item = std::pair<Span, std::function<void()>>;
+  void _run();
+  void _record_lateness(Span lateness);
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  TimerWheel _wheel;
+
+  // When the runner thread wakes up, nullopt if it sleeps until notified
+  std::optional<Time> _wake_up_at;
+  bool _stopping = false;
+
+  mutable std::mutex _lateness_mutex;
+  LatencyHistogram _lateness;
+
+  // Declared after everything the callbacks touch, tasks still queued run
+  // when it is destroyed
+  ThreadPool::ptr _executor;
 
-  std::shared_ptr<Queue<item>> _queue;
   std::thread _runner_thread;
 };
 
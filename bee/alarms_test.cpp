@@ -0,0 +1,71 @@
+#include "alarms.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "format_vector.hpp"
+#include "testing.hpp"
+
+using std::vector;
+
+namespace bee {
+namespace {
+
+TEST(add_and_cancel)
+{
+  std::mutex mutex;
+  vector<int> fired;
+  std::atomic<bool> done = false;
+  auto start = Time::monotonic();
+  {
+    Alarms alarms;
+    auto record = [&](int v) {
+      return [&, v]() {
+        std::unique_lock lk(mutex);
+        fired.push_back(v);
+      };
+    };
+    alarms.add_alarm(Span::of_millis(20), record(20));
+    auto cancelled = alarms.add_alarm(Span::of_millis(10), record(10));
+    auto first = alarms.add_alarm(Span::of_millis(5), record(5));
+    alarms.add_alarm(Span::of_millis(30), [&]() { done = true; });
+    alarms.add_alarm(Span::of_hours(1), record(3600));
+    P("cancel: $", alarms.cancel_alarm(cancelled));
+    while (!done) { Span::of_millis(1).sleep(); }
+    P("cancel after firing: $", alarms.cancel_alarm(first));
+  }
+  P("fired: $", fired);
+  P("not early: $", Time::monotonic() - start >= Span::of_millis(30));
+}
+
+TEST(slow_callback)
+{
+  for (int num_workers : {0, 2}) {
+    std::mutex mutex;
+    vector<std::string> order;
+    std::atomic<int> done = 0;
+    auto push = [&](const char* event) {
+      std::unique_lock lk(mutex);
+      order.push_back(event);
+      done++;
+    };
+    Alarms alarms({.num_workers = num_workers});
+    alarms.add_alarm(Span::of_millis(1), [&]() {
+      Span::of_millis(100).sleep();
+      push("slow");
+    });
+    alarms.add_alarm(Span::of_millis(10), [&]() { push("fast"); });
+    while (done < 2) { Span::of_millis(1).sleep(); }
+    auto lateness = alarms.lateness();
+    P("num_workers:$ order:$ count:$ fast was delayed:$",
+      num_workers,
+      order,
+      lateness.count(),
+      lateness.max() > Span::of_millis(50));
+  }
+}
+
+} // namespace
+} // namespace bee
@@ -1,13 +1,73 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#if __has_include(<format>)
+#include <format>
+#endif
 #include <limits>
+#include <new>
 #include <numbers>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
 
+#include <sys/socket.h>
+
+#include "alarms.hpp"
+#include "binary_format.hpp"
+#include "cycle_clock.hpp"
+#include "data_buffer.hpp"
 #include "date.hpp"
+#include "event_loop.hpp"
+#include "fd.hpp"
+#include "file_reader.hpp"
+#include "file_writer.hpp"
 #include "float_of_string.hpp"
+#include "format_map.hpp"
+#include "format_vector.hpp"
+#include "histogram.hpp"
+#include "io_ring.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "parallel_map.hpp"
 #include "parse_string.hpp"
 #include "print.hpp"
+#include "queue.hpp"
+#include "ring_queue.hpp"
+#include "sampler.hpp"
+#include "scoped_tmp_dir.hpp"
+#include "simple_timer.hpp"
 #include "string_util.hpp"
+#include "thread_pool.hpp"
 #include "time.hpp"
+#include "timer_wheel.hpp"
 #include "to_string.hpp"
+#include "trace.hpp"
+
+namespace {
+
+std::atomic<int64_t> allocation_count = 0;
+
+} // namespace
+
+void* operator new(size_t size)
+{
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size)) { return ptr; }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
 
 namespace bee {
 namespace {
@@ -18,7 +78,8 @@ template <class T> [[clang::noinline]] auto do_not_optimize_away(T&& t)
   asm volatile("" : "+r"(p));
 }
 
-template <class T> void time_it(const char* name, T&& f)
+template <class T>
+void time_it(const char* name, T&& f, size_t bytes_per_call = 0)
 {
   const auto start = Time::now();
   int64_t repeat = 1;
@@ -26,6 +87,7 @@ template <class T> void time_it(const char* name, T&& f)
   auto output = f();
   auto threshold = Span::of_seconds(1.0);
   Span ellapsed = Span::zero();
+  const auto allocations_start = allocation_count.load();
   while (true) {
     for (int i = 0; i < repeat; i++) { do_not_optimize_away(f()); }
     count += repeat;
@@ -37,6 +99,13 @@ template <class T> void time_it(const char* name, T&& f)
   P("Name: $", name);
   P("output: $", output);
   P("{,}/call, calls:{}, total:{,}", ellapsed / count, count, ellapsed);
+  P("allocations/call: {.2f}",
+    double(allocation_count.load() - allocations_start) / count);
+  if (bytes_per_call > 0) {
+    P("throughput: {,.1f} MiB/s",
+      double(bytes_per_call * count) / ellapsed.to_float_seconds() /
+        (1 << 20));
+  }
 }
 
 void run_format_benchmark()
@@ -47,6 +116,17 @@ void run_format_benchmark()
   time_it("Convert pi to string using bee::to_string", []() {
     return bee::to_string(std::numbers::pi);
   });
+  time_it("Convert pi to shortest string using bee::to_string", []() {
+    return bee::to_string(std::numbers::pi, {.shortest = true});
+  });
+  time_it("Convert pi to shortest string using std::to_chars", []() {
+    char buffer[32];
+    auto res = std::to_chars(buffer, buffer + sizeof(buffer), std::numbers::pi);
+    return std::string(buffer, res.ptr);
+  });
+  time_it("Convert 1e-300/7 to shortest string using bee::to_string", []() {
+    return bee::to_string(1e-300 / 7, {.shortest = true});
+  });
 
   time_it("Convert int32_t(pi*100000000) to str using bee::to_string", []() {
     return bee::to_string(int32_t(std::numbers::pi * 100000000));
@@ -65,6 +145,92 @@ void run_format_benchmark()
     []() {
       return std::to_string(int64_t(std::numbers::pi * 1000000000000000000.0));
     });
+
+  // A typical log line, the format string is parsed at compile time by F and
+  // std::format, on every call by runtime_format and snprintf
+  static const std::string host = "db-replica-3";
+  int64_t request_id = 1234567;
+  double millis = std::numbers::pi;
+  time_it("Format a log line using F", [&]() {
+    return F("request $ to $ took {.3f}ms", request_id, host, millis);
+  });
+  time_it("Format a log line using F with runtime_format", [&]() {
+    return F(
+      runtime_format("request $ to $ took {.3f}ms"), request_id, host, millis);
+  });
+#if __has_include(<format>)
+  time_it("Format a log line using std::format", [&]() {
+    return std::format(
+      "request {} to {} took {:.3f}ms", request_id, host, millis);
+  });
+#endif
+  time_it("Format a log line using snprintf", [&]() {
+    char buffer[128];
+    int size = snprintf(
+      buffer,
+      sizeof(buffer),
+      "request %ld to %s took %.3fms",
+      request_id,
+      host.c_str(),
+      millis);
+    return std::string(buffer, size);
+  });
+  time_it("Format an int using F", [&]() { return F("$", request_id); });
+#if __has_include(<format>)
+  time_it("Format an int using std::format", [&]() {
+    return std::format("{}", request_id);
+  });
+#endif
+
+  // format_to appends in place, into a buffer reused across calls it does
+  // not allocate once the buffer is large enough
+  std::string buffer;
+  time_it("Format a log line using format_to into a reused buffer", [&]() {
+    buffer.clear();
+    format_to(buffer, "request $ to $ took {.3f}ms", request_id, host, millis);
+    return buffer.size();
+  });
+
+  std::vector<int64_t> values(100);
+  std::iota(values.begin(), values.end(), 1000000);
+  time_it("Append a vector<int64_t> of 100 using to_string", [&]() {
+    buffer.clear();
+    buffer += to_string(values);
+    return buffer.size();
+  });
+  time_it("Append a vector<int64_t> of 100 using format_to", [&]() {
+    buffer.clear();
+    format_to(buffer, values);
+    return buffer.size();
+  });
+
+  std::map<std::string, double> table;
+  for (int i = 0; i < 20; i++) { table.emplace(F("key$", i), i * 0.25); }
+  time_it("Append a map<string, double> of 20 using to_string", [&]() {
+    buffer.clear();
+    buffer += to_string(table);
+    return buffer.size();
+  });
+  time_it("Append a map<string, double> of 20 using format_to", [&]() {
+    buffer.clear();
+    format_to(buffer, table);
+    return buffer.size();
+  });
+
+  const Time time = Time::of_nanos_since_epoch(1700000000123456789);
+  const Span span = Span::of_micros(1234);
+  time_it("Append a Time and a Span using to_string", [&]() {
+    buffer.clear();
+    buffer += to_string(time);
+    buffer += to_string(span);
+    return buffer.size();
+  });
+  time_it("Append a Time and a Span using format_to", [&]() {
+    buffer.clear();
+    format_to(buffer, time);
+    format_to(buffer, span);
+    return buffer.size();
+  });
 }
 
 void run_date_benchmark()
@@ -99,15 +265,1027 @@ void run_parse_benchmark()
   });
 
   time_it("std::stoll", []() { return std::stoll("2012345678123123123"); });
+
+  time_it("bee::parse_string<int> short", []() {
+    return parse_string<int>("42");
+  });
+
+  // A CSV column of integers of mixed lengths, one per line
+  std::mt19937_64 gen(42);
+  std::string column;
+  constexpr int num_rows = 10000;
+  for (int i = 0; i < num_rows; i++) {
+    column += F(int64_t(gen() >> (gen() % 64)) - int64_t(gen() % 1000));
+    column += '\n';
+  }
+  time_it(
+    "Column with std::from_chars",
+    [&]() {
+      std::vector<int64_t> values;
+      const char* p = column.data();
+      const char* end = p + column.size();
+      while (p < end) {
+        int64_t value;
+        p = std::from_chars(p, end, value).ptr + 1;
+        values.push_back(value);
+      }
+      return values.size();
+    },
+    column.size());
+  time_it(
+    "Column with IntOfString::parse per line",
+    [&]() {
+      std::vector<int64_t> values;
+      std::string_view rest = column;
+      while (!rest.empty()) {
+        size_t pos = rest.find('\n');
+        values.push_back(
+          IntOfString<int64_t>::parse(rest.substr(0, pos)).value());
+        rest.remove_prefix(pos + 1);
+      }
+      return values.size();
+    },
+    column.size());
+  time_it(
+    "Column with IntOfString::parse_delimited",
+    [&]() {
+      return IntOfString<int64_t>::parse_delimited(column, '\n')
+        .value()
+        .size();
+    },
+    column.size());
 }
 
 void run_float_parse_benchmark()
 {
-  std::string num = "1.2347902837e89";
-  time_it("std::stod", [&]() { return std::stod(num); });
-  time_it("bee::FloatOfStringExperimental<double>", [&]() {
-    return bee::FloatOfString<double>::parse(num);
+  auto bench = [](const std::string& num) {
+    P("Parsing $", num);
+    time_it("std::stod", [&]() { return std::stod(num); });
+    time_it("std::from_chars", [&]() {
+      double value;
+      std::from_chars(num.data(), num.data() + num.size(), value);
+      return value;
+    });
+    time_it("bee::FloatOfString<double>", [&]() {
+      return bee::FloatOfString<double>::parse(num);
+    });
+  };
+  bench("1.2347902837e89");
+  bench("0.1");
+  bench("3.141592653589793");
+  // More digits than fit in 64 bits
+  bench("2.718281828459045235360287471352662497757");
+
+  // Random doubles in their shortest round trip form
+  std::mt19937_64 gen(42);
+  std::vector<std::string> nums;
+  while (nums.size() < 1000) {
+    auto value = std::bit_cast<double>(gen());
+    if (std::isnormal(value)) { nums.push_back(F("{r}", value)); }
+  }
+  P("Parsing 1000 random doubles");
+  time_it("std::stod", [&]() {
+    double sum = 0;
+    for (const auto& num : nums) { sum += std::stod(num); }
+    return sum;
   });
+  time_it("bee::FloatOfString<double>", [&]() {
+    double sum = 0;
+    for (const auto& num : nums) {
+      sum += bee::FloatOfString<double>::parse(num).value();
+    }
+    return sum;
+  });
+}
+
+void run_data_buffer_benchmark()
+{
+  constexpr size_t piece_size = 64;
+  constexpr size_t num_pieces = 1024;
+  const std::string piece(piece_size, 'x');
+  const auto* piece_data = reinterpret_cast<const std::byte*>(piece.data());
+
+  time_it(
+    "Small writes then consume using one Bytes per write",
+    [&]() {
+      std::deque<Bytes> blocks;
+      for (size_t i = 0; i < num_pieces; i++) {
+        blocks.emplace_back(piece_data, piece_data + piece_size);
+      }
+      size_t size = 0;
+      while (!blocks.empty()) {
+        size += blocks.front().size();
+        blocks.pop_front();
+      }
+      return size;
+    },
+    piece_size * num_pieces);
+
+  time_it(
+    "Small writes then consume using bee::DataBuffer",
+    [&]() {
+      DataBuffer buffer;
+      for (size_t i = 0; i < num_pieces; i++) {
+        buffer.write(piece_data, piece_size);
+      }
+      size_t size = buffer.size();
+      buffer.consume(size);
+      return size;
+    },
+    piece_size * num_pieces);
+
+  DataBuffer spliced;
+  time_it(
+    "Splice small DataBuffers into another",
+    [&]() {
+      for (size_t i = 0; i < num_pieces; i++) {
+        DataBuffer other;
+        other.write(piece_data, piece_size);
+        spliced.write(std::move(other));
+      }
+      size_t size = spliced.size();
+      spliced.consume(size);
+      return size;
+    },
+    piece_size * num_pieces);
+}
+
+void run_varint_decode_benchmark()
+{
+  constexpr int num_varints = 1000000;
+  DataBuffer encoded;
+  for (int i = 0; i < num_varints; i++) {
+    BinaryFormat::write_var_uint(encoded, uint64_t(i) * 7919);
+  }
+  DataBuffer input;
+  for (char c : encoded.to_string()) { input.write(&c, 1); }
+
+  time_it(
+    "Decode 1M varints from a DataBuffer built with 1 byte writes",
+    [&]() {
+      DataBuffer buffer = input;
+      uint64_t sum = 0;
+      for (int i = 0; i < num_varints; i++) {
+        sum += BinaryFormat::read_var_uint(buffer).value();
+      }
+      return sum;
+    },
+    input.size());
+}
+
+void run_line_reading_benchmark()
+{
+  std::string content;
+  for (int i = 0; i < 200000; i++) {
+    content += F("$ some log line with a few words and a number $\n", i, i * 7);
+  }
+  DataBuffer input;
+  for (size_t i = 0; i < content.size(); i += 4096) {
+    input.write(content.substr(i, 4096));
+  }
+
+  time_it(
+    "DataBuffer::read_line",
+    [&]() {
+      DataBuffer buffer = input;
+      size_t bytes = 0;
+      while (auto line = buffer.read_line()) { bytes += line->size(); }
+      return bytes;
+    },
+    content.size());
+
+  time_it(
+    "DataBuffer::read_line_view",
+    [&]() {
+      DataBuffer buffer = input;
+      size_t bytes = 0;
+      while (auto line = buffer.read_line_view()) { bytes += line->size(); }
+      return bytes;
+    },
+    content.size());
+
+  must(tmp_dir, ScopedTmpDir::create());
+  auto path = tmp_dir.path() / "lines.txt";
+  must_unit(FileWriter::write_file(path, content));
+
+  time_it(
+    "FileReader::read_line",
+    [&]() {
+      auto reader = FileReader::open(path).value();
+      size_t bytes = 0;
+      while (auto line = reader->read_line().value()) { bytes += line->size(); }
+      return bytes;
+    },
+    content.size());
+
+  time_it(
+    "FileReader::read_line_view",
+    [&]() {
+      auto reader = FileReader::open(path).value();
+      size_t bytes = 0;
+      while (auto line = reader->read_line_view().value()) {
+        bytes += line->size();
+      }
+      return bytes;
+    },
+    content.size());
+
+  time_it(
+    "MappedFile::read_line",
+    [&]() {
+      auto file = MappedFile::open(path).value();
+      size_t bytes = 0;
+      while (auto line = file->read_line().value()) { bytes += line->size(); }
+      return bytes;
+    },
+    content.size());
+
+  time_it(
+    "MappedFile::read_line_view",
+    [&]() {
+      auto file = MappedFile::open(path).value();
+      size_t bytes = 0;
+      while (auto line = file->read_line_view().value()) {
+        bytes += line->size();
+      }
+      return bytes;
+    },
+    content.size());
+}
+
+struct SyscallCounts {
+  int64_t reads = 0;
+  int64_t writes = 0;
+};
+
+// Read and write syscall counters kept by the kernel, readv/writev included
+SyscallCounts syscall_counts()
+{
+  SyscallCounts counts;
+  auto content = FileReader::read_file(FilePath("/proc/self/io"));
+  if (content.is_error()) { return counts; }
+  for (const auto& line : split_lines(*content)) {
+    if (auto v = remove_prefix(line, "syscr: ")) {
+      counts.reads = parse_string<int64_t>(*v).value_or(0);
+    } else if (auto v = remove_prefix(line, "syscw: ")) {
+      counts.writes = parse_string<int64_t>(*v).value_or(0);
+    }
+  }
+  return counts;
+}
+
+template <class F> void count_syscalls(const char* name, F&& f)
+{
+  auto overhead_start = syscall_counts();
+  auto start = syscall_counts();
+  f();
+  auto end = syscall_counts();
+  P("$: read syscalls:$ write syscalls:$",
+    name,
+    end.reads - start.reads - (start.reads - overhead_start.reads),
+    end.writes - start.writes - (start.writes - overhead_start.writes));
+}
+
+void run_scatter_gather_benchmark()
+{
+  constexpr size_t total_size = 1 << 20;
+  DataBuffer buffer;
+  for (size_t i = 0; i < total_size; i += 4096) {
+    // Force separate blocks so the writes have to gather them
+    DataBuffer block(std::string(4096, 'x'));
+    DataBuffer copy = buffer;
+    buffer.write(std::move(block));
+  }
+  auto dev_null = FD::open_file(FilePath("/dev/null"), FileMode::WriteOnly)
+                    .value()
+                    .to_shared();
+  auto dev_zero = FD::open_file(FilePath("/dev/zero")).value().to_shared();
+
+  auto write_per_block = [&]() {
+    size_t written = 0;
+    for (const auto& block : buffer) {
+      written += dev_null->write(block.data(), block.size()).value();
+    }
+    return written;
+  };
+  auto write_gathered = [&]() { return dev_null->write(buffer).value(); };
+  auto read_bounced = [&]() {
+    DataBuffer output;
+    std::byte bytes[1024];
+    while (output.size() < total_size) {
+      auto ret = dev_zero->read(bytes, sizeof(bytes)).value();
+      output.write(bytes, ret.bytes_read());
+    }
+    return output.size();
+  };
+  auto read_scattered = [&]() {
+    DataBuffer output;
+    return dev_zero->read(output, total_size).value().bytes_read();
+  };
+
+  count_syscalls("Write 1MiB one write per block", write_per_block);
+  count_syscalls("Write 1MiB with writev", write_gathered);
+  count_syscalls("Read 1MiB through a 1KiB bounce buffer", read_bounced);
+  count_syscalls("Read 1MiB with readv", read_scattered);
+
+  time_it("Write 1MiB one write per block", write_per_block, total_size);
+  time_it("Write 1MiB with writev", write_gathered, total_size);
+  time_it("Read 1MiB through a 1KiB bounce buffer", read_bounced, total_size);
+  time_it("Read 1MiB with readv", read_scattered, total_size);
+}
+
+void run_file_buffer_benchmark()
+{
+  constexpr size_t total_size = 16 << 20;
+  constexpr size_t chunk_size = 256;
+  const std::string chunk(chunk_size, 'x');
+  must(tmp_dir, ScopedTmpDir::create());
+  auto path = tmp_dir.path() / "data.bin";
+
+  auto write_file = [&](const IOBufferOptions& options) {
+    auto writer = FileWriter::create(path, options).value();
+    for (size_t i = 0; i < total_size; i += chunk_size) {
+      writer->write(chunk).value();
+    }
+    return total_size;
+  };
+  auto read_file = [&](const IOBufferOptions& options) {
+    auto reader = FileReader::open(path, options).value();
+    std::byte bytes[chunk_size];
+    size_t total = 0;
+    while (size_t ret = reader->read(bytes, chunk_size).value()) {
+      total += ret;
+    }
+    return total;
+  };
+
+  std::vector<std::pair<std::string, IOBufferOptions>> configs;
+  for (size_t capacity : {1 << 12, 1 << 13, 1 << 16, 1 << 18, 1 << 20}) {
+    configs.emplace_back(
+      F("{}KiB", capacity >> 10), IOBufferOptions{.capacity = capacity});
+  }
+  configs.emplace_back(
+    "adaptive 4KiB-4MiB",
+    IOBufferOptions{.capacity = 1 << 12, .adaptive = true});
+
+  for (const auto& [name, options] : configs) {
+    count_syscalls(
+      F("Write 16MiB buffer $", name).data(), [&]() { write_file(options); });
+    count_syscalls(
+      F("Read 16MiB buffer $", name).data(), [&]() { read_file(options); });
+  }
+  for (const auto& [name, options] : configs) {
+    time_it(
+      F("Write 16MiB buffer $", name).data(),
+      [&]() { return write_file(options); },
+      total_size);
+    time_it(
+      F("Read 16MiB buffer $", name).data(),
+      [&]() { return read_file(options); },
+      total_size);
+  }
+}
+
+void run_io_ring_benchmark()
+{
+  constexpr int num_pipes = 256;
+  constexpr size_t message_size = 512;
+  const std::string message(message_size, 'x');
+  std::vector<Pipe> pipes;
+  for (int i = 0; i < num_pipes; i++) {
+    auto pipe = Pipe::create().value();
+    pipe.read_fd->set_blocking(false).value();
+    pipe.write_fd->set_blocking(false).value();
+    pipes.push_back(std::move(pipe));
+  }
+
+  // One write and one read on every pipe per call
+  auto per_call = [&]() {
+    size_t bytes = 0;
+    DataBuffer input;
+    for (auto& pipe : pipes) { pipe.write_fd->write(message).value(); }
+    for (auto& pipe : pipes) {
+      bytes += pipe.read_fd->read(input, message_size).value().bytes_read();
+    }
+    return bytes;
+  };
+  std::vector<DataBuffer> inputs(num_pipes);
+  auto with_ring = [&](IoRing& ring) {
+    size_t bytes = 0;
+    for (int i = 0; i < num_pipes; i++) {
+      inputs[i].clear();
+      ring.write(
+        pipes[i].write_fd, DataBuffer(message), [](OrError<size_t>&& ret) {
+          ret.value();
+        });
+      ring.read(
+        pipes[i].read_fd,
+        inputs[i],
+        message_size,
+        [&](OrError<ReadResult>&& ret) { bytes += ret.value().bytes_read(); });
+    }
+    while (ring.pending() > 0) { ring.poll().value(); }
+    return bytes;
+  };
+  auto io_uring = IoRing::create(IoRing::Backend::IoUring, num_pipes * 2);
+  auto epoll = IoRing::create(IoRing::Backend::Epoll).value();
+
+  // Operations done through io_uring don't show up in these counters
+  count_syscalls("Per call read/write", per_call);
+  count_syscalls("IoRing epoll", [&]() { with_ring(*epoll); });
+
+  const size_t bytes_per_call = num_pipes * message_size;
+  P("$ pipes, $ ops per call", num_pipes, num_pipes * 2);
+  time_it("Per call read/write", per_call, bytes_per_call);
+  if (io_uring.is_ok()) {
+    time_it(
+      "IoRing io_uring",
+      [&]() { return with_ring(*io_uring.value()); },
+      bytes_per_call);
+  } else {
+    P("io_uring not available: $", io_uring.error());
+  }
+  time_it(
+    "IoRing epoll", [&]() { return with_ring(*epoll); }, bytes_per_call);
+}
+
+void print_latencies(const char* name, std::vector<Span>& latencies)
+{
+  std::sort(latencies.begin(), latencies.end());
+  auto at = [&](double p) {
+    return latencies[std::min<size_t>(
+      latencies.size() * p, latencies.size() - 1)];
+  };
+  P("$: round trips:$ p50:$ p90:$ p99:$ p99.9:$ max:$",
+    name,
+    latencies.size(),
+    at(0.5),
+    at(0.9),
+    at(0.99),
+    at(0.999),
+    latencies.back());
+}
+
+void run_event_loop_benchmark()
+{
+  constexpr int num_connections = 64;
+  constexpr int num_round_trips = 100000;
+  const std::string message(64, 'x');
+
+  auto socket_pair = []() {
+    int fds[2];
+    assert(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+    return std::make_pair(FD(fds[0]).to_shared(), FD(fds[1]).to_shared());
+  };
+
+  {
+    // Baseline, a single connection doing blocking writes and reads
+    auto [client, server] = socket_pair();
+    std::vector<Span> latencies;
+    DataBuffer buffer;
+    for (int i = 0; i < num_round_trips; i++) {
+      auto start = Time::monotonic();
+      client->write(message).value();
+      server->read(buffer, message.size()).value();
+      server->write(buffer).value();
+      buffer.clear();
+      client->read(buffer, message.size()).value();
+      buffer.clear();
+      latencies.push_back(Time::monotonic() - start);
+    }
+    print_latencies("Blocking ping pong", latencies);
+  }
+
+  struct Connection {
+    FD::shared_ptr client;
+    FD::shared_ptr server;
+    DataBuffer server_input;
+    DataBuffer client_input;
+    Time sent;
+  };
+
+  auto run_echo = [&](int num_connections) {
+    auto loop = EventLoop::create().value();
+    std::vector<Connection> connections(num_connections);
+    std::vector<Span> latencies;
+    int sent = 0;
+    auto send = [&](Connection& conn) {
+      conn.sent = Time::monotonic();
+      conn.client->write(message).value();
+      sent++;
+    };
+    for (auto& conn : connections) {
+      std::tie(conn.client, conn.server) = socket_pair();
+      auto echo = [&conn]() {
+        conn.server->read_all_available(conn.server_input).value();
+        conn.server->write(conn.server_input).value();
+        conn.server_input.clear();
+      };
+      auto on_reply = [&]() {
+        conn.client->read_all_available(conn.client_input).value();
+        if (conn.client_input.size() < message.size()) { return; }
+        latencies.push_back(Time::monotonic() - conn.sent);
+        conn.client_input.clear();
+        if (sent < num_round_trips) { send(conn); }
+      };
+      loop->add_fd(conn.server, std::move(echo), {}).value();
+      loop->add_fd(conn.client, std::move(on_reply), {}).value();
+    }
+    for (auto& conn : connections) { send(conn); }
+    while (latencies.size() < size_t(sent)) { loop->run_once().value(); }
+    print_latencies(
+      F("EventLoop echo, $ connections", num_connections).data(), latencies);
+  };
+  run_echo(1);
+  run_echo(num_connections);
+}
+
+void run_timer_benchmark()
+{
+  constexpr int num_timers = 10000000;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int64_t> timeout_ms(1, 3600 * 1000);
+  std::vector<Span> timeouts(num_timers, Span::zero());
+  for (auto& timeout : timeouts) { timeout = Span::of_millis(timeout_ms(gen)); }
+  int64_t fired = 0;
+
+  auto report = [](const char* name, int64_t ops, Span elapsed) {
+    P("$: $ Mops/s",
+      name,
+      int64_t(ops / elapsed.to_float_seconds() / 1e6 * 100) / 100.0);
+  };
+
+  {
+    // Baseline, what Alarms used to do, it can't cancel
+    using Item = std::pair<Time, std::function<void()>>;
+    auto cmp = [](const Item& a, const Item& b) { return a.first > b.first; };
+    std::priority_queue<Item, std::vector<Item>, decltype(cmp)> heap(cmp);
+    auto start = Time::monotonic();
+    for (const auto& timeout : timeouts) {
+      heap.emplace(start + timeout, [&fired]() { fired++; });
+    }
+    report("priority_queue add", num_timers, Time::monotonic() - start);
+    start = Time::monotonic();
+    while (!heap.empty()) { heap.pop(); }
+    report("priority_queue pop", num_timers, Time::monotonic() - start);
+  }
+
+  {
+    auto start = Time::monotonic();
+    TimerWheel wheel(start);
+    std::vector<TimerId> ids(num_timers);
+    for (int i = 0; i < num_timers; i++) {
+      ids[i] = wheel.add(start + timeouts[i], [&fired]() { fired++; });
+    }
+    report("TimerWheel add", num_timers, Time::monotonic() - start);
+    auto cancel_start = Time::monotonic();
+    for (const auto& id : ids) { wheel.cancel(id); }
+    report("TimerWheel cancel", num_timers, Time::monotonic() - cancel_start);
+
+    // Second round reuses the nodes freed by the cancels
+    cancel_start = Time::monotonic();
+    for (int i = 0; i < num_timers; i++) {
+      ids[i] = wheel.add(start + timeouts[i], [&fired]() { fired++; });
+    }
+    for (const auto& id : ids) { wheel.cancel(id); }
+    report(
+      "TimerWheel add and cancel, warm",
+      num_timers,
+      Time::monotonic() - cancel_start);
+  }
+
+  {
+    // Every timer fires, the wheel is driven 1ms at a time over an hour
+    auto start = Time::epoch();
+    TimerWheel wheel(start);
+    for (const auto& timeout : timeouts) {
+      wheel.add(start + timeout, [&fired]() { fired++; });
+    }
+    std::vector<TimerWheel::Expired> due;
+    auto expire_start = Time::monotonic();
+    for (int64_t ms = 0; ms <= 3600 * 1000; ms++) {
+      wheel.expire(start + Span::of_millis(ms), due);
+      for (auto& timer : due) { timer.fn(); }
+      due.clear();
+    }
+    report("TimerWheel expire", num_timers, Time::monotonic() - expire_start);
+    assert(fired == num_timers);
+  }
+
+  {
+    constexpr int num_alarms = 1000000;
+    Alarms alarms;
+    std::vector<AlarmId> ids(num_alarms);
+    auto start = Time::monotonic();
+    for (int i = 0; i < num_alarms; i++) {
+      ids[i] = alarms.add_alarm(timeouts[i], [&fired]() { fired++; });
+    }
+    for (const auto& id : ids) { alarms.cancel_alarm(id); }
+    report("Alarms add and cancel", num_alarms, Time::monotonic() - start);
+  }
+
+  for (int num_workers : {0, 4}) {
+    // One callback in 20 blocks for 5ms, the others are cheap
+    constexpr int num_alarms = 2000;
+    std::atomic<int> done = 0;
+    {
+      Alarms alarms({.num_workers = num_workers});
+      for (int i = 0; i < num_alarms; i++) {
+        alarms.add_alarm(Span::of_micros(i * 100), [&done, i]() {
+          if (i % 20 == 0) { Span::of_millis(5).sleep(); }
+          done++;
+        });
+      }
+      while (done < num_alarms) { Span::of_millis(1).sleep(); }
+      P("Alarms lateness, $ workers: $",
+        num_workers,
+        alarms.lateness().to_string());
+    }
+  }
+}
+
+template <class Q>
+void run_mpmc(const char* name, int num_producers, int num_consumers)
+{
+  constexpr int capacity = 1024;
+  constexpr int num_items = 2000000;
+  const int per_producer = num_items / num_producers;
+  Q queue(capacity);
+  auto start = Time::monotonic();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_producers; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < per_producer; j++) { queue.push(j); }
+    });
+  }
+  std::atomic<int64_t> consumed = 0;
+  for (int i = 0; i < num_consumers; i++) {
+    threads.emplace_back([&]() {
+      int64_t count = 0;
+      while (queue.pop().has_value()) { count++; }
+      consumed += count;
+    });
+  }
+  for (int i = 0; i < num_producers; i++) { threads[i].join(); }
+  queue.close();
+  for (int i = num_producers; i < std::ssize(threads); i++) {
+    threads[i].join();
+  }
+  auto elapsed = Time::monotonic() - start;
+  assert(consumed == int64_t(per_producer) * num_producers);
+  P("$ $p/$c: $ Mops/s",
+    name,
+    num_producers,
+    num_consumers,
+    int64_t(consumed / elapsed.to_float_seconds() / 1e6 * 100) / 100.0);
+}
+
+template <class Q> void run_queue_ping_pong(const char* name)
+{
+  constexpr int num_round_trips = 100000;
+  Q requests(16);
+  Q replies(16);
+  std::thread echo([&]() {
+    while (auto v = requests.pop()) { replies.push(*v); }
+  });
+  std::vector<Span> latencies;
+  for (int i = 0; i < num_round_trips; i++) {
+    auto start = Time::monotonic();
+    requests.push(i);
+    replies.pop();
+    latencies.push_back(Time::monotonic() - start);
+  }
+  requests.close();
+  echo.join();
+  print_latencies(name, latencies);
+}
+
+void run_queue_batch_benchmark()
+{
+  constexpr int num_items = 10000000;
+  constexpr int batch_size = 256;
+
+  auto stream = [&](const char* name, auto&& produce, auto&& consume) {
+    Queue<int> queue(4096);
+    auto start = Time::monotonic();
+    std::thread producer([&]() {
+      produce(queue);
+      queue.close();
+    });
+    int64_t sum = consume(queue);
+    producer.join();
+    auto elapsed = Time::monotonic() - start;
+    assert(sum == int64_t(num_items) * (num_items - 1) / 2);
+    P("$: $ Mitems/s",
+      name,
+      int64_t(num_items / elapsed.to_float_seconds() / 1e6 * 100) / 100.0);
+  };
+
+  auto push_each = [](Queue<int>& queue) {
+    for (int i = 0; i < num_items; i++) { queue.push(i); }
+  };
+  auto push_many = [](Queue<int>& queue) {
+    std::vector<int> batch;
+    for (int i = 0; i < num_items; i++) {
+      batch.push_back(i);
+      if (batch.size() == batch_size) {
+        queue.push_many(batch);
+        batch.clear();
+      }
+    }
+    queue.push_many(batch);
+  };
+  auto pop_each = [](Queue<int>& queue) {
+    int64_t sum = 0;
+    while (auto v = queue.pop()) { sum += *v; }
+    return sum;
+  };
+  auto pop_many = [](Queue<int>& queue) {
+    int64_t sum = 0;
+    std::vector<int> batch;
+    while (queue.pop_many(batch, batch_size) > 0) {
+      for (int v : batch) { sum += v; }
+      batch.clear();
+    }
+    return sum;
+  };
+
+  stream("Queue push/pop", push_each, pop_each);
+  stream("Queue push/pop_many", push_each, pop_many);
+  stream("Queue push_many/pop_many", push_many, pop_many);
+
+  std::vector<int> inputs(num_items);
+  for (int i = 0; i < num_items; i++) { inputs[i] = i; }
+  auto start = Time::monotonic();
+  int64_t sum = 0;
+  for (int v : ParallelMap::go(inputs, 2, [](int v) { return v; })) {
+    sum += v;
+  }
+  auto elapsed = Time::monotonic() - start;
+  assert(sum == int64_t(num_items) * (num_items - 1) / 2);
+  P("ParallelMap identity: $ Mitems/s",
+    int64_t(num_items / elapsed.to_float_seconds() / 1e6 * 100) / 100.0);
+}
+
+void run_thread_pool_benchmark()
+{
+  constexpr int num_calls = 10000;
+  std::vector<int> inputs(64);
+  for (int i = 0; i < std::ssize(inputs); i++) { inputs[i] = i; }
+  auto start = Time::monotonic();
+  int64_t sum = 0;
+  for (int i = 0; i < num_calls; i++) {
+    for (int v : ParallelMap::go(inputs, 4, [](int v) { return v + 1; })) {
+      sum += v;
+    }
+  }
+  auto elapsed = Time::monotonic() - start;
+  assert(sum == int64_t(num_calls) * 64 * 65 / 2);
+  P("ParallelMap, $ calls of $ items: $ per call",
+    num_calls,
+    inputs.size(),
+    elapsed / num_calls);
+
+  auto& pool = ThreadPool::global();
+  time_it("ThreadPool submit and wait", [&]() {
+    auto f = pool.submit([]() { return 1; });
+    return f.get();
+  });
+}
+
+void run_parallel_map_modes_benchmark()
+{
+  constexpr int num_items = 10000000;
+  auto make_inputs = []() {
+    std::vector<int64_t> inputs(num_items);
+    for (int i = 0; i < num_items; i++) { inputs[i] = i; }
+    return inputs;
+  };
+  auto cheap = [](int64_t v) { return v * 3 + 1; };
+
+  auto run = [&](const char* name, const ParallelMap::Options& options) {
+    auto inputs = make_inputs();
+    auto start = Time::monotonic();
+    std::vector<int64_t> outputs;
+    outputs.reserve(num_items);
+    for (int64_t v : ParallelMap::go(std::move(inputs), options, cheap)) {
+      outputs.push_back(v);
+    }
+    if (!options.ordered) { std::sort(outputs.begin(), outputs.end()); }
+    auto elapsed = Time::monotonic() - start;
+    assert(outputs.back() == cheap(num_items - 1));
+    P("$: $ Mitems/s",
+      name,
+      int64_t(num_items / elapsed.to_float_seconds() / 1e6 * 100) / 100.0);
+  };
+
+  run("Per item, sorted after", {.num_workers = 4});
+  run("Chunked, sorted after", {.num_workers = 4, .chunked = true});
+  run("Ordered", {.num_workers = 4, .ordered = true});
+  run(
+    "Ordered, chunked", {.num_workers = 4, .ordered = true, .chunked = true});
+}
+
+void run_parallel_algorithms_benchmark()
+{
+  constexpr size_t num_items = 100000000;
+  std::vector<int32_t> inputs(num_items);
+  std::mt19937 gen(42);
+  for (auto& v : inputs) { v = int32_t(gen()); }
+  std::vector<int32_t> values(num_items);
+
+  auto report = [&](const std::string& name, Span base, Span elapsed) {
+    P("$: $ Mitems/s, $x",
+      name,
+      int64_t(num_items / elapsed.to_float_seconds() / 1e6 * 100) / 100.0,
+      int64_t(
+        base.to_float_seconds() / elapsed.to_float_seconds() * 100) /
+        100.0);
+  };
+  auto measure = [](auto&& f) {
+    auto start = Time::monotonic();
+    f();
+    return Time::monotonic() - start;
+  };
+
+  int max_workers = ThreadPool::global().num_workers();
+  std::vector<int> worker_counts;
+  for (int w = 1; w < max_workers; w *= 2) { worker_counts.push_back(w); }
+  worker_counts.push_back(max_workers);
+
+  int64_t expected_sum = 0;
+  auto base = measure([&]() {
+    expected_sum = std::accumulate(inputs.begin(), inputs.end(), int64_t(0));
+  });
+  report("std::accumulate", base, base);
+  for (int w : worker_counts) {
+    int64_t sum = 0;
+    auto elapsed = measure([&]() {
+      sum = parallel_reduce(
+        inputs.begin(), inputs.end(), int64_t(0), {}, {.num_workers = w});
+    });
+    assert(sum == expected_sum);
+    report(F("parallel_reduce $ workers", w), base, elapsed);
+  }
+
+  auto op = [](int32_t v) { return v * 3 + 1; };
+  base = measure([&]() {
+    std::transform(inputs.begin(), inputs.end(), values.begin(), op);
+  });
+  report("std::transform", base, base);
+  for (int w : worker_counts) {
+    auto elapsed = measure([&]() {
+      parallel_transform(
+        inputs.begin(), inputs.end(), values.begin(), op, {.num_workers = w});
+    });
+    report(F("parallel_transform $ workers", w), base, elapsed);
+  }
+
+  std::copy(inputs.begin(), inputs.end(), values.begin());
+  base = measure([&]() { std::sort(values.begin(), values.end()); });
+  report("std::sort", base, base);
+  for (int w : worker_counts) {
+    std::copy(inputs.begin(), inputs.end(), values.begin());
+    auto elapsed =
+      measure([&]() { parallel_sort(values, {}, {.num_workers = w}); });
+    assert(std::is_sorted(values.begin(), values.end()));
+    report(F("parallel_sort $ workers", w), base, elapsed);
+  }
+}
+
+void run_queue_benchmark()
+{
+  for (auto [producers, consumers] : {
+         std::make_pair(1, 1),
+         std::make_pair(2, 2),
+         std::make_pair(4, 4),
+         std::make_pair(8, 1),
+         std::make_pair(1, 8),
+       }) {
+    run_mpmc<Queue<int>>("Queue", producers, consumers);
+    run_mpmc<RingQueue<int>>("RingQueue", producers, consumers);
+  }
+  run_queue_ping_pong<Queue<int>>("Queue ping pong");
+  run_queue_ping_pong<RingQueue<int>>("RingQueue ping pong");
+}
+
+void run_histogram_benchmark()
+{
+  constexpr int num_values = 10000000;
+  std::mt19937_64 gen(42);
+  std::vector<int64_t> values(num_values);
+  for (auto& v : values) { v = gen() % 10000000; }
+
+  auto report = [](const char* name, Span elapsed) {
+    P("$: $ Mitems/s",
+      name,
+      int64_t(num_values / elapsed.to_float_seconds() / 1e6 * 100) / 100.0);
+  };
+  auto measure = [](auto&& f) {
+    auto start = Time::monotonic();
+    f();
+    return Time::monotonic() - start;
+  };
+
+  Histogram histogram;
+  report("Histogram record", measure([&]() {
+           for (int64_t v : values) { histogram.record(v); }
+         }));
+  int64_t p99 = 0;
+  auto quantile_time = measure([&]() { p99 = histogram.quantile(0.99); });
+  P("Histogram quantile: $, p99:$", quantile_time, p99);
+
+  // What Sampler did before, one random number per element
+  std::vector<int64_t> sample;
+  std::mt19937_64 rng(1);
+  report("Reservoir sampling, one draw per element", measure([&]() {
+           int64_t seen = 0;
+           for (int64_t v : values) {
+             seen++;
+             if (sample.size() < 1000) {
+               sample.push_back(v);
+               continue;
+             }
+             std::uniform_int_distribution<int64_t> dist(0, seen - 1);
+             int64_t r = dist(rng);
+             if (r < 1000) { sample[r] = v; }
+           }
+         }));
+  Sampler<int64_t> sampler(1000, 1);
+  report("Sampler maybe_add", measure([&]() {
+           for (int64_t v : values) { sampler.maybe_add(v); }
+         }));
+  Sampler<int64_t> range_sampler(1000, 1);
+  report("Sampler add_range", measure([&]() {
+           range_sampler.add_range(values.begin(), values.end());
+         }));
+  assert(sampler.sample().size() == 1000);
+}
+
+void run_clock_benchmark()
+{
+  CycleClock::calibrate();
+  P("CycleClock uses the TSC: $, $ ticks/s",
+    CycleClock::uses_tsc(),
+    int64_t(CycleClock::ticks_per_second()));
+  time_it("Time::monotonic", []() { return Time::monotonic(); });
+  time_it("std::chrono::steady_clock::now", []() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+  });
+  time_it("CycleClock::now", []() { return CycleClock::now(); });
+  time_it("CycleClock::now and to_span", []() {
+    return CycleClock::to_span(CycleClock::now());
+  });
+}
+
+void run_simple_timer_benchmark()
+{
+  static auto outer_timer = SimpleTimer::create_timer("bench_outer");
+  static auto inner_timer = SimpleTimer::create_timer("bench_inner");
+  time_it("Two Time::monotonic reads", []() {
+    auto start = Time::monotonic();
+    return (Time::monotonic() - start).to_nanos();
+  });
+  time_it("Two CycleClock reads", []() {
+    auto start = CycleClock::now();
+    return CycleClock::now() - start;
+  });
+  time_it("SimpleTimer scope", []() {
+    auto scope = outer_timer();
+    return 1;
+  });
+  {
+    auto outer = outer_timer();
+    time_it("SimpleTimer nested scope", []() {
+      auto scope = inner_timer();
+      return 1;
+    });
+  }
+  Trace::start();
+  time_it("SimpleTimer scope, recording a trace", []() {
+    auto scope = outer_timer();
+    return 1;
+  });
+  Trace::stop();
+
+  // Every thread accumulates into its own tree, so adding threads should not
+  // make scopes slower
+  constexpr int scopes_per_thread = 10000000;
+  for (int num_threads : {1, 4}) {
+    auto start = Time::monotonic();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([]() {
+        for (int i = 0; i < scopes_per_thread; i++) { auto s = outer_timer(); }
+      });
+    }
+    for (auto& thread : threads) { thread.join(); }
+    auto elapsed = Time::monotonic() - start;
+    P("SimpleTimer scopes, $ threads: $ per scope",
+      num_threads,
+      elapsed / (int64_t(scopes_per_thread) * num_threads));
+  }
+  SimpleTimer::reset_all();
 }
 
 void run_noop_benchmark()
@@ -136,6 +1314,35 @@ int main()
   run_date_benchmark();
   print_banner("Time benchmark");
   run_time_benchmark();
+  print_banner("DataBuffer benchmark");
+  run_data_buffer_benchmark();
+  run_varint_decode_benchmark();
+  print_banner("Line reading benchmark");
+  run_line_reading_benchmark();
+  print_banner("Scatter/gather IO benchmark");
+  run_scatter_gather_benchmark();
+  print_banner("File buffer size benchmark");
+  run_file_buffer_benchmark();
+  print_banner("IoRing benchmark");
+  run_io_ring_benchmark();
+  print_banner("EventLoop benchmark");
+  run_event_loop_benchmark();
+  print_banner("Timer benchmark");
+  run_timer_benchmark();
+  print_banner("Queue benchmark");
+  run_queue_benchmark();
+  run_queue_batch_benchmark();
+  print_banner("ThreadPool benchmark");
+  run_thread_pool_benchmark();
+  run_parallel_map_modes_benchmark();
+  print_banner("Parallel algorithms benchmark");
+  run_parallel_algorithms_benchmark();
+  print_banner("Histogram benchmark");
+  run_histogram_benchmark();
+  print_banner("Clock benchmark");
+  run_clock_benchmark();
+  print_banner("SimpleTimer benchmark");
+  run_simple_timer_benchmark();
   print_banner("Noop benchmark");
   run_noop_benchmark();
   P(sep);
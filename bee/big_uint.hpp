@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+namespace bee {
+
+// Fixed width unsigned integer with 32 bit limbs, only what is needed to
+// compute the power tables of the float conversions at compile time. Not
+// meant to be fast, overflow wraps silently.
+template <int NumLimbs> struct BigUint {
+ public:
+  using uint128 = unsigned __int128;
+
+  constexpr BigUint() = default;
+
+  constexpr static BigUint pow2(int bit)
+  {
+    BigUint out;
+    out._limbs[bit / 32] = 1u << (bit % 32);
+    return out;
+  }
+
+  constexpr void mul(uint32_t m)
+  {
+    uint64_t carry = 0;
+    for (auto& limb : _limbs) {
+      uint64_t v = uint64_t(limb) * m + carry;
+      limb = v;
+      carry = v >> 32;
+    }
+  }
+
+  constexpr void div(uint32_t d)
+  {
+    uint64_t rem = 0;
+    for (int i = NumLimbs - 1; i >= 0; i--) {
+      uint64_t v = (rem << 32) | _limbs[i];
+      _limbs[i] = v / d;
+      rem = v % d;
+    }
+  }
+
+  constexpr int bit_width() const
+  {
+    for (int i = NumLimbs - 1; i >= 0; i--) {
+      if (_limbs[i] != 0) { return i * 32 + std::bit_width(_limbs[i]); }
+    }
+    return 0;
+  }
+
+  // Whether bits [begin, end) are all set
+  constexpr bool all_ones(int begin, int end) const
+  {
+    for (int bit = begin; bit < end; bit++) {
+      if ((_limbs[bit / 32] >> (bit % 32) & 1) == 0) { return false; }
+    }
+    return true;
+  }
+
+  // floor(this / 2^shift), which must fit in 128 bits, shift can be
+  // negative
+  constexpr uint128 shifted(int shift) const
+  {
+    uint128 out = 0;
+    for (int i = shift > 0 ? shift / 32 : 0; i < NumLimbs; i++) {
+      int pos = i * 32 - shift;
+      if (pos >= 128) { break; }
+      if (pos >= 0) {
+        out |= uint128(_limbs[i]) << pos;
+      } else {
+        out |= _limbs[i] >> -pos;
+      }
+    }
+    return out;
+  }
+
+ private:
+  std::array<uint32_t, NumLimbs> _limbs{};
+};
+
+} // namespace bee
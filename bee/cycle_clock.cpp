@@ -0,0 +1,166 @@
+#include "cycle_clock.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace bee {
+namespace {
+
+bool has_invariant_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned eax, ebx, ecx, edx;
+  // Fails if the CPU doesn't have the leaf
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) { return false; }
+  return (edx & (1 << 8)) != 0;
+#else
+  return false;
+#endif
+}
+
+struct Calibration {
+  double nanos_per_tick = 1.0;
+  int64_t base_ticks = 0;
+  int64_t base_nanos = 0;
+};
+
+// A TSC reading and the monotonic time of the same moment, bracketed as
+// tightly as a few tries allow
+std::pair<int64_t, int64_t> sample_pair()
+{
+  int64_t best_ticks = 0;
+  int64_t best_nanos = 0;
+  int64_t best_width = INT64_MAX;
+  for (int i = 0; i < 8; i++) {
+    int64_t before = CycleClock::now();
+    int64_t nanos = Time::monotonic().to_nanos_since_epoch();
+    int64_t after = CycleClock::now();
+    if (after - before < best_width) {
+      best_width = after - before;
+      best_ticks = before + (after - before) / 2;
+      best_nanos = nanos;
+    }
+  }
+  return {best_ticks, best_nanos};
+}
+
+Calibration calibration_between(
+  std::pair<int64_t, int64_t> first, std::pair<int64_t, int64_t> second)
+{
+  auto [ticks1, nanos1] = first;
+  auto [ticks2, nanos2] = second;
+  return {
+    .nanos_per_tick = double(nanos2 - nanos1) / double(ticks2 - ticks1),
+    .base_ticks = ticks2,
+    .base_nanos = nanos2,
+  };
+}
+
+// The first conversion measures a provisional ratio over a short spin, so
+// it doesn't stall its caller. The first conversion once 10ms passed since
+// replaces it with one measured from the same first sample. Each is written
+// once before being published.
+const Calibration untimed_calibration;
+Calibration provisional_calibration;
+Calibration final_calibration;
+std::atomic<const Calibration*> current_calibration = nullptr;
+std::once_flag calibration_started;
+
+std::pair<int64_t, int64_t> first_sample;
+// Reading after which the final calibration is measured
+int64_t refine_at_ticks = 0;
+std::atomic<bool> refining = false;
+
+void start_calibration()
+{
+  if (!CycleClock::uses_tsc()) {
+    current_calibration.store(&untimed_calibration, std::memory_order_release);
+    return;
+  }
+  auto first = sample_pair();
+  auto spin_until = Time::monotonic() + Span::of_micros(50);
+  while (Time::monotonic() < spin_until) {}
+  provisional_calibration = calibration_between(first, sample_pair());
+  first_sample = first;
+  double wait_nanos = Span::of_millis(10).to_nanos();
+  double nanos_per_tick = provisional_calibration.nanos_per_tick;
+  refine_at_ticks = first.first + std::llround(wait_nanos / nanos_per_tick);
+  current_calibration.store(
+    &provisional_calibration, std::memory_order_release);
+}
+
+const Calibration& calibration()
+{
+  auto c = current_calibration.load(std::memory_order_acquire);
+  if (c == nullptr || c == &provisional_calibration) [[unlikely]] {
+    std::call_once(calibration_started, start_calibration);
+    // Only one caller measures the final calibration, the others keep using
+    // the provisional one meanwhile
+    if (
+      CycleClock::now() >= refine_at_ticks &&
+      current_calibration.load(std::memory_order_acquire) ==
+        &provisional_calibration &&
+      !refining.exchange(true)) {
+      final_calibration = calibration_between(first_sample, sample_pair());
+      current_calibration.store(
+        &final_calibration, std::memory_order_release);
+    }
+    c = current_calibration.load(std::memory_order_acquire);
+  }
+  return *c;
+}
+
+} // namespace
+
+std::atomic<int> CycleClock::_source = Unknown;
+
+int64_t CycleClock::_first_read()
+{
+  _source = has_invariant_tsc() ? Tsc : Monotonic;
+  return now();
+}
+
+Span CycleClock::to_span(int64_t ticks)
+{
+  if (!uses_tsc()) { return Span::of_nanos(ticks); }
+  return Span::of_nanos(std::llround(ticks * calibration().nanos_per_tick));
+}
+
+int64_t CycleClock::to_ticks(Span span)
+{
+  if (!uses_tsc()) { return span.to_nanos(); }
+  return std::llround(span.to_nanos() / calibration().nanos_per_tick);
+}
+
+Time CycleClock::to_time(int64_t reading)
+{
+  if (!uses_tsc()) { return Time::of_nanos_since_epoch(reading); }
+  const auto& c = calibration();
+  return Time::of_nanos_since_epoch(
+    c.base_nanos + to_span(reading - c.base_ticks).to_nanos());
+}
+
+bool CycleClock::uses_tsc()
+{
+  if (_source.load(std::memory_order_relaxed) == Unknown) { now(); }
+  return _source.load(std::memory_order_relaxed) == Tsc;
+}
+
+void CycleClock::calibrate()
+{
+  while (&calibration() == &provisional_calibration) {
+    Span::of_millis(1).sleep();
+  }
+}
+
+double CycleClock::ticks_per_second()
+{
+  return 1e9 / calibration().nanos_per_tick;
+}
+
+} // namespace bee
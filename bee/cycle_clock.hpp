@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "span.hpp"
+#include "time.hpp"
+
+namespace bee {
+
+// Cheap monotonic clock for timing short scopes. Reads the TSC when the CPU
+// says it is invariant, which costs a few nanoseconds, and falls back to
+// clock_gettime(CLOCK_MONOTONIC) otherwise. Readings are in ticks of unknown
+// length, only differences are meaningful. Converting them needs a
+// calibration against CLOCK_MONOTONIC: the first conversion spins for about
+// 50us to get a provisional ratio, and the first conversion 10ms later or more
+// refines it. Call calibrate() to wait for the refined one.
+struct CycleClock {
+ public:
+  static inline int64_t now()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    int source = _source.load(std::memory_order_relaxed);
+    if (source == Tsc) [[likely]] { return __rdtsc(); }
+    if (source == Unknown) [[unlikely]] { return _first_read(); }
+#endif
+    return Time::monotonic().to_nanos_since_epoch();
+  }
+
+  static Span to_span(int64_t ticks);
+  static int64_t to_ticks(Span span);
+
+  // Time::monotonic at the moment of the reading
+  static Time to_time(int64_t reading);
+
+  static bool uses_tsc();
+  static double ticks_per_second();
+
+  // Blocks until the calibration is final, about 10ms after the first
+  // conversion
+  static void calibrate();
+
+ private:
+  enum { Unknown = 0, Tsc, Monotonic };
+
+  static int64_t _first_read();
+
+  static std::atomic<int> _source;
+};
+
+} // namespace bee
@@ -0,0 +1,53 @@
+#include "cycle_clock.hpp"
+
+#include "testing.hpp"
+
+namespace bee {
+namespace {
+
+Span abs(Span span) { return span < Span::zero() ? -span : span; }
+
+// Must run first, before anything calibrates the clock
+TEST(first_conversion_does_not_wait)
+{
+  auto start = Time::monotonic();
+  CycleClock::to_span(CycleClock::now());
+  P("took less than 5ms: $", Time::monotonic() - start < Span::of_millis(5));
+}
+
+TEST(monotonic)
+{
+  int64_t prev = CycleClock::now();
+  bool increasing = true;
+  for (int i = 0; i < 100000; i++) {
+    int64_t reading = CycleClock::now();
+    increasing = increasing && reading >= prev;
+    prev = reading;
+  }
+  P("never goes back: $", increasing);
+}
+
+TEST(conversions)
+{
+  CycleClock::calibrate();
+  auto start = CycleClock::now();
+  auto start_time = Time::monotonic();
+  Span::of_millis(20).sleep();
+  auto end = CycleClock::now();
+  auto elapsed_time = Time::monotonic() - start_time;
+  auto elapsed = CycleClock::to_span(end - start);
+  P("measures the sleep: $", elapsed >= Span::of_millis(19));
+  P("matches Time::monotonic: $",
+    abs(elapsed - elapsed_time) < Span::of_micros(100));
+
+  auto when = CycleClock::to_time(start);
+  P("to_time: $", abs(when - start_time) < Span::of_micros(100));
+
+  auto span = Span::of_millis(1.5);
+  auto round_trip = CycleClock::to_span(CycleClock::to_ticks(span));
+  P("round trip: $", abs(round_trip - span) <= Span::of_nanos(1));
+  P("ticks per second > 0: $", CycleClock::ticks_per_second() > 0);
+}
+
+} // namespace
+} // namespace bee
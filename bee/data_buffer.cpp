@@ -2,6 +2,8 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstring>
+#include <utility>
 
 #include "bytes.hpp"
 #include "util.hpp"
@@ -9,30 +11,51 @@
 using std::string;
 
 namespace bee {
+namespace {
+
+constexpr size_t min_bytes_to_adopt = Slab::DefaultCapacity / 4;
+constexpr size_t max_bytes_to_coalesce = 512;
+
+} // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
 // DataBlock
 //
 
-DataBlock::DataBlock(Bytes&& data) : _data(std::move(data)), _start(0) {}
-DataBlock::DataBlock(const Bytes& data) : _data(data), _start(0) {}
+DataBlock::DataBlock(Bytes&& data)
+    : _slab(Slab::adopt(std::move(data))), _start(0), _end(_slab->used())
+{}
+
+DataBlock::DataBlock(const Bytes& data) : DataBlock(data.data(), data.size())
+{}
 
 DataBlock::DataBlock(const std::byte* data, size_t size)
-    : _data(data, data + size), _start(0)
+    : _slab(Slab::allocate(size)), _start(0), _end(0)
+{
+  append(data, size);
+}
+
+DataBlock::DataBlock(SlabRef&& slab)
+    : _slab(std::move(slab)), _start(_slab->used()), _end(_start)
 {}
 
 DataBlock::~DataBlock() noexcept {}
 
-const std::byte* DataBlock::data() const { return _data.data() + _start; }
-std::byte* DataBlock::data() { return _data.data() + _start; }
+const std::byte* DataBlock::data() const { return _slab->data() + _start; }
+std::byte* DataBlock::data() { return _slab->data() + _start; }
 
-size_t DataBlock::size() const { return _data.size() - _start; }
+size_t DataBlock::size() const { return _end - _start; }
 
 bool DataBlock::empty() const { return size() == 0; }
 
-const std::byte* DataBlock::begin() const { return _data.data() + _start; }
+const std::byte* DataBlock::begin() const { return data(); }
 const std::byte* DataBlock::end() const { return begin() + size(); }
 
+string DataBlock::to_string() const
+{
+  return string(reinterpret_cast<const char*>(data()), size());
+}
+
 void DataBlock::consume(size_t bytes)
 {
   assert(bytes <= size());
@@ -41,60 +64,143 @@ void DataBlock::consume(size_t bytes)
 
 std::byte DataBlock::read_byte()
 {
-  std::byte out = _data[_start];
-  _start++;
-  return out;
+  assert(!empty());
+  return _slab->data()[_start++];
+}
+
+size_t DataBlock::append_capacity() const
+{
+  if (_slab->is_shared() || _slab->used() != _end) { return 0; }
+  return _slab->available();
+}
+
+size_t DataBlock::append(const std::byte* data, size_t size)
+{
+  if (append_capacity() == 0) { return 0; }
+  size_t appended = _slab->bump(size);
+  memcpy(_slab->data() + _end, data, appended);
+  _end += appended;
+  return appended;
+}
+
+std::span<std::byte> DataBlock::free_space()
+{
+  return {_slab->data() + _end, append_capacity()};
+}
+
+void DataBlock::commit(size_t size)
+{
+  assert(size <= append_capacity());
+  _end += _slab->bump(size);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // DataBuffer
 //
 
-DataBuffer::DataBuffer() {}
-DataBuffer::DataBuffer(const string& data) { write(data); }
+DataBuffer::DataBuffer() : _size(0), _scanned(0) {}
+DataBuffer::DataBuffer(const string& data) : DataBuffer() { write(data); }
 
-DataBuffer::~DataBuffer() noexcept {}
+DataBuffer::DataBuffer(const DataBuffer& other)
+    : _blocks(other._blocks), _size(other._size), _scanned(other._scanned)
+{}
 
-bool DataBuffer::empty() const
+DataBuffer::DataBuffer(DataBuffer&& other) noexcept
+    : _blocks(std::move(other._blocks)),
+      _size(std::exchange(other._size, 0)),
+      _scanned(std::exchange(other._scanned, 0))
 {
-  for (const auto& block : _blocks) {
-    if (!block.empty()) return false;
-  }
-  return true;
+  other._blocks.clear();
 }
 
-size_t DataBuffer::size() const
+DataBuffer& DataBuffer::operator=(const DataBuffer& other)
 {
-  size_t size = 0;
-  for (const auto& block : _blocks) { size += block.size(); }
-  return size;
+  _blocks = other._blocks;
+  _size = other._size;
+  _scanned = other._scanned;
+  return *this;
 }
 
+DataBuffer& DataBuffer::operator=(DataBuffer&& other) noexcept
+{
+  _blocks = std::move(other._blocks);
+  _size = std::exchange(other._size, 0);
+  _scanned = std::exchange(other._scanned, 0);
+  other._blocks.clear();
+  return *this;
+}
+
+DataBuffer::~DataBuffer() noexcept {}
+
+bool DataBuffer::empty() const { return _size == 0; }
+
+size_t DataBuffer::size() const { return _size; }
+
 void DataBuffer::write(const string& data)
 {
-  _blocks.emplace_back(Bytes(data));
+  write(data.data(), data.size());
 }
 
 void DataBuffer::write(DataBuffer&& other)
 {
+  _size += other._size;
   if (_blocks.empty()) {
     _blocks = std::move(other._blocks);
   } else {
-    for (auto& block : other._blocks) { _blocks.push_back(std::move(block)); }
+    for (auto& block : other._blocks) {
+      // Tiny blocks are copied into our tail when they fit, otherwise each
+      // one would pin a whole slab
+      auto& tail = _blocks.back();
+      if (
+        block.size() <= max_bytes_to_coalesce &&
+        block.size() <= tail.append_capacity()) {
+        tail.append(block.data(), block.size());
+      } else {
+        _blocks.push_back(std::move(block));
+      }
+    }
   }
   other.clear();
+  _check_size();
+}
+
+void DataBuffer::write(const char* data, size_t size)
+{
+  write(reinterpret_cast<const std::byte*>(data), size);
 }
 
 void DataBuffer::write(const std::byte* data, size_t size)
 {
-  _blocks.emplace_back(data, size);
+  if (size == 0) { return; }
+  _size += size;
+  if (!_blocks.empty()) {
+    size_t appended = _blocks.back().append(data, size);
+    data += appended;
+    size -= appended;
+  }
+  if (size > 0) { _blocks.emplace_back(data, size); }
+  _check_size();
 }
 
-void DataBuffer::write(Bytes&& data) { _blocks.emplace_back(std::move(data)); }
-void DataBuffer::write(const Bytes& data) { _blocks.emplace_back(data); }
+void DataBuffer::write(Bytes&& data)
+{
+  // Small payloads are cheaper to copy into the tail slab than to keep their
+  // own allocation alive
+  if (data.size() < min_bytes_to_adopt) {
+    write(data);
+  } else {
+    _size += data.size();
+    _blocks.emplace_back(std::move(data));
+    _check_size();
+  }
+}
+
+void DataBuffer::write(const Bytes& data) { write(data.data(), data.size()); }
 
 void DataBuffer::prepend(DataBuffer&& other)
 {
+  _size += other._size;
+  _scanned = 0;
   if (_blocks.empty()) {
     _blocks = std::move(other._blocks);
   } else {
@@ -103,13 +209,15 @@ void DataBuffer::prepend(DataBuffer&& other)
     }
   }
   other.clear();
+  _check_size();
 }
 
 string DataBuffer::to_string() const
 {
   string output;
+  output.reserve(_size);
   for (auto& block : _blocks) {
-    for (std::byte b : block) { output += static_cast<char>(b); }
+    output.append(reinterpret_cast<const char*>(block.data()), block.size());
   }
   return output;
 }
@@ -117,12 +225,11 @@ string DataBuffer::to_string() const
 string DataBuffer::read_string(size_t size)
 {
   string output;
+  output.reserve(std::min(size, _size));
   for (auto& block : _blocks) {
     if (output.size() >= size) break;
-    auto end = block.begin() + std::min(block.size(), size - output.size());
-    for (auto it = block.begin(); it != end; it++) {
-      output += static_cast<char>(*it);
-    }
+    size_t to_copy = std::min(block.size(), size - output.size());
+    output.append(reinterpret_cast<const char*>(block.data()), to_copy);
   }
   consume(output.size());
   return output;
@@ -131,6 +238,7 @@ string DataBuffer::read_string(size_t size)
 Bytes DataBuffer::read_bytes(size_t size)
 {
   Bytes output;
+  output.reserve(std::min(size, _size));
   for (auto& block : _blocks) {
     if (output.size() >= size) break;
     auto end = block.begin() + std::min(block.size(), size - output.size());
@@ -142,36 +250,68 @@ Bytes DataBuffer::read_bytes(size_t size)
 
 std::optional<string> DataBuffer::read_line()
 {
-  string output;
-  bool found_eol = false;
-  auto read_until_eol = [&]() {
-    for (auto& block : _blocks) {
-      for (std::byte b : block) {
-        char c = static_cast<char>(b);
-        if (c == '\n') {
-          found_eol = true;
-          return;
-        }
-        output += c;
+  auto eol = _find_eol();
+  if (!eol.has_value()) { return std::nullopt; }
+  auto output = read_string(*eol);
+  consume(1);
+  return output;
+}
+
+std::optional<std::string_view> DataBuffer::read_line_view()
+{
+  auto eol = _find_eol();
+  if (!eol.has_value()) { return std::nullopt; }
+  auto& block = _blocks.front();
+  if (*eol >= block.size()) {
+    _line_scratch = read_string(*eol);
+    consume(1);
+    return _line_scratch;
+  }
+  std::string_view line(reinterpret_cast<const char*>(block.data()), *eol);
+  if (*eol + 1 == block.size()) {
+    // The block is about to be dropped, keep its slab alive for the view
+    _view_pin.emplace(std::move(block));
+    _blocks.pop_front();
+    _size -= *eol + 1;
+    _scanned = 0;
+  } else {
+    consume(*eol + 1);
+  }
+  _check_size();
+  return line;
+}
+
+std::optional<size_t> DataBuffer::_find_eol()
+{
+  size_t offset = 0;
+  for (const auto& block : _blocks) {
+    size_t block_end = offset + block.size();
+    if (block_end > _scanned) {
+      size_t skip = _scanned > offset ? _scanned - offset : 0;
+      auto start = block.data() + skip;
+      if (auto eol = memchr(start, '\n', block.size() - skip)) {
+        return offset + (static_cast<const std::byte*>(eol) - block.data());
       }
+      _scanned = block_end;
     }
-  };
-  read_until_eol();
-  if (!found_eol) { return std::nullopt; }
-  consume(output.size() + 1);
-  return output;
+    offset = block_end;
+  }
+  return std::nullopt;
 }
 
 std::byte DataBuffer::read_byte()
 {
-  for (auto& block : _blocks) {
-    if (block.empty()) continue;
-    return block.read_byte();
-  }
-  assert(false && "Buffer is empty");
+  assert(!empty() && "Buffer is empty");
+  auto& block = _blocks.front();
+  std::byte out = block.read_byte();
+  if (block.empty()) { _blocks.pop_front(); }
+  _size--;
+  if (_scanned > 0) { _scanned--; }
+  _check_size();
+  return out;
 }
 
-DataBlock& DataBuffer::top()
+const DataBlock& DataBuffer::top() const
 {
   assert(!empty());
   return _blocks.front();
@@ -179,6 +319,9 @@ DataBlock& DataBuffer::top()
 
 void DataBuffer::consume(size_t bytes)
 {
+  assert(bytes <= _size);
+  _size -= bytes;
+  _scanned = _scanned > bytes ? _scanned - bytes : 0;
   while (bytes > 0) {
     assert(!_blocks.empty());
     auto& block = _blocks.front();
@@ -187,9 +330,62 @@ void DataBuffer::consume(size_t bytes)
     bytes -= consume_in_block;
     if (block.empty()) { _blocks.pop_front(); }
   }
+  _check_size();
 }
 
-void DataBuffer::clear() { _blocks.clear(); }
+void DataBuffer::reserve(size_t size)
+{
+  size_t available = _blocks.empty() ? 0 : _blocks.back().append_capacity();
+  for (const auto& slab : _spare) { available += slab->available(); }
+  while (available < size) {
+    _spare.emplace_back(Slab::allocate());
+    available += _spare.back()->available();
+  }
+}
+
+size_t DataBuffer::free_space(std::span<std::span<std::byte>> regions)
+{
+  size_t count = 0;
+  if (!_blocks.empty() && count < regions.size()) {
+    auto space = _blocks.back().free_space();
+    if (!space.empty()) { regions[count++] = space; }
+  }
+  for (const auto& slab : _spare) {
+    if (count >= regions.size()) { break; }
+    regions[count++] = {slab->data() + slab->used(), slab->available()};
+  }
+  return count;
+}
+
+void DataBuffer::commit(size_t size)
+{
+  _size += size;
+  if (!_blocks.empty()) {
+    auto& tail = _blocks.back();
+    size_t in_tail = std::min(size, tail.append_capacity());
+    tail.commit(in_tail);
+    size -= in_tail;
+  }
+  for (auto& slab : _spare) {
+    if (size == 0) { break; }
+    DataBlock block(std::move(slab));
+    size_t in_block = std::min(size, block.append_capacity());
+    block.commit(in_block);
+    size -= in_block;
+    _blocks.push_back(std::move(block));
+  }
+  assert(size == 0 && "Committed more than the reserved space");
+  _spare.clear();
+  _check_size();
+}
+
+void DataBuffer::clear()
+{
+  _spare.clear();
+  _blocks.clear();
+  _size = 0;
+  _scanned = 0;
+}
 
 std::deque<DataBlock>::const_iterator DataBuffer::begin() const
 {
@@ -201,8 +397,16 @@ std::deque<DataBlock>::const_iterator DataBuffer::end() const
   return _blocks.end();
 }
 
-std::deque<DataBlock>::iterator DataBuffer::begin() { return _blocks.begin(); }
-
-std::deque<DataBlock>::iterator DataBuffer::end() { return _blocks.end(); }
+void DataBuffer::_check_size() const
+{
+#ifdef BEE_DATA_BUFFER_CHECKS
+  size_t size = 0;
+  for (const auto& block : _blocks) {
+    assert(!block.empty() && "DataBuffer holds an empty block");
+    size += block.size();
+  }
+  assert(size == _size && "DataBuffer cached size is out of sync");
+#endif
+}
 
 } // namespace bee
@@ -2,19 +2,34 @@
 
 #include <deque>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "bytes.hpp"
+#include "slab.hpp"
 
 namespace bee {
 
+// View into a ref counted Slab. Copies of a block share the same memory. The
+// block holding the end of the slab's used region, when it is the only one
+// referencing that slab, can grow in place with append.
 struct DataBlock {
  public:
   explicit DataBlock(Bytes&& data);
   explicit DataBlock(const Bytes& data);
   explicit DataBlock(const std::byte* data, size_t size);
 
+  // Empty block starting at the end of the slab's used region
+  explicit DataBlock(SlabRef&& slab);
+
+  DataBlock(const DataBlock& other) = default;
+  DataBlock(DataBlock&& other) noexcept = default;
+
+  DataBlock& operator=(const DataBlock& other) = default;
+  DataBlock& operator=(DataBlock&& other) noexcept = default;
+
   ~DataBlock() noexcept;
 
   const std::byte* data() const;
@@ -32,9 +47,23 @@ struct DataBlock {
   const std::byte* begin() const;
   const std::byte* end() const;
 
+  // Number of bytes that can still be appended in place, zero if the block
+  // doesn't own the end of its slab
+  size_t append_capacity() const;
+
+  // Copies as much of data as fits in place at the end of the block, returns
+  // the number of bytes appended
+  size_t append(const std::byte* data, size_t size);
+
+  // Space that append would copy into, for filling it in place. commit then
+  // adds the first size bytes of it to the block.
+  std::span<std::byte> free_space();
+  void commit(size_t size);
+
  private:
-  Bytes _data;
+  SlabRef _slab;
   size_t _start;
+  size_t _end;
 };
 
 struct DataBuffer {
@@ -42,6 +71,12 @@ struct DataBuffer {
   DataBuffer();
   explicit DataBuffer(const std::string& data);
 
+  DataBuffer(const DataBuffer& other);
+  DataBuffer(DataBuffer&& other) noexcept;
+
+  DataBuffer& operator=(const DataBuffer& other);
+  DataBuffer& operator=(DataBuffer&& other) noexcept;
+
   ~DataBuffer() noexcept;
 
   void write(const std::string& data);
@@ -65,11 +100,26 @@ struct DataBuffer {
 
   std::optional<std::string> read_line();
 
+  // Same as read_line, but when the line sits inside a single block it
+  // returns a view into it instead of copying. The view is only valid until
+  // the next call that modifies the buffer.
+  std::optional<std::string_view> read_line_view();
+
+  // Both O(1), the byte count is kept up to date by every mutation
   size_t size() const;
 
   bool empty() const;
 
-  DataBlock& top();
+  const DataBlock& top() const;
+
+  // Free space past the end of the buffer, for reading into it without an
+  // intermediate copy. reserve makes at least size bytes available, spread
+  // over the tail block and spare slabs. free_space fills regions with those
+  // areas in order and returns how many it filled. commit appends the first
+  // size bytes of that space to the buffer and drops the leftover spares.
+  void reserve(size_t size);
+  size_t free_space(std::span<std::span<std::byte>> regions);
+  void commit(size_t size);
 
   void consume(size_t bytes);
 
@@ -78,11 +128,23 @@ struct DataBuffer {
   std::deque<DataBlock>::const_iterator begin() const;
   std::deque<DataBlock>::const_iterator end() const;
 
-  std::deque<DataBlock>::iterator begin();
-  std::deque<DataBlock>::iterator end();
-
  private:
+  // Walks every block to validate the cached size, only does anything when
+  // BEE_DATA_BUFFER_CHECKS is defined
+  void _check_size() const;
+
+  // Offset of the first new line, bytes already known not to contain one are
+  // not scanned again
+  std::optional<size_t> _find_eol();
+
   std::deque<DataBlock> _blocks;
+  size_t _size;
+  size_t _scanned;
+
+  std::string _line_scratch;
+  std::optional<DataBlock> _view_pin;
+
+  std::vector<SlabRef> _spare;
 };
 
 } // namespace bee
@@ -31,5 +31,85 @@ TEST(test_1_byte)
   b.consume(1);
 }
 
+TEST(many_small_writes)
+{
+  DataBuffer b;
+  std::string expected;
+  for (int i = 0; i < 5000; i++) {
+    auto piece = F("<$>", i);
+    b.write(piece);
+    expected += piece;
+  }
+  P("size: $", b.size());
+  P("matches: $", b.to_string() == expected);
+  b.consume(20000);
+  P("after consume: $", b.read_string(10));
+}
+
+TEST(splice_and_prepend)
+{
+  DataBuffer b("middle ");
+  DataBuffer tail("tail");
+  DataBuffer head("head ");
+  b.write(std::move(tail));
+  b.prepend(std::move(head));
+  P(b.to_string());
+  P("moved from: '$' '$'", tail.to_string(), head.to_string());
+  b.write(std::string(" more"));
+  P(b.to_string());
+}
+
+TEST(copies_dont_share_tail)
+{
+  DataBuffer b1("shared");
+  DataBuffer b2 = b1;
+  b1.write(" one");
+  b2.write(" two");
+  P(b1.to_string());
+  P(b2.to_string());
+}
+
+TEST(large_writes)
+{
+  std::string large(100000, 'a');
+  DataBuffer b;
+  b.write("start ");
+  b.write(large);
+  b.write(Bytes(std::string(50000, 'b')));
+  b.write(" end");
+  P("size: $", b.size());
+  b.consume(large.size());
+  P(b.read_string(10));
+  b.consume(49996);
+  P(b.to_string());
+}
+
+TEST(read_line_view)
+{
+  DataBuffer b;
+  b.write("one\ntwo\nthr");
+  // Sharing the tail forces the next write into a new block
+  DataBuffer copy = b;
+  b.write("ee\nfour\n");
+  P("blocks: $", std::distance(b.begin(), b.end()));
+  b.prepend(DataBuffer("zero\n"));
+  while (auto line = b.read_line_view()) { P("'$'", *line); }
+  P("remaining: $", b.size());
+}
+
+TEST(read_line_incremental)
+{
+  DataBuffer b;
+  std::string long_line(40000, 'x');
+  for (size_t i = 0; i < long_line.size(); i += 1000) {
+    b.write(long_line.substr(i, 1000));
+    if (auto line = b.read_line()) { P("unexpected line: $", *line); }
+  }
+  b.write("\nafter\n");
+  auto line = b.read_line();
+  P("found: $ matches: $", line.has_value(), line == long_line);
+  P("next: $", *b.read_line());
+}
+
 } // namespace
 } // namespace bee
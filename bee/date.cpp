@@ -99,7 +99,14 @@ OrError<int> make_date_index(const DateTriple& triple)
 
 std::string DateTriple::to_string() const
 {
-  return F("{04}-{02}-{02}", year, month, day);
+  std::string output;
+  append_to(output);
+  return output;
+}
+
+void DateTriple::append_to(std::string& out) const
+{
+  format_to(out, "{04}-{02}-{02}", year, month, day);
 }
 
 Date::Date() : _date_index(0) {}
@@ -178,6 +185,8 @@ DateTriple Date::to_triple() const
 
 std::string Date::to_string() const { return to_triple().to_string(); }
 
+void Date::append_to(std::string& out) const { to_triple().append_to(out); }
+
 OrError<Date> Date::make_date(int year, int month, int day)
 {
   return make_date({year, month, day});
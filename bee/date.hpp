@@ -10,6 +10,7 @@ struct DateTriple {
   int day;
 
   std::string to_string() const;
+  void append_to(std::string& out) const;
 };
 
 struct Date {
@@ -37,6 +38,7 @@ struct Date {
 
   static OrError<Date> of_string(const std::string& str);
   std::string to_string() const;
+  void append_to(std::string& out) const;
 
   auto operator<=>(const Date& other) const = default;
 
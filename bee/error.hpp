@@ -33,7 +33,8 @@ struct Error {
 
   ~Error() noexcept;
 
-  template <class... Ts> static Error fmt(const char* fmt, Ts&&... args)
+  template <class... Ts>
+  static Error fmt(const FormatString<sizeof...(Ts)>& fmt, Ts&&... args)
   {
     return Error(F(fmt, std::forward<Ts>(args)...));
   }
@@ -62,9 +63,16 @@ struct Error {
 
 constexpr const char* maybe_format() { return ""; }
 
-template <class... Ts> std::string maybe_format(Ts&&... args)
+template <format_details::lone_arg T> std::string maybe_format(T&& v)
 {
-  return F(std::forward<Ts>(args)...);
+  return F(std::forward<T>(v));
+}
+
+template <class... Ts>
+std::string maybe_format(
+  const FormatString<sizeof...(Ts)>& fmt, Ts&&... args)
+{
+  return F(fmt, std::forward<Ts>(args)...);
 }
 
 #define EF(msg...) bee::Error(HERE, bee::maybe_format(msg))
@@ -0,0 +1,220 @@
+#include "event_loop.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+
+#include "errno_msg.hpp"
+#include "signal.hpp"
+
+namespace bee {
+namespace {
+
+constexpr int max_events = 64;
+
+// epoll_wait takes milliseconds, round up so alarms don't wake up early and
+// spin until their deadline
+int to_timeout_ms(std::optional<Span> timeout)
+{
+  if (!timeout.has_value()) { return -1; }
+  int64_t nanos = std::max<int64_t>(timeout->to_nanos(), 0);
+  return (nanos + 999999) / 1000000;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// EventLoop
+//
+
+EventLoop::EventLoop(FD&& epoll_fd, FD&& wake_fd)
+    : _epoll_fd(std::move(epoll_fd)),
+      _wake_fd(std::move(wake_fd).to_shared()),
+      _alarms(Time::monotonic())
+{}
+
+EventLoop::~EventLoop() noexcept {}
+
+OrError<EventLoop::ptr> EventLoop::create()
+{
+  int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    return Error::fmt("epoll_create1 failed: $", errno_msg());
+  }
+  FD epoll(epoll_fd);
+  int wake_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wake_fd < 0) { return Error::fmt("eventfd failed: $", errno_msg()); }
+  auto loop = ptr(new EventLoop(std::move(epoll), FD(wake_fd)));
+  auto drain = [l = loop.get()]() { l->_drain_wake_fd(); };
+  bail_unit(loop->add_fd(loop->_wake_fd, std::move(drain), {}));
+  return loop;
+}
+
+OrError<> EventLoop::add_fd(
+  const FD::shared_ptr& fd, callback&& on_readable, callback&& on_writable)
+{
+  bail_unit(fd->set_blocking(false));
+  uint32_t events = EPOLLET;
+  if (on_readable != nullptr) { events |= EPOLLIN | EPOLLRDHUP; }
+  if (on_writable != nullptr) { events |= EPOLLOUT; }
+  struct epoll_event event = {.events = events, .data = {.fd = fd->int_fd()}};
+  int epoll_fd = _epoll_fd.int_fd();
+  if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd->int_fd(), &event) != 0) {
+    return Error::fmt(
+      "Failed to add fd($) to epoll: $", fd->int_fd(), errno_msg());
+  }
+  _handlers[fd->int_fd()] = std::make_shared<Handler>(
+    Handler{
+      .fd = fd,
+      .on_readable = std::move(on_readable),
+      .on_writable = std::move(on_writable),
+    });
+  return ok();
+}
+
+OrError<> EventLoop::remove_fd(const FD::shared_ptr& fd)
+{
+  auto it = _handlers.find(fd->int_fd());
+  if (it == _handlers.end()) {
+    return Error::fmt("fd($) is not in the event loop", fd->int_fd());
+  }
+  _handlers.erase(it);
+  int epoll_fd = _epoll_fd.int_fd();
+  if (::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd->int_fd(), nullptr) != 0) {
+    return Error::fmt(
+      "Failed to remove fd($) from epoll: $", fd->int_fd(), errno_msg());
+  }
+  return ok();
+}
+
+TimerId EventLoop::add_alarm(Span timeout, callback&& fn)
+{
+  return _alarms.add(Time::monotonic() + timeout, std::move(fn));
+}
+
+bool EventLoop::cancel_alarm(TimerId id) { return _alarms.cancel(id); }
+
+OrError<> EventLoop::on_child_exit(child_exit_callback&& callback)
+{
+  if (_signal_fd != nullptr) {
+    return Error("A child exit callback is already set");
+  }
+  bail(signal_fd, Signal::create_signal_fd(SignalCode::SigChld));
+  _signal_fd = std::move(signal_fd).to_shared();
+  _on_child_exit = std::move(callback);
+  bail_unit(add_fd(
+    _signal_fd,
+    [this]() {
+      // SIGCHLD is not queued, a single notification can mean several exits,
+      // so reap until there is nothing left
+      struct signalfd_siginfo info;
+      while (true) {
+        auto ret = _signal_fd->read(
+          reinterpret_cast<std::byte*>(&info), sizeof(info));
+        if (ret.is_error() || ret.value().bytes_read() == 0) { break; }
+      }
+      _reap_children();
+    },
+    {}));
+  // Children that exited before the signal was blocked won't be signaled
+  add_alarm(Span::zero(), [this]() { _reap_children(); });
+  return ok();
+}
+
+void EventLoop::_reap_children()
+{
+  while (true) {
+    auto status = SubProcess::wait_any(false);
+    if (status.is_error()) {
+      _on_child_exit(std::move(status.error()));
+      continue;
+    }
+    if (!status.value().has_value()) { break; }
+    _on_child_exit(std::move(*status.value()));
+  }
+}
+
+void EventLoop::_drain_wake_fd()
+{
+  uint64_t value;
+  while (true) {
+    auto ret =
+      _wake_fd->read(reinterpret_cast<std::byte*>(&value), sizeof(value));
+    if (ret.is_error() || ret.value().bytes_read() == 0) { break; }
+  }
+}
+
+void EventLoop::_run_alarms()
+{
+  // Callbacks may add alarms, so they run once the wheel is done with them.
+  // The batch is moved out in case a callback runs the loop again.
+  auto due = std::move(_due_alarms);
+  _alarms.expire(Time::monotonic(), due);
+  for (auto& alarm : due) { alarm.fn(); }
+  due.clear();
+  _due_alarms = std::move(due);
+}
+
+OrError<> EventLoop::run_once(std::optional<Span> timeout)
+{
+  if (auto wakeup = _alarms.next_wakeup(); wakeup.has_value()) {
+    auto until_alarm = *wakeup - Time::monotonic();
+    if (!timeout.has_value() || until_alarm < *timeout) {
+      timeout = until_alarm;
+    }
+  }
+
+  std::array<struct epoll_event, max_events> events;
+  int num_events = ::epoll_wait(
+    _epoll_fd.int_fd(), events.data(), events.size(), to_timeout_ms(timeout));
+  if (num_events < 0) {
+    if (errno != EINTR) {
+      return Error::fmt("epoll_wait failed: $", errno_msg());
+    }
+    num_events = 0;
+  }
+
+  for (int i = 0; i < num_events; i++) {
+    auto it = _handlers.find(events[i].data.fd);
+    // Removed by an earlier callback in this same batch
+    if (it == _handlers.end()) { continue; }
+    // Keep the handler alive, the callback may remove it
+    auto handler = it->second;
+    uint32_t ev = events[i].events;
+    bool readable = ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+    if (readable && handler->on_readable != nullptr) { handler->on_readable(); }
+    if (ev & EPOLLOUT && handler->on_writable != nullptr) {
+      handler->on_writable();
+    }
+  }
+
+  _run_alarms();
+  return ok();
+}
+
+OrError<> EventLoop::run()
+{
+  while (!_stopped) { bail_unit(run_once()); }
+  _stopped = false;
+  return ok();
+}
+
+void EventLoop::stop()
+{
+  _stopped = true;
+  uint64_t value = 1;
+  std::ignore =
+    _wake_fd->write(reinterpret_cast<const std::byte*>(&value), sizeof(value));
+}
+
+size_t EventLoop::num_fds() const
+{
+  // The wake up fd is internal
+  return _handlers.size() - 1;
+}
+
+} // namespace bee
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "fd.hpp"
+#include "or_error.hpp"
+#include "span.hpp"
+#include "sub_process.hpp"
+#include "time.hpp"
+#include "timer_wheel.hpp"
+
+namespace bee {
+
+// Single threaded reactor over edge triggered epoll. FD callbacks only fire
+// when the fd goes from not ready to ready, so they have to read or write
+// until the fd would block. Alarms and child process exits are dispatched from
+// the same wait, without any extra thread.
+struct EventLoop {
+ public:
+  using ptr = std::unique_ptr<EventLoop>;
+
+  using callback = std::function<void()>;
+  using child_exit_callback =
+    std::function<void(OrError<SubProcess::ProcessStatus>&&)>;
+
+  static OrError<ptr> create();
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop(EventLoop&&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+  EventLoop& operator=(EventLoop&&) = delete;
+
+  ~EventLoop() noexcept;
+
+  // The fd is set to non-blocking. Either callback can be empty, a hang up or
+  // error on the fd is reported as readable.
+  OrError<> add_fd(
+    const FD::shared_ptr& fd, callback&& on_readable, callback&& on_writable);
+
+  // Must be called before the fd is closed
+  OrError<> remove_fd(const FD::shared_ptr& fd);
+
+  // Same as Alarms::add_alarm, but the callback runs from the loop
+  TimerId add_alarm(Span timeout, callback&& fn);
+
+  // Same as Alarms::cancel_alarm
+  bool cancel_alarm(TimerId id);
+
+  // Reaps child processes as they exit, driven by a signalfd for SIGCHLD.
+  // SIGCHLD gets blocked on the calling thread, which should be the only
+  // thread in the process for it to work reliably.
+  OrError<> on_child_exit(child_exit_callback&& callback);
+
+  // Waits for events for up to timeout, or until the next alarm, and runs
+  // their callbacks
+  OrError<> run_once(std::optional<Span> timeout = std::nullopt);
+
+  // Runs until stop is called
+  OrError<> run();
+
+  // Can be called from any thread
+  void stop();
+
+  size_t num_fds() const;
+
+ private:
+  struct Handler {
+    FD::shared_ptr fd;
+    callback on_readable;
+    callback on_writable;
+  };
+
+  EventLoop(FD&& epoll_fd, FD&& wake_fd);
+
+  void _run_alarms();
+  void _reap_children();
+  void _drain_wake_fd();
+
+  FD _epoll_fd;
+  FD::shared_ptr _wake_fd;
+  std::unordered_map<int, std::shared_ptr<Handler>> _handlers;
+
+  TimerWheel _alarms;
+  std::vector<TimerWheel::Expired> _due_alarms;
+
+  FD::shared_ptr _signal_fd;
+  child_exit_callback _on_child_exit;
+
+  std::atomic<bool> _stopped = false;
+};
+
+} // namespace bee
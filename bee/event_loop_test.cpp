@@ -0,0 +1,148 @@
+#include "event_loop.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include "format_vector.hpp"
+#include "testing.hpp"
+
+using std::string;
+using std::vector;
+
+namespace bee {
+namespace {
+
+Pipe create_pipe() { return Pipe::create().value(); }
+
+TEST(child_exit)
+{
+  must(loop, EventLoop::create());
+  vector<string> exits;
+  must_unit(loop->on_child_exit(
+    [&](OrError<SubProcess::ProcessStatus>&& status) {
+      must(s, status);
+      exits.push_back(F("exit status $", s.exit_status));
+    }));
+  for (const char* cmd : {"true", "false", "sleep"}) {
+    must(proc, SubProcess::spawn({.cmd = FilePath(cmd), .args = {"0.05"}}));
+    assert(proc != nullptr);
+  }
+  while (exits.size() < 3) { must_unit(loop->run_once(Span::of_seconds(5))); }
+  std::sort(exits.begin(), exits.end());
+  for (const auto& exit : exits) { P(exit); }
+  P("num_running_processes: $", SubProcess::num_running_processes());
+}
+
+TEST(alarms)
+{
+  must(loop, EventLoop::create());
+  vector<int> fired;
+  loop->add_alarm(Span::of_millis(30), [&]() { fired.push_back(30); });
+  loop->add_alarm(Span::of_millis(10), [&]() { fired.push_back(10); });
+  loop->add_alarm(Span::of_millis(20), [&]() {
+    fired.push_back(20);
+    loop->add_alarm(Span::of_millis(1), [&]() { fired.push_back(21); });
+  });
+  loop->add_alarm(Span::zero(), [&]() { fired.push_back(0); });
+  loop->add_alarm(Span::zero(), [&]() { fired.push_back(1); });
+  auto start = Time::monotonic();
+  while (fired.size() < 6) { must_unit(loop->run_once()); }
+  auto elapsed = Time::monotonic() - start;
+  P(fired);
+  P("not early: $", elapsed >= Span::of_millis(30));
+}
+
+TEST(readable)
+{
+  must(loop, EventLoop::create());
+  auto pipe = create_pipe();
+  DataBuffer received;
+  int callbacks = 0;
+  bool eof = false;
+  must_unit(loop->add_fd(
+    pipe.read_fd,
+    [&]() {
+      callbacks++;
+      auto ret = pipe.read_fd->read_all_available(received).value();
+      if (ret.is_eof()) { eof = true; }
+    },
+    {}));
+  P("num_fds: $", loop->num_fds());
+
+  // Both writes are ready by the time the loop waits, edge triggering gives a
+  // single callback for them
+  must_unit(pipe.write_fd->write("hello "));
+  must_unit(pipe.write_fd->write("world"));
+  must_unit(loop->run_once(Span::of_seconds(1)));
+  P("received: '$' callbacks: $", received.to_string(), callbacks);
+
+  pipe.write_fd->close();
+  while (!eof) { must_unit(loop->run_once(Span::of_seconds(1))); }
+  P("eof: $", eof);
+
+  must_unit(loop->remove_fd(pipe.read_fd));
+  P("num_fds: $", loop->num_fds());
+  P("remove again fails: $", loop->remove_fd(pipe.read_fd).is_error());
+}
+
+TEST(writable)
+{
+  must(loop, EventLoop::create());
+  auto pipe = create_pipe();
+  must_unit(pipe.read_fd->set_blocking(false));
+  int writable_calls = 0;
+  must_unit(loop->add_fd(pipe.write_fd, {}, [&]() { writable_calls++; }));
+  must_unit(loop->run_once(Span::zero()));
+  P("writable at start: $", writable_calls);
+
+  // Fill the pipe, it only becomes writable again after it gets drained
+  string chunk(4096, 'x');
+  while (true) {
+    must(written, pipe.write_fd->write(chunk));
+    if (pipe.write_fd->is_write_blocked()) { break; }
+    assert(written > 0);
+  }
+  must_unit(loop->run_once(Span::of_millis(10)));
+  P("writable while full: $", writable_calls);
+
+  DataBuffer drained;
+  must_unit(pipe.read_fd->read_all_available(drained));
+  must_unit(loop->run_once(Span::of_seconds(1)));
+  P("writable after drain: $", writable_calls);
+}
+
+TEST(remove_from_callback)
+{
+  must(loop, EventLoop::create());
+  vector<Pipe> pipes;
+  for (int i = 0; i < 4; i++) { pipes.push_back(create_pipe()); }
+  int calls = 0;
+  for (auto& pipe : pipes) {
+    must_unit(loop->add_fd(
+      pipe.read_fd,
+      [&]() {
+        calls++;
+        // Every callback removes all the fds, only the first one runs
+        for (auto& p : pipes) { std::ignore = loop->remove_fd(p.read_fd); }
+      },
+      {}));
+    must_unit(pipe.write_fd->write("x"));
+  }
+  must_unit(loop->run_once(Span::of_seconds(1)));
+  P("calls: $ num_fds: $", calls, loop->num_fds());
+}
+
+TEST(stop_from_other_thread)
+{
+  must(loop, EventLoop::create());
+  std::thread t([&]() {
+    Span::of_millis(20).sleep();
+    loop->stop();
+  });
+  must_unit(loop->run());
+  t.join();
+  P("stopped");
+}
+
+} // namespace
+} // namespace bee
@@ -1,8 +1,12 @@
 #include "fd.hpp"
 
+#include <algorithm>
+#include <span>
+
 #include <fcntl.h>
 #include <sys/file.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "bee/errno_msg.hpp"
@@ -43,6 +47,12 @@ OrError<std::pair<int, int>> agnostic_pipe()
 
 const bee::Error fd_closed_error("FD closed");
 
+constexpr int max_iovecs = 64;
+
+constexpr size_t max_read_chunk = max_iovecs * Slab::DefaultCapacity;
+
+constexpr size_t read_all_chunk = Slab::DefaultCapacity * 4;
+
 } // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -119,13 +129,50 @@ OrError<ReadResult> FD::read(std::byte* data, size_t size)
   return ReadResult(ret);
 }
 
+OrError<ReadResult> FD::readv(const struct iovec* iov, int count)
+{
+  if (is_closed()) [[unlikely]] { return fd_closed_error; }
+  auto ret = ::readv(_fd, iov, count);
+  if (ret == -1) [[unlikely]] {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) [[likely]] {
+      return ReadResult::empty();
+    } else if (errno == ECONNRESET) {
+      return ReadResult::eof();
+    } else {
+      return Error::fmt("Failed to readv fd($): $", _fd, errno_msg());
+    }
+  } else if (ret == 0) {
+    return ReadResult::eof();
+  }
+  return ReadResult(ret);
+}
+
+OrError<ReadResult> FD::_read_into(DataBuffer& buffer, size_t max_size)
+{
+  max_size = std::min(max_size, max_read_chunk);
+  buffer.reserve(max_size);
+  std::array<std::span<std::byte>, max_iovecs> regions;
+  size_t num_regions = buffer.free_space(regions);
+
+  std::array<struct iovec, max_iovecs> iov;
+  int count = 0;
+  size_t total = 0;
+  for (size_t i = 0; i < num_regions && total < max_size; i++) {
+    size_t len = std::min(regions[i].size(), max_size - total);
+    iov[count++] = {.iov_base = regions[i].data(), .iov_len = len};
+    total += len;
+  }
+
+  bail(ret, readv(iov.data(), count));
+  buffer.commit(ret.bytes_read());
+  return ret;
+}
+
 OrError<ReadResult> FD::read(DataBuffer& buffer, size_t size)
 {
-  std::byte bytes[1024];
   size_t bytes_read = 0;
   while (bytes_read < size) {
-    bail(ret, read(bytes, std::min(size - bytes_read, sizeof(bytes))));
-    buffer.write(bytes, ret.bytes_read());
+    bail(ret, _read_into(buffer, size - bytes_read));
     bytes_read += ret.bytes_read();
     if (ret.is_eof()) {
       if (bytes_read == 0) { return ReadResult::eof(); }
@@ -155,37 +202,23 @@ OrError<ReadResult> FD::recv(std::byte* data, size_t size)
 
 OrError<ReadResult> FD::read_all_available(DataBuffer& output)
 {
-  std::byte buffer[1024 * 2];
   size_t bytes_read = 0;
   while (true) {
-    bail(ret, read(buffer, sizeof(buffer)));
+    bail(ret, _read_into(output, read_all_chunk));
     if (ret.is_eof()) {
       if (bytes_read == 0) { return ReadResult::eof(); }
       break;
     }
     if (ret.bytes_read() == 0) { break; }
     bytes_read += ret.bytes_read();
-    output.write(buffer, ret.bytes_read());
   }
   return ReadResult(bytes_read);
 }
 
 OrError<ReadResult> FD::recv_all_available(DataBuffer& output)
 {
-  std::byte buffer[1024 * 2];
-  bool reached_eof = false;
-  size_t bytes_read = 0;
-  while (!reached_eof) {
-    bail(ret, recv(buffer, sizeof(buffer)));
-    if (ret.is_eof()) {
-      if (bytes_read == 0) { return ReadResult::eof(); }
-      break;
-    }
-    if (ret.bytes_read() == 0) { break; }
-    bytes_read += ret.bytes_read();
-    output.write(buffer, ret.bytes_read());
-  }
-  return ReadResult(bytes_read);
+  // readv treats a reset connection as EOF, same as recv
+  return read_all_available(output);
 }
 
 OrError<size_t> FD::write_raw(const std::byte* data, size_t size)
@@ -204,6 +237,51 @@ OrError<size_t> FD::write_raw(const std::byte* data, size_t size)
   return ret;
 }
 
+OrError<size_t> FD::writev(const struct iovec* iov, int count)
+{
+  if (is_closed()) [[unlikely]] { return fd_closed_error; }
+  _write_blocked = false;
+  if (count == 0) { return 0; }
+  auto ret = ::writev(_fd, iov, count);
+  if (ret == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      _write_blocked = true;
+      return 0;
+    }
+    return Error::fmt("Failed to writev file: $", errno_msg());
+  }
+  return ret;
+}
+
+OrError<size_t> FD::write_raw_blocks(const DataBuffer& data)
+{
+  std::array<struct iovec, max_iovecs> iov;
+  size_t written = 0;
+  auto block = data.begin();
+  // Bytes of the current block that were already written
+  size_t skip = 0;
+  while (block != data.end()) {
+    int count = 0;
+    size_t offset = skip;
+    for (auto it = block; it != data.end() && count < max_iovecs; it++) {
+      iov[count++] = {
+        .iov_base = const_cast<std::byte*>(it->data() + offset),
+        .iov_len = it->size() - offset,
+      };
+      offset = 0;
+    }
+    bail(ret, writev(iov.data(), count));
+    if (ret == 0) { break; }
+    written += ret;
+    skip += ret;
+    while (block != data.end() && skip >= block->size()) {
+      skip -= block->size();
+      block++;
+    }
+  }
+  return written;
+}
+
 OrError<> FD::dup_onto(const FD& onto)
 {
   if (_fd == -1) [[unlikely]]
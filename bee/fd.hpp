@@ -3,6 +3,8 @@
 #include <array>
 #include <memory>
 
+#include <sys/uio.h>
+
 #include "data_buffer.hpp"
 #include "file_mode.hpp"
 #include "file_path.hpp"
@@ -49,6 +51,12 @@ struct FD final : public Writer {
   OrError<ReadResult> read(std::byte* data, size_t size);
   OrError<ReadResult> recv(std::byte* data, size_t size);
 
+  // Scatter/gather versions of write_raw and read, with the same handling of
+  // blocking and errors
+  OrError<size_t> writev(const struct iovec* iov, int count);
+  OrError<ReadResult> readv(const struct iovec* iov, int count);
+
+  // Reads directly into the buffer's free space with readv
   OrError<ReadResult> read(DataBuffer& buffer, size_t size);
 
   OrError<ReadResult> read_all_available(DataBuffer& buffer);
@@ -76,7 +84,12 @@ struct FD final : public Writer {
 
   OrError<bool> lock(bool shared = false, bool block = false);
 
+ protected:
+  virtual OrError<size_t> write_raw_blocks(const DataBuffer& data) override;
+
  private:
+  OrError<ReadResult> _read_into(DataBuffer& buffer, size_t max_size);
+
   int _fd;
   bool _write_blocked;
 };
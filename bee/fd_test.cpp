@@ -0,0 +1,63 @@
+#include "fd.hpp"
+#include "testing.hpp"
+
+using std::string;
+
+namespace bee {
+namespace {
+
+DataBuffer create_buffer(int num_blocks, size_t block_size)
+{
+  DataBuffer buffer;
+  for (int i = 0; i < num_blocks; i++) {
+    DataBuffer block;
+    block.write(string(block_size, 'a' + i % 26));
+    // Keep the blocks apart so the writes have to gather them
+    DataBuffer copy = buffer;
+    buffer.write(std::move(block));
+  }
+  return buffer;
+}
+
+TEST(writev_readv_roundtrip)
+{
+  must(pipe, Pipe::create());
+  auto buffer = create_buffer(100, 300);
+  auto expected = buffer.to_string();
+  P("blocks: $", std::distance(buffer.begin(), buffer.end()));
+  must(written, pipe.write_fd->write(buffer));
+  P("written: $", written);
+  pipe.write_fd->close();
+
+  DataBuffer output;
+  must(ret, pipe.read_fd->read(output, expected.size()));
+  P("read: $", ret.bytes_read());
+  P("matches: $", output.to_string() == expected);
+  must(eof, pipe.read_fd->read_all_available(output));
+  P("eof: $", eof.is_eof());
+}
+
+TEST(partial_writes)
+{
+  must(pipe, Pipe::create());
+  must_unit(pipe.write_fd->set_blocking(false));
+  must_unit(pipe.read_fd->set_blocking(false));
+  auto buffer = create_buffer(40, 10000);
+  auto expected = buffer.to_string();
+
+  DataBuffer output;
+  bool saw_partial_write = false;
+  while (!buffer.empty()) {
+    must(written, pipe.write_fd->write(buffer));
+    if (written < buffer.size()) { saw_partial_write = true; }
+    buffer.consume(written);
+    must_unit(pipe.read_fd->read_all_available(output));
+  }
+  pipe.write_fd->close();
+  must_unit(pipe.read_fd->read_all_available(output));
+  P("saw partial write: $", saw_partial_write);
+  P("matches: $", output.to_string() == expected);
+}
+
+} // namespace
+} // namespace bee
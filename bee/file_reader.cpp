@@ -26,15 +26,17 @@ void append_bytes(T& output, const std::byte* begin, const std::byte* end)
 // FileReader
 //
 
-OrError<FileReader::ptr> FileReader::open(const FilePath& filename)
+OrError<FileReader::ptr> FileReader::open(
+  const FilePath& filename, const IOBufferOptions& options)
 {
   bail(fd, FD::open_file(filename));
-  return std::make_unique<FileReader>(std::move(fd).to_shared());
+  return std::make_unique<FileReader>(std::move(fd).to_shared(), options);
 }
 
-FileReader::ptr FileReader::from_fd(const FD::shared_ptr& fd)
+FileReader::ptr FileReader::from_fd(
+  const FD::shared_ptr& fd, const IOBufferOptions& options)
 {
-  return std::make_unique<FileReader>(fd);
+  return std::make_unique<FileReader>(fd, options);
 }
 
 FileReader::~FileReader() noexcept {}
@@ -48,7 +50,7 @@ OrError<size_t> FileReader::read_raw(std::byte* buffer, size_t size)
   total_read += _read_from_buffer(buffer, size);
   if (remaining() == 0) {
     // Nothing else to do there
-  } else if (remaining() < BufferSize) {
+  } else if (remaining() < _buffer.capacity()) {
     _maybe_read_more();
     total_read += _read_from_buffer(buffer + total_read, size - total_read);
   } else {
@@ -62,26 +64,59 @@ OrError<size_t> FileReader::read_raw(std::byte* buffer, size_t size)
 
 OrError<std::optional<string>> FileReader::read_line()
 {
-  string output;
+  bail(line, read_line_view());
+  if (!line.has_value()) { return std::nullopt; }
+  return string(*line);
+}
+
+OrError<std::optional<std::string_view>> FileReader::read_line_view()
+{
+  auto as_view = [](const std::byte* begin, const std::byte* end) {
+    return std::string_view(reinterpret_cast<const char*>(begin), end - begin);
+  };
+
   bool found_eol = false;
+  bool in_scratch = false;
+  std::string_view line;
   while (_maybe_read_more()) {
-    char c = static_cast<char>(_buffer[_buffer_pos++]);
-    if (c == '\n') {
+    auto begin = buffer_begin();
+    auto end = buffer_end();
+    auto eol = static_cast<const std::byte*>(memchr(begin, '\n', end - begin));
+    if (eol != nullptr) {
       found_eol = true;
+      if (in_scratch) {
+        append_bytes(_line_scratch, begin, eol);
+      } else {
+        line = as_view(begin, eol);
+      }
+      _buffer_pos += eol - begin + 1;
       break;
-    } else if (c == '\r') {
-      continue;
     }
-    output += c;
+    // The line continues past what is buffered, save what we have before the
+    // buffer gets refilled
+    if (!in_scratch) {
+      _line_scratch.clear();
+      in_scratch = true;
+    }
+    append_bytes(_line_scratch, begin, end);
+    clear_buffer();
   }
-  if (!found_eol && output.empty()) {
+  if (in_scratch) { line = _line_scratch; }
+
+  if (line.find('\r') != std::string_view::npos) {
+    if (!in_scratch) { _line_scratch.assign(line); }
+    std::erase(_line_scratch, '\r');
+    line = _line_scratch;
+  }
+
+  if (!found_eol && line.empty()) {
     if (_last_error.has_value()) {
       return *_last_error;
     } else if (_eof) {
       return std::nullopt;
     }
   }
-  return output;
+  return line;
 }
 
 OrError<vector<string>> FileReader::read_all_lines()
@@ -124,11 +159,20 @@ OrError<char> FileReader::read_char()
       return Error("Unexpected error");
     }
   }
-  return static_cast<char>(_buffer[_buffer_pos++]);
+  return static_cast<char>(_buffer.data()[_buffer_pos++]);
 }
 
-FileReader::FileReader(FD::shared_ptr&& fd) : _fd(std::move(fd)) {}
-FileReader::FileReader(const FD::shared_ptr& fd) : _fd(fd) {}
+FileReader::FileReader(FD::shared_ptr&& fd, const IOBufferOptions& options)
+    : _fd(std::move(fd)),
+      _options(options),
+      _buffer(options.capacity, options.page_aligned)
+{}
+
+FileReader::FileReader(const FD::shared_ptr& fd, const IOBufferOptions& options)
+    : _fd(fd),
+      _options(options),
+      _buffer(options.capacity, options.page_aligned)
+{}
 
 size_t FileReader::_available_on_buffer() const
 {
@@ -165,7 +209,7 @@ size_t FileReader::_read_full(std::byte* buffer, size_t size)
 size_t FileReader::_read_from_buffer(std::byte* buffer, size_t size)
 {
   size_t to_copy = std::min(size, _available_on_buffer());
-  memcpy(buffer, _buffer + _buffer_pos, to_copy);
+  memcpy(buffer, _buffer.data() + _buffer_pos, to_copy);
   _buffer_pos += to_copy;
   return to_copy;
 }
@@ -173,7 +217,14 @@ size_t FileReader::_read_from_buffer(std::byte* buffer, size_t size)
 bool FileReader::_maybe_read_more()
 {
   if (_buffer_has_data()) return true;
-  auto ret = _read_into(_buffer, BufferSize);
+  if (
+    _options.adaptive && _last_read_filled_buffer &&
+    _buffer.capacity() < _options.max_capacity) {
+    // The buffer is empty at this point, nothing to carry over
+    _buffer.reallocate(std::min(_buffer.capacity() * 2, _options.max_capacity));
+  }
+  auto ret = _read_into(_buffer.data(), _buffer.capacity());
+  _last_read_filled_buffer = ret == _buffer.capacity();
   if (ret == 0) return false;
   _buffer_pos = 0;
   _buffer_size = ret;
@@ -200,9 +251,11 @@ OrError<vector<std::byte>> FileReader::read_file_bytes(const FilePath& filename)
 
 bool FileReader::close() { return _fd->close(); }
 
+size_t FileReader::buffer_capacity() const { return _buffer.capacity(); }
+
 const std::byte* FileReader::buffer_begin() const
 {
-  return _buffer + _buffer_pos;
+  return _buffer.data() + _buffer_pos;
 }
 
 const std::byte* FileReader::buffer_end() const
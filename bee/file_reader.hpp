@@ -1,10 +1,13 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "fd.hpp"
 #include "file_path.hpp"
+#include "io_buffer.hpp"
 #include "or_error.hpp"
 #include "reader.hpp"
 
@@ -14,12 +17,14 @@ struct FileReader final : public Reader {
  public:
   using ptr = std::unique_ptr<FileReader>;
 
-  FileReader(FD::shared_ptr&& fd);
-  FileReader(const FD::shared_ptr& fd);
+  FileReader(FD::shared_ptr&& fd, const IOBufferOptions& options = {});
+  FileReader(const FD::shared_ptr& fd, const IOBufferOptions& options = {});
 
-  static OrError<ptr> open(const FilePath& filename);
+  static OrError<ptr> open(
+    const FilePath& filename, const IOBufferOptions& options = {});
 
-  static ptr from_fd(const FD::shared_ptr& fd);
+  static ptr from_fd(
+    const FD::shared_ptr& fd, const IOBufferOptions& options = {});
 
   static OrError<std::string> read_file(const FilePath& filename);
   static OrError<std::vector<std::byte>> read_file_bytes(
@@ -36,6 +41,10 @@ struct FileReader final : public Reader {
   virtual ~FileReader() noexcept;
 
   OrError<std::optional<std::string>> read_line();
+
+  // Same as read_line, but returns a view into the read buffer when the line
+  // is fully buffered. The view is only valid until the next read.
+  OrError<std::optional<std::string_view>> read_line_view();
   OrError<std::vector<std::string>> read_all_lines();
 
   OrError<std::string> read_all();
@@ -46,6 +55,8 @@ struct FileReader final : public Reader {
 
   virtual bool close() override;
 
+  size_t buffer_capacity() const;
+
   static FileReader& stdin_reader();
 
  protected:
@@ -66,14 +77,16 @@ struct FileReader final : public Reader {
   const std::byte* buffer_end() const;
   void clear_buffer();
 
-  static constexpr size_t BufferSize = 1 << 13;
-
   FD::shared_ptr _fd;
+  IOBufferOptions _options;
   size_t _buffer_pos = 0;
-  std::byte _buffer[BufferSize];
+  IOBuffer _buffer;
   size_t _buffer_size = 0;
+  bool _last_read_filled_buffer = false;
   bool _eof = false;
   std::optional<Error> _last_error;
+
+  std::string _line_scratch;
 };
 
 } // namespace bee
@@ -46,5 +46,80 @@ TEST(read_by_blocks)
   P(content.size());
 }
 
+TEST(read_lines)
+{
+  string long_line(20000, 'y');
+  must_unit(FileWriter::write_file(
+    tmp_filename, "first\r\nsecond\n\n" + long_line + "\nwith\rcr\nlast"));
+  must(file, FileReader::open(tmp_filename));
+  while (true) {
+    must(line, file->read_line());
+    if (!line.has_value()) { break; }
+    if (line->size() > 100) {
+      P("long line: $ matches: $", line->size(), *line == long_line);
+    } else {
+      P("'$'", *line);
+    }
+  }
+}
+
+TEST(read_line_view)
+{
+  string content;
+  for (int i = 0; i < 3000; i++) { content += F("line $\n", i); }
+  must_unit(FileWriter::write_file(tmp_filename, content));
+  must(file, FileReader::open(tmp_filename));
+  string content_read;
+  int count = 0;
+  while (true) {
+    must(line, file->read_line_view());
+    if (!line.has_value()) { break; }
+    content_read += *line;
+    content_read += '\n';
+    count++;
+  }
+  P("lines: $ matches: $", count, content_read == content);
+}
+
+TEST(buffer_options)
+{
+  string content = create_content();
+  auto run = [&](const IOBufferOptions& options) {
+    {
+      must(writer, FileWriter::create(tmp_filename, options));
+      for (size_t i = 0; i < content.size(); i += 1000) {
+        must_unit(writer->write(content.substr(i, 1000)));
+      }
+    }
+    must(reader, FileReader::open(tmp_filename, options));
+    string content_read;
+    char buf[100];
+    while (true) {
+      must(
+        bytes_read,
+        reader->read(reinterpret_cast<std::byte*>(buf), sizeof(buf)));
+      if (bytes_read == 0) { break; }
+      content_read.append(buf, bytes_read);
+    }
+    P("capacity:$ adaptive:$ final capacity:$ matches:$",
+      options.capacity,
+      options.adaptive,
+      reader->buffer_capacity(),
+      content_read == content);
+  };
+  run({.capacity = 16});
+  run({.capacity = 1 << 20});
+  run({.capacity = 1 << 16, .page_aligned = true});
+  run({.capacity = 4096, .adaptive = true, .max_capacity = 1 << 18});
+}
+
+TEST(page_aligned)
+{
+  IOBuffer buffer(100, true);
+  P("aligned: $",
+    reinterpret_cast<uintptr_t>(buffer.data()) % IOBuffer::page_size() == 0);
+  P("capacity: $", buffer.capacity() == IOBuffer::page_size());
+}
+
 } // namespace
 } // namespace bee
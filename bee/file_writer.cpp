@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 
 #include "fd.hpp"
 
@@ -11,8 +12,6 @@ using std::vector;
 namespace bee {
 namespace {
 
-constexpr size_t max_to_buffer = 1 << 12;
-
 OrError<size_t> write_to_fd(FD& fd, const std::byte* data, size_t size)
 {
   size_t bytes_writen = 0;
@@ -29,18 +28,24 @@ OrError<size_t> write_to_fd(FD& fd, const std::byte* data, size_t size)
 // FileWriter
 //
 
-FileWriter::FileWriter(FD&& fd, bool buffered)
-    : FileWriter(std::make_shared<FD>(std::move(fd)), buffered)
+FileWriter::FileWriter(
+  FD&& fd, bool buffered, const IOBufferOptions& options)
+    : FileWriter(std::make_shared<FD>(std::move(fd)), buffered, options)
 {}
 
-FileWriter::FileWriter(const FD::shared_ptr& fd, bool buffered)
-    : _fd(fd), _is_tty(_fd->is_tty()), _buffered(buffered)
+FileWriter::FileWriter(
+  const FD::shared_ptr& fd, bool buffered, const IOBufferOptions& options)
+    : _fd(fd),
+      _buffer(options.capacity, options.page_aligned),
+      _is_tty(_fd->is_tty()),
+      _buffered(buffered)
 {}
 
-OrError<FileWriter::ptr> FileWriter::create(const FilePath& filename)
+OrError<FileWriter::ptr> FileWriter::create(
+  const FilePath& filename, const IOBufferOptions& options)
 {
   bail(fd, FD::create_file(filename));
-  return ptr(new FileWriter(std::move(fd), true));
+  return ptr(new FileWriter(std::move(fd), true, options));
 }
 
 FileWriter::~FileWriter() noexcept { close(); }
@@ -53,14 +58,35 @@ bool FileWriter::close()
 
 OrError<size_t> FileWriter::write_raw(const std::byte* data, size_t size)
 {
-  if (size >= max_to_buffer) {
+  if (size >= _buffer.capacity()) {
     bail_unit(flush());
     return write_to_fd(*_fd, data, size);
-  } else {
-    _buffer.write(data, size);
-    if (_buffer.size() >= max_to_buffer || !_buffered) { bail_unit(flush()); }
-    return size;
   }
+  if (size > _buffer.capacity() - _buffer_size) { bail_unit(flush()); }
+  memcpy(_buffer.data() + _buffer_size, data, size);
+  _buffer_size += size;
+  if (_buffer_size == _buffer.capacity() || !_buffered) { bail_unit(flush()); }
+  return size;
+}
+
+OrError<size_t> FileWriter::write_raw_blocks(const DataBuffer& data)
+{
+  if (data.size() < _buffer.capacity()) {
+    return Writer::write_raw_blocks(data);
+  }
+  bail_unit(flush());
+  bail(written, _fd->write(data));
+  // The fd only stops short when it would block, finish block by block
+  size_t skip = written;
+  for (const auto& block : data) {
+    if (skip >= block.size()) {
+      skip -= block.size();
+      continue;
+    }
+    bail_unit(write_to_fd(*_fd, block.data() + skip, block.size() - skip));
+    skip = 0;
+  }
+  return data.size();
 }
 
 OrError<> FileWriter::write_file(
@@ -81,8 +107,8 @@ OrError<> FileWriter::write_file(
 
 OrError<> FileWriter::flush()
 {
-  bail_unit(write_to_fd(*_fd, _buffer.raw_data(), _buffer.size()));
-  _buffer.clear();
+  bail_unit(write_to_fd(*_fd, _buffer.data(), _buffer_size));
+  _buffer_size = 0;
   return ok();
 }
 
@@ -102,4 +128,6 @@ FileWriter& FileWriter::stdout()
 
 void FileWriter::set_buffered(bool buffered) { _buffered = buffered; }
 
+size_t FileWriter::buffer_capacity() const { return _buffer.capacity(); }
+
 } // namespace bee
@@ -4,9 +4,9 @@
 #include <memory>
 #include <string>
 
-#include "bytes_buffer.hpp"
 #include "fd.hpp"
 #include "file_path.hpp"
+#include "io_buffer.hpp"
 #include "or_error.hpp"
 #include "writer.hpp"
 
@@ -16,8 +16,11 @@ struct FileWriter final : public Writer {
  public:
   using ptr = std::unique_ptr<FileWriter>;
 
-  FileWriter(FD&& fd, bool buffered);
-  FileWriter(const FD::shared_ptr& fd, bool buffered);
+  FileWriter(FD&& fd, bool buffered, const IOBufferOptions& options = {});
+  FileWriter(
+    const FD::shared_ptr& fd,
+    bool buffered,
+    const IOBufferOptions& options = {});
 
   FileWriter(const FileWriter&) = delete;
   FileWriter(FileWriter&& other) = delete;
@@ -26,7 +29,8 @@ struct FileWriter final : public Writer {
 
   virtual ~FileWriter() noexcept;
 
-  static OrError<ptr> create(const FilePath& filename);
+  static OrError<ptr> create(
+    const FilePath& filename, const IOBufferOptions& options = {});
 
   // TODO: write function that takes DataBuffer&& and avoid copying to the
   // internal buffer
@@ -47,14 +51,20 @@ struct FileWriter final : public Writer {
 
   void set_buffered(bool buffered);
 
+  size_t buffer_capacity() const;
+
  protected:
   virtual OrError<size_t> write_raw(
     const std::byte* data, size_t size) override;
 
+  virtual OrError<size_t> write_raw_blocks(const DataBuffer& data) override;
+
  private:
   FD::shared_ptr _fd;
 
-  BytesBuffer _buffer;
+  // Writes at least as large as the buffer skip it
+  IOBuffer _buffer;
+  size_t _buffer_size = 0;
 
   const bool _is_tty;
 
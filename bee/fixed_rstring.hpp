@@ -2,6 +2,7 @@
 
 #include <array>
 #include <string>
+#include <string_view>
 
 namespace bee {
 
@@ -12,6 +13,8 @@ template <size_t S> struct fixed_rstring {
     return std::string(_data + _head, _data + S);
   }
 
+  void append_to(std::string& out) const { out.append(_data + _head, size()); }
+
   inline void prepend(char c) { _data[--_head] = c; }
 
   template <size_t N> inline void prepend(const std::array<char, N>& a)
@@ -20,6 +23,12 @@ template <size_t S> struct fixed_rstring {
     _head -= 3;
   }
 
+  inline void prepend(std::string_view s)
+  {
+    _head -= s.size();
+    s.copy(_data + _head, s.size());
+  }
+
   inline size_t size() const { return S - _head; }
   inline ssize_t ssize() const { return size(); }
 
@@ -1,9 +1,13 @@
 #include "float_of_string.hpp"
 
-#include <cmath>
+#include <array>
+#include <bit>
 #include <cstdint>
+#include <cstdlib>
 #include <limits>
+#include <string>
 
+#include "bee/big_uint.hpp"
 #include "bee/int_of_string.hpp"
 
 namespace bee {
@@ -11,8 +15,184 @@ namespace {
 
 const Error invalid_float_format_error("Malformed number");
 
+using uint128 = unsigned __int128;
+
+template <class T> struct Binary;
+
+template <> struct Binary<double> {
+  using Bits = uint64_t;
+  static constexpr int mantissa_bits = 52;
+  static constexpr int min_exponent = -1023;
+  static constexpr int infinite_power = 0x7ff;
+  // Below it any 64 bit mantissa times 10^q rounds to zero, above it to
+  // infinity
+  static constexpr int min_pow10 = -342;
+  static constexpr int max_pow10 = 308;
+  // Only there can w * 10^q fall exactly halfway between two doubles
+  static constexpr int min_round_to_even = -4;
+  static constexpr int max_round_to_even = 23;
+  // Largest power of ten that is exact
+  static constexpr int max_exact_pow10 = 22;
+
+  static double slow_parse(const std::string& str)
+  {
+    return std::strtod(str.c_str(), nullptr);
+  }
+};
+
+template <> struct Binary<float> {
+  using Bits = uint32_t;
+  static constexpr int mantissa_bits = 23;
+  static constexpr int min_exponent = -127;
+  static constexpr int infinite_power = 0xff;
+  static constexpr int min_pow10 = -65;
+  static constexpr int max_pow10 = 38;
+  static constexpr int min_round_to_even = -17;
+  static constexpr int max_round_to_even = 10;
+  static constexpr int max_exact_pow10 = 10;
+
+  static float slow_parse(const std::string& str)
+  {
+    return std::strtof(str.c_str(), nullptr);
+  }
+};
+
+template <class T, int N> constexpr std::array<T, N + 1> make_exact_pow10()
+{
+  std::array<T, N + 1> table;
+  T p = 1;
+  for (auto& v : table) {
+    v = p;
+    p *= 10;
+  }
+  return table;
+}
+
+template <class T>
+constexpr auto exact_pow10 =
+  make_exact_pow10<T, Binary<T>::max_exact_pow10>();
+
+constexpr int min_q = Binary<double>::min_pow10;
+constexpr int max_q = Binary<double>::max_pow10;
+
+// 5^q normalized to [2^127, 2^128) and truncated. For negative q it is
+// 2^b / 5^-q rounded up before being truncated, so products with it can be
+// exact for the smaller powers.
+constexpr std::array<uint128, max_q - min_q + 1> make_pow5_table()
+{
+  std::array<uint128, max_q - min_q + 1> table;
+  auto pow5 = BigUint<24>::pow2(0);
+  for (int q = 0; q <= max_q; q++) {
+    if (q > 0) { pow5.mul(5); }
+    table[q - min_q] = pow5.shifted(pow5.bit_width() - 128);
+  }
+  // Dividing 2^m by five repeatedly gives floor(2^m / 5^k), from which
+  // floor(2^b / 5^k) is a shift for any b <= m
+  constexpr int m = 1728;
+  auto inv_pow5 = BigUint<55>::pow2(m);
+  for (int q = -1; q >= min_q; q--) {
+    inv_pow5.div(5);
+    // Bits of 5^-q
+    const int z = ((-q * 1217359) >> 19) + 1;
+    if (q >= -27) {
+      table[q - min_q] = inv_pow5.shifted(m - z - 127) + 1;
+    } else {
+      // floor(2^b / 5^-q) + 1 for b = 2z + 128, truncated to 128 bits, the
+      // one only carries into the kept bits when the dropped ones are all
+      // set
+      const int b = 2 * z + 128;
+      const int shift = inv_pow5.bit_width() - 128;
+      table[q - min_q] =
+        inv_pow5.shifted(shift) + inv_pow5.all_ones(m - b, shift);
+    }
+  }
+  return table;
+}
+
+constexpr auto pow5_table = make_pow5_table();
+
+// A float as its mantissa without the implicit bit and its biased exponent
+struct AdjustedMantissa {
+  uint64_t mantissa;
+  // -1 if the product was not precise enough to round it
+  int power2;
+};
+
+// Eisel-Lemire, the float closest to w * 10^q. The top 64 bits of w * 5^q
+// computed from the 128 bit table are almost always enough to round, when
+// they aren't power2 is set to -1.
+template <class T> AdjustedMantissa eisel_lemire(int64_t q64, uint64_t w)
+{
+  using B = Binary<T>;
+  if (w == 0 || q64 < B::min_pow10) { return {0, 0}; }
+  if (q64 > B::max_pow10) { return {0, B::infinite_power}; }
+  const int q = q64;
+
+  const int lz = std::countl_zero(w);
+  w <<= lz;
+  const uint128 pow5 = pow5_table[q - min_q];
+  uint128 product = uint128(w) * uint64_t(pow5 >> 64);
+  // The lower half of the power only matters if the bits below the ones
+  // kept could carry
+  constexpr uint64_t precision_mask = ~uint64_t(0) >> (B::mantissa_bits + 3);
+  if ((uint64_t(product >> 64) & precision_mask) == precision_mask) {
+    product += (uint128(w) * uint64_t(pow5)) >> 64;
+  }
+  const uint64_t high = product >> 64;
+  const uint64_t low = product;
+  // Out of [-27, 55] the power is not exact and the product may be just
+  // below a carry
+  if (low == ~uint64_t(0) && (q < -27 || q > 55)) { return {0, -1}; }
+
+  const int upper_bit = high >> 63;
+  const int shift = upper_bit + 64 - B::mantissa_bits - 3;
+  uint64_t mantissa = high >> shift;
+  // floor(log2(10^q)) + 63 is the exponent of the product
+  int power2 = ((217706 * q) >> 16) + 63 + upper_bit - lz - B::min_exponent;
+
+  if (power2 <= 0) {
+    // Subnormal, or rounds up to the smallest normal
+    if (-power2 + 1 >= 64) { return {0, 0}; }
+    mantissa >>= -power2 + 1;
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    power2 = mantissa < (uint64_t(1) << B::mantissa_bits) ? 0 : 1;
+    return {mantissa & ((uint64_t(1) << B::mantissa_bits) - 1), power2};
+  }
+
+  // Rounds half up unless the product is exactly halfway and the mantissa
+  // is even, which needs the product to be exact
+  if (
+    low <= 1 && q >= B::min_round_to_even && q <= B::max_round_to_even &&
+    (mantissa & 3) == 1 && (mantissa << shift) == high) {
+    mantissa &= ~uint64_t(1);
+  }
+  mantissa += mantissa & 1;
+  mantissa >>= 1;
+  if (mantissa >= (uint64_t(2) << B::mantissa_bits)) {
+    mantissa = uint64_t(1) << B::mantissa_bits;
+    power2++;
+  }
+  mantissa &= ~(uint64_t(1) << B::mantissa_bits);
+  if (power2 >= B::infinite_power) { return {0, B::infinite_power}; }
+  return {mantissa, power2};
+}
+
+template <class T> T make_float(bool negative, const AdjustedMantissa& am)
+{
+  using B = Binary<T>;
+  using Bits = typename B::Bits;
+  Bits bits = Bits(am.mantissa) | (Bits(am.power2) << B::mantissa_bits);
+  if (negative) { bits |= Bits(1) << (sizeof(Bits) * 8 - 1); }
+  return std::bit_cast<T>(bits);
+}
+
+// The significant digits after the leading zeros that fit in 64 bits
+constexpr int max_digits = 19;
+
 template <class T> OrError<T> of_string_impl(const std::string_view& str)
 {
+  using B = Binary<T>;
   if (str == "inf") {
     return std::numeric_limits<T>::infinity();
   } else if (str == "-inf") {
@@ -37,17 +217,29 @@ template <class T> OrError<T> of_string_impl(const std::string_view& str)
     idx++;
   }
 
-  T value = 0;
+  // The value is mantissa * 10^exponent, truncated is set if non zero
+  // digits didn't fit in the mantissa
+  uint64_t mantissa = 0;
+  int num_digits = 0;
+  bool truncated = false;
   bool is_decimals = false;
   bool has_digits = false;
-  int exponent = 0;
+  int64_t exponent = 0;
   for (; idx < str.size(); idx++) {
     char c = str[idx];
-    if (isdigit(c)) {
+    if (c >= '0' && c <= '9') {
       int d = c - '0';
-      value = value * 10.0 + d;
-      if (is_decimals) { exponent--; }
       has_digits = true;
+      if (num_digits == 0 && d == 0) {
+        if (is_decimals) { exponent--; }
+      } else if (num_digits < max_digits) {
+        mantissa = mantissa * 10 + d;
+        num_digits++;
+        if (is_decimals) { exponent--; }
+      } else {
+        truncated |= d != 0;
+        if (!is_decimals) { exponent++; }
+      }
     } else if (c == ',' || c == '_') {
       continue;
     } else if (c == '.') {
@@ -64,20 +256,48 @@ template <class T> OrError<T> of_string_impl(const std::string_view& str)
 
   if (!has_digits) { return invalid_float_format_error; }
 
-  if (negated) { value = -value; }
-  if (exponent != 0) { value *= std::pow(10.0, exponent); }
-  return value;
+  // Both the mantissa and the power of ten are exact, so a single rounding
+  if (
+    !truncated && -B::max_exact_pow10 <= exponent &&
+    exponent <= B::max_exact_pow10 &&
+    mantissa <= (uint64_t(1) << (B::mantissa_bits + 1))) {
+    T value = mantissa;
+    if (exponent < 0) {
+      value /= exact_pow10<T>[-exponent];
+    } else {
+      value *= exact_pow10<T>[exponent];
+    }
+    return negated ? -value : value;
+  }
+
+  auto am = eisel_lemire<T>(exponent, mantissa);
+  if (truncated && am.power2 >= 0) {
+    // The digits dropped are enough to matter only if rounding the
+    // mantissa up gives a different float
+    auto upper = eisel_lemire<T>(exponent, mantissa + 1);
+    if (upper.power2 != am.power2 || upper.mantissa != am.mantissa) {
+      am.power2 = -1;
+    }
+  }
+  if (am.power2 >= 0) { return make_float<T>(negated, am); }
+
+  // Rarely taken, the digits are too close to halfway between two floats
+  std::string cleaned;
+  for (char c : str) {
+    if (c != ',' && c != '_') { cleaned += c; }
+  }
+  return B::slow_parse(cleaned);
 }
 
 } // namespace
 
-#define IMPLEMENT_PARSER(T, F)                                                 \
+#define IMPLEMENT_PARSER(T)                                                    \
   OrError<T> FloatOfString<T>::parse(const std::string_view& str)              \
   {                                                                            \
     return of_string_impl<T>(str);                                             \
   }
 
-IMPLEMENT_PARSER(float, std::stof);
-IMPLEMENT_PARSER(double, std::stod);
+IMPLEMENT_PARSER(float);
+IMPLEMENT_PARSER(double);
 
 } // namespace bee
@@ -1,5 +1,11 @@
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <random>
 #include <sstream>
 
 #include "testing.hpp"
@@ -64,5 +70,67 @@ TEST(of_string)
   run_test("-0.");
 }
 
+template <class T> T strto(const std::string& str)
+{
+  if constexpr (std::is_same_v<T, float>) {
+    return std::strtof(str.c_str(), nullptr);
+  } else {
+    return std::strtod(str.c_str(), nullptr);
+  }
+}
+
+// Compares the bits, as a float and a double
+int check_matches_strtod(const std::string& str)
+{
+  auto check = [&]<class T>(T) {
+    auto value = FloatOfString<T>::parse(str).value();
+    auto expected = strto<T>(str);
+    if (std::bit_cast<uint64_t>(double(value)) ==
+        std::bit_cast<uint64_t>(double(expected))) {
+      return 0;
+    }
+    P("$: '$' expected '$'", str, value, expected);
+    return 1;
+  };
+  return check(0.0) + check(0.0f);
+}
+
+TEST(matches_strtod)
+{
+  std::mt19937_64 gen(42);
+  char buf[64];
+
+  int failures = 0;
+  for (int i = 0; i < 200000; i++) {
+    auto value = std::bit_cast<double>(gen());
+    if (!std::isfinite(value)) { continue; }
+    snprintf(buf, sizeof(buf), "%.*e", int(gen() % 26), value);
+    failures += check_matches_strtod(buf);
+  }
+  P("random doubles, failures: $", failures);
+
+  failures = 0;
+  for (int i = 0; i < 200000; i++) {
+    std::string str;
+    int num_digits = 1 + gen() % 40;
+    int dot = gen() % (num_digits + 1);
+    for (int j = 0; j < num_digits; j++) {
+      if (j == dot) { str += '.'; }
+      str += char('0' + gen() % 10);
+    }
+    str += F("e$", int(gen() % 700) - 360);
+    failures += check_matches_strtod(str);
+  }
+  P("random digits, failures: $", failures);
+
+  // Exactly halfway between two doubles, ties go to even
+  failures = 0;
+  for (int i = 0; i < 200000; i++) {
+    uint64_t mantissa = (uint64_t(1) << 52) | (gen() >> 12);
+    failures += check_matches_strtod(F((2 * mantissa + 1) << (gen() % 10)));
+  }
+  P("halfway doubles, failures: $", failures);
+}
+
 } // namespace
 } // namespace bee
@@ -2,9 +2,12 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cmath>
 #include <cstdint>
+#include <limits>
 
+#include "big_uint.hpp"
 #include "fixed_rstring.hpp"
 #include "int_to_string.hpp"
 #include "to_string_t.hpp"
@@ -204,6 +207,140 @@ struct float10 {
   int _exp = 0;
 };
 
+// Shortest decimal that rounds back to the same float, with the Schubfach
+// algorithm of Raffaello Giulietti, a relative of Ryu and Dragonbox. The
+// value is scaled by a 128 bit approximation of a power of ten so that the
+// bounds of its rounding interval are known to the unit, the shortest
+// decimal in the interval is then one of at most four candidates.
+namespace shortest {
+
+using uint128 = unsigned __int128;
+
+// floor(log2(10^e)), floor(log10(2^e)) and floor(log10(3/4 * 2^e)), exact
+// for the exponents of doubles
+constexpr int floor_log2_pow10(int e) { return (e * 1741647) >> 19; }
+constexpr int floor_log10_pow2(int e) { return (e * 1262611) >> 22; }
+constexpr int floor_log10_three_quarters_pow2(int e)
+{
+  return (e * 1262611 - 524031) >> 22;
+}
+
+constexpr int min_k = -292;
+constexpr int max_k = 324;
+
+// g(k) = floor(10^k * 2^(127 - floor(log2(10^k)))) + 1, in [2^127, 2^128)
+constexpr std::array<uint128, max_k - min_k + 1> make_pow10_table()
+{
+  std::array<uint128, max_k - min_k + 1> table;
+  auto pow10 = BigUint<40>::pow2(0);
+  for (int k = 0; k <= max_k; k++) {
+    if (k > 0) { pow10.mul(10); }
+    table[k - min_k] = pow10.shifted(floor_log2_pow10(k) - 127) + 1;
+  }
+  // floor(floor(x / 10) / 10) = floor(x / 100), so dividing 2^m by ten
+  // repeatedly gives floor(2^m / 10^k)
+  constexpr int m = 1152;
+  auto inv_pow10 = BigUint<40>::pow2(m);
+  for (int k = -1; k >= min_k; k--) {
+    inv_pow10.div(10);
+    table[k - min_k] = inv_pow10.shifted(m + floor_log2_pow10(k) - 127) + 1;
+  }
+  return table;
+}
+
+constexpr auto pow10_table = make_pow10_table();
+
+// The integer part of g * cp / 2^128, with its lowest bit set if the
+// fractional part is not zero
+constexpr uint64_t round_to_odd(uint128 g, uint64_t cp)
+{
+  const uint128 x = uint128(uint64_t(g)) * cp;
+  const uint128 y = uint128(uint64_t(g >> 64)) * cp;
+  const uint64_t z = uint64_t(y) + uint64_t(x >> 64);
+  const uint64_t vb = uint64_t(y >> 64) + (z < uint64_t(y));
+  return vb | (z > 1);
+}
+
+// value must be finite and positive
+template <class T> float10 to_float10(T value)
+{
+  using Bits = std::conditional_t<sizeof(T) == 8, uint64_t, uint32_t>;
+  constexpr int mantissa_bits = std::numeric_limits<T>::digits - 1;
+  constexpr int bias = std::numeric_limits<T>::max_exponent - 1 + mantissa_bits;
+
+  const Bits bits = std::bit_cast<Bits>(value);
+  const uint64_t f = bits & ((Bits(1) << mantissa_bits) - 1);
+  const int e = bits >> mantissa_bits;
+
+  uint64_t c;
+  int q;
+  if (e != 0) {
+    c = f | (uint64_t(1) << mantissa_bits);
+    q = e - bias;
+    // Integers that fit in the mantissa are their own shortest decimal
+    if (-mantissa_bits <= q && q <= 0 && (c & ((uint64_t(1) << -q) - 1)) == 0) {
+      auto out = float10(c >> -q, 0);
+      out.normalize();
+      return out;
+    }
+  } else {
+    c = f;
+    q = 1 - bias;
+  }
+
+  // The rounding interval is [c - 1/2, c + 1/2] * 2^q, closed when c is even
+  // as ties round to even, and only [c - 1/4, c + 1/2] * 2^q when c is a
+  // power of two as the float below is closer
+  const bool closed = c % 2 == 0;
+  const bool lower_closer = f == 0 && e > 1;
+  const uint64_t cbl = 4 * c - 2 + lower_closer;
+  const uint64_t cb = 4 * c;
+  const uint64_t cbr = 4 * c + 2;
+
+  const int k = lower_closer ? floor_log10_three_quarters_pow2(q)
+                             : floor_log10_pow2(q);
+  const int h = q + floor_log2_pow10(-k) + 1;
+  const uint128 g = pow10_table[-k - min_k];
+
+  // The interval and value scaled by 4 * 10^-k
+  const uint64_t vbl = round_to_odd(g, cbl << h);
+  const uint64_t vb = round_to_odd(g, cb << h);
+  const uint64_t vbr = round_to_odd(g, cbr << h);
+  const uint64_t lower = vbl + !closed;
+  const uint64_t upper = vbr - !closed;
+
+  // A multiple of ten in the interval gives a shorter decimal, there is at
+  // most one
+  const uint64_t s = vb / 4;
+  if (s >= 10) {
+    const uint64_t sp = s / 10;
+    const bool up_inside = lower <= 40 * sp;
+    const bool wp_inside = 40 * sp + 40 <= upper;
+    if (up_inside != wp_inside) {
+      auto out = float10(sp + wp_inside, k + 1);
+      out.normalize();
+      return out;
+    }
+  }
+
+  // Otherwise one of the integers around the value, the closest if both are
+  // in the interval
+  const bool u_inside = lower <= 4 * s;
+  const bool w_inside = 4 * s + 4 <= upper;
+  uint64_t digits;
+  if (u_inside != w_inside) {
+    digits = s + w_inside;
+  } else {
+    const uint64_t mid = 4 * s + 2;
+    digits = s + (vb > mid || (vb == mid && (s & 1) != 0));
+  }
+  auto out = float10(digits, k);
+  out.normalize();
+  return out;
+}
+
+} // namespace shortest
+
 inline void add_digits(
   fixed_rstring<1024>& output,
   uint64_t number,
@@ -235,30 +372,46 @@ inline bool should_use_exp_notation(int decimal_places, const float10& num)
   return digits < -max_exp + 1 || digits > max_exp;
 }
 
-std::string format_float(double number, const FormatParams& p)
+// Shortest decimals are written in full up to 21 integer digits or 5 zeros
+// after the point
+inline bool should_use_exp_notation_shortest(const float10& num)
 {
-  if (std::isnan(number)) { return "nan"; }
+  const int digits = num.mantissa_num_digits() + num.exp();
+  return digits < -5 || digits > 21;
+}
+
+template <class T>
+void format_float(fixed_rstring<1024>& output, T value, const FormatParams& p)
+{
+  double number = value;
+
+  if (std::isnan(number)) {
+    output.prepend("nan");
+    return;
+  }
 
   if (std::isinf(number)) {
     if (number < 0) {
-      return "-inf";
+      output.prepend("-inf");
     } else if (p.sign) {
-      return "+inf";
+      output.prepend("+inf");
     } else {
-      return "inf";
+      output.prepend("inf");
     }
+    return;
   }
 
-  fixed_rstring<1024> output;
+  // Shortest decimals have as many decimal places as they need
+  const bool exact_decimal_places = p.exact_decimal_places && !p.shortest;
 
   if (number == 0) {
-    if (p.exact_decimal_places) {
+    if (exact_decimal_places) {
       for (int i = 0; i < p.decimal_places; i++) { output.prepend('0'); }
       output.prepend('.');
     }
     add_digits(output, 0, 0, p.left_pad_zeroes, p.comma);
     if (p.sign) { output.prepend('+'); }
-    return output.to_string();
+    return;
   }
 
   bool negative = false;
@@ -267,10 +420,13 @@ std::string format_float(double number, const FormatParams& p)
     number = -number;
   }
 
-  auto num = float10::of_float(number);
+  auto num =
+    p.shortest ? shortest::to_float10(T(number)) : float10::of_float(number);
 
-  if (!p.fixed && should_use_exp_notation(p.decimal_places, num)) {
-    num.round_inplace(p.decimal_places + 1);
+  if (
+    !p.fixed && (p.shortest ? should_use_exp_notation_shortest(num)
+                            : should_use_exp_notation(p.decimal_places, num))) {
+    if (!p.shortest) { num.round_inplace(p.decimal_places + 1); }
     const int want_exp = -num.mantissa_num_digits() + 1;
     int exp_n = num.exp() - want_exp;
     num.mul_exp10(-exp_n);
@@ -283,12 +439,12 @@ std::string format_float(double number, const FormatParams& p)
     add_digits(output, exp_n, 0, 0, false);
     if (negated) { output.prepend('-'); }
     output.prepend('e');
-  } else {
+  } else if (!p.shortest) {
     num.round_inplace(num.mantissa_num_digits() + num.exp() + p.decimal_places);
   }
 
   if (num.exp() >= 0) {
-    if (p.exact_decimal_places && p.decimal_places > 0) {
+    if (exact_decimal_places && p.decimal_places > 0) {
       add_digits(output, 0, p.decimal_places, 0, false);
       output.prepend('.');
     }
@@ -303,7 +459,7 @@ std::string format_float(double number, const FormatParams& p)
     add_digits(
       output,
       d,
-      p.exact_decimal_places ? p.decimal_places - fast_int::count_digits(d) : 0,
+      exact_decimal_places ? p.decimal_places - fast_int::count_digits(d) : 0,
       -num.exp(),
       false);
     output.prepend('.');
@@ -315,10 +471,23 @@ std::string format_float(double number, const FormatParams& p)
   } else if (p.sign) {
     output.prepend('+');
   }
+}
 
+template <class T> std::string format_float(T number, const FormatParams& p)
+{
+  fixed_rstring<1024> output;
+  format_float(output, number, p);
   return output.to_string();
 }
 
+template <class T>
+void append_float(std::string& out, T number, const FormatParams& p)
+{
+  fixed_rstring<1024> output;
+  format_float(output, number, p);
+  output.append_to(out);
+}
+
 } // namespace
 
 std::string float_to_string(double number) { return format_float(number, {}); }
@@ -328,9 +497,21 @@ std::string to_string_t<float>::convert(float value, const FormatParams& p)
   return format_float(value, p);
 }
 
+void to_string_t<float>::append(
+  std::string& out, float value, const FormatParams& p)
+{
+  append_float(out, value, p);
+}
+
 std::string to_string_t<double>::convert(double value, const FormatParams& p)
 {
   return format_float(value, p);
 }
 
+void to_string_t<double>::append(
+  std::string& out, double value, const FormatParams& p)
+{
+  append_float(out, value, p);
+}
+
 } // namespace bee
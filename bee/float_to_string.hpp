@@ -11,10 +11,12 @@ std::string float_to_string(double number);
 
 template <> struct to_string_t<float> {
   static std::string convert(float value, const FormatParams& p);
+  static void append(std::string& out, float value, const FormatParams& p);
 };
 
 template <> struct to_string_t<double> {
   static std::string convert(double value, const FormatParams& p);
+  static void append(std::string& out, double value, const FormatParams& p);
 };
 
 } // namespace bee
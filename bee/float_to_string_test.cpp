@@ -0,0 +1,146 @@
+#include "float_to_string.hpp"
+
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <iterator>
+#include <random>
+
+#include "float_of_string.hpp"
+#include "testing.hpp"
+
+namespace bee {
+namespace {
+
+TEST(shortest)
+{
+  auto t = [](auto v) { return F("{r}", v); };
+  PRINT_EXPR(t(0.1));
+  PRINT_EXPR(t(0.1f));
+  PRINT_EXPR(t(1.0 / 3.0));
+  PRINT_EXPR(t(1.0f / 3.0f));
+  PRINT_EXPR(t(0.1 + 0.2));
+  PRINT_EXPR(t(3.141592653589793));
+  PRINT_EXPR(t(2.5));
+  PRINT_EXPR(t(-1234.5678));
+  PRINT_EXPR(t(100.0));
+  PRINT_EXPR(t(123456789012345678.0));
+  PRINT_EXPR(t(9007199254740993.0));
+  PRINT_EXPR(t(1e21));
+  PRINT_EXPR(t(1e22));
+  PRINT_EXPR(t(1e23));
+  PRINT_EXPR(t(1e-5));
+  PRINT_EXPR(t(1e-6));
+  PRINT_EXPR(t(1.5e-7));
+  PRINT_EXPR(t(5e-324));
+  PRINT_EXPR(t(std::numeric_limits<double>::min()));
+  PRINT_EXPR(t(std::numeric_limits<double>::max()));
+  PRINT_EXPR(t(std::numeric_limits<float>::denorm_min()));
+  PRINT_EXPR(t(std::numeric_limits<float>::max()));
+  PRINT_EXPR(t(0.0));
+  PRINT_EXPR(t(std::numeric_limits<double>::infinity()));
+  PRINT_EXPR(t(std::nan("")));
+}
+
+TEST(shortest_with_other_params)
+{
+  PRINT_EXPR(F("{r,}", 1234567.125));
+  PRINT_EXPR(F("{r+}", 0.3));
+  PRINT_EXPR(F("{rf}", 1.5e30));
+  PRINT_EXPR(F("{r05}", 2.25));
+  PRINT_EXPR(F("{rp.2}", 2.0));
+  PRINT_EXPR(F("{r.2}", 1.0 / 3.0));
+}
+
+template <class T> T parse(const std::string& str)
+{
+  return FloatOfString<T>::parse(str).value();
+}
+
+std::string significant_digits(const std::string& str)
+{
+  std::string digits;
+  for (char c : str) {
+    if (c == 'e') { break; }
+    if (std::isdigit(c) && (c != '0' || !digits.empty())) { digits += c; }
+  }
+  while (!digits.empty() && digits.back() == '0') { digits.pop_back(); }
+  return digits;
+}
+
+// The shortest decimal must parse back to the value, and have the digits of
+// the shortest scientific std::to_chars, which also picks the closest
+template <class T> int check_round_trip(T value)
+{
+  auto str = F("{r}", value);
+  char expected[64];
+  auto res = std::to_chars(
+    expected, std::end(expected), value, std::chars_format::scientific);
+  *res.ptr = 0;
+  if (
+    parse<T>(str) != value ||
+    significant_digits(str) != significant_digits(expected)) {
+    P("$ expected $", str, expected);
+    return 1;
+  }
+  return 0;
+}
+
+template <class T> int check_neighbours(T value)
+{
+  return check_round_trip(value) +
+         check_round_trip(
+           std::nextafter(value, std::numeric_limits<T>::infinity())) +
+         check_round_trip(std::nextafter(value, T(0)));
+}
+
+TEST(round_trip_floats)
+{
+  // Every float in [1, 2), the other exponents differ from it in their
+  // scaling by a power of ten
+  int failures = 0;
+  int count = 0;
+  for (uint32_t bits = std::bit_cast<uint32_t>(1.0f);
+       bits < std::bit_cast<uint32_t>(2.0f);
+       bits++) {
+    failures += check_round_trip(std::bit_cast<float>(bits));
+    count++;
+  }
+  for (int e = std::numeric_limits<float>::min_exponent - 24;
+       e < std::numeric_limits<float>::max_exponent;
+       e++) {
+    failures += check_neighbours(std::ldexp(1.0f, e));
+    count += 3;
+  }
+  P("checked: $ failures: $", count, failures);
+}
+
+TEST(round_trip_doubles)
+{
+  int failures = 0;
+  int count = 0;
+  for (int e = std::numeric_limits<double>::min_exponent - 53;
+       e < std::numeric_limits<double>::max_exponent;
+       e++) {
+    failures += check_neighbours(std::ldexp(1.0, e));
+    count += 3;
+  }
+  for (int e = -323; e <= 308; e++) {
+    failures += check_neighbours(parse<double>(F("1e$", e)));
+    count += 3;
+  }
+  std::mt19937_64 gen(42);
+  while (count < 2000000) {
+    auto value = std::bit_cast<double>(gen());
+    if (!std::isfinite(value)) { continue; }
+    failures += check_round_trip(value);
+    count++;
+  }
+  P("checked: $ failures: $", count, failures);
+}
+
+} // namespace
+} // namespace bee
@@ -27,19 +27,15 @@ void write_one_rec(
   raise_exn(loc, fmt, idx, "Extra formats in format string");
 }
 
+void format_string_error(const char* msg)
+{
+  throw Exn(std::string("Invalid format string: ") + msg);
+}
+
 std::optional<FormatParams> get_next_format(
   const Location& loc, std::string& output, const char* fmt, int& idx)
 {
-  auto read_number = [&]() {
-    int number = 0;
-    while (isdigit(fmt[idx])) {
-      number = number * 10 + (fmt[idx] - '0');
-      idx++;
-    }
-    return number;
-  };
   while (fmt[idx]) {
-    FormatParams params;
     if ((fmt[idx] == '$' && fmt[idx + 1] != '$')) {
       idx++;
       return FormatParams();
@@ -51,43 +47,10 @@ std::optional<FormatParams> get_next_format(
       idx += 2;
     } else if (fmt[idx] == '{') {
       idx++;
-      while (fmt[idx] && fmt[idx] != '}') {
-        char c = fmt[idx];
-        idx++;
-        switch (c) {
-        case ',': {
-          params.comma = true;
-        } break;
-        case '.': {
-          params.decimal_places = read_number();
-        } break;
-        case '+': {
-          params.sign = true;
-        } break;
-        case 'f': {
-          params.fixed = true;
-        } break;
-        case 'p': {
-          params.exact_decimal_places = true;
-        } break;
-        case ' ': {
-          params.left_pad_spaces = read_number();
-        } break;
-        case '0': {
-          params.left_pad_zeroes = read_number();
-        } break;
-        case 'x': {
-          params.hex = true;
-        } break;
-        default: {
-          raise_exn(loc, fmt, idx - 1, "Unexpected character in format");
-        }
-        }
-      }
-      if (fmt[idx] == 0) {
-        raise_exn(loc, fmt, idx, "Format string ended unexpectedly");
+      FormatParams params;
+      if (auto err = parse_format_params(fmt, idx, params)) {
+        raise_exn(loc, fmt, idx, err);
       }
-      idx++;
       return params;
     } else {
       output += fmt[idx];
@@ -1,23 +1,79 @@
 #pragma once
 
+#include <array>
 #include <cassert>
 #include <optional>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
+#include <utility>
 
 #include "location.hpp"
 #include "to_string.hpp"
 
 namespace bee {
 
-template <class T> std::string convert_container(const T& container)
+template <size_t NumArgs> struct FormatString;
+struct RuntimeFormat;
+
+namespace format_details {
+
+template <class T> constexpr bool is_format_string = false;
+template <size_t N> constexpr bool is_format_string<FormatString<N>> = true;
+template <> constexpr bool is_format_string<RuntimeFormat> = true;
+
+template <class T>
+constexpr bool is_literal = std::is_array_v<std::remove_reference_t<T>> &&
+                            std::is_same_v<
+                              std::remove_extent_t<std::remove_reference_t<T>>,
+                              const char>;
+
+// A single argument is converted as is, it is only a format string if it is a
+// literal. Checked before stringable, which fails hard on format strings.
+template <class T>
+concept lone_arg = !is_literal<T> &&
+                   !is_format_string<std::remove_cvref_t<T>> && stringable<T>;
+
+template <class T>
+concept appendable =
+  requires(std::string& out, const T& value, const FormatParams& p) {
+    to_string_t<std::decay_t<T>>::append(out, value, p);
+  };
+
+template <stringable T>
+void append_value(std::string& out, T&& value, const FormatParams& p)
 {
-  std::string output;
+  if constexpr (appendable<T>) {
+    to_string_t<std::decay_t<T>>::append(out, value, p);
+  } else {
+    out += to_string(std::forward<T>(value), p);
+  }
+}
+
+} // namespace format_details
+
+// Appends the string of value to out. Types with an append in their
+// to_string_t, the builtins, the std containers, Span, Time and Date, are
+// written in place, the others go through a string from to_string.
+template <format_details::lone_arg T>
+void format_to(std::string& out, T&& value, const FormatParams& p = {})
+{
+  format_details::append_value(out, std::forward<T>(value), p);
+}
+
+template <class T> void append_container(std::string& out, const T& container)
+{
+  const size_t start = out.size();
   for (const auto& el : container) {
-    if (!output.empty()) { output += " "; }
-    output += to_string(el);
+    if (out.size() > start) { out += " "; }
+    format_details::append_value(out, el, FormatParams());
   }
+}
+
+template <class T> std::string convert_container(const T& container)
+{
+  std::string output;
+  append_container(output, container);
   return output;
 }
 
@@ -25,6 +81,67 @@ namespace format_details {
 
 void raise_exn(const Location& loc, const char* fmt, int idx, const char* msg);
 
+// Not constexpr on purpose, reaching it while a format string is parsed at
+// compile time makes the compilation fail with msg in the notes.
+void format_string_error(const char* msg);
+
+// Parses the parameters of a '{...}' placeholder, fmt[idx] is the character
+// after the '{'. On success idx is left after the '}' and nullptr is
+// returned, otherwise the error is returned and idx is left on the offending
+// character.
+constexpr const char* parse_format_params(
+  const char* fmt, int& idx, FormatParams& params)
+{
+  auto read_number = [&]() {
+    int number = 0;
+    while (fmt[idx] >= '0' && fmt[idx] <= '9') {
+      number = number * 10 + (fmt[idx] - '0');
+      idx++;
+    }
+    return number;
+  };
+  while (fmt[idx] && fmt[idx] != '}') {
+    char c = fmt[idx];
+    idx++;
+    switch (c) {
+    case ',': {
+      params.comma = true;
+    } break;
+    case '.': {
+      params.decimal_places = read_number();
+    } break;
+    case '+': {
+      params.sign = true;
+    } break;
+    case 'f': {
+      params.fixed = true;
+    } break;
+    case 'p': {
+      params.exact_decimal_places = true;
+    } break;
+    case ' ': {
+      params.left_pad_spaces = read_number();
+    } break;
+    case '0': {
+      params.left_pad_zeroes = read_number();
+    } break;
+    case 'x': {
+      params.hex = true;
+    } break;
+    case 'r': {
+      params.shortest = true;
+    } break;
+    default: {
+      idx--;
+      return "Unexpected character in format";
+    }
+    }
+  }
+  if (fmt[idx] == 0) { return "Format string ended unexpectedly"; }
+  idx++;
+  return nullptr;
+}
+
 std::optional<FormatParams> get_next_format(
   const Location& loc, std::string& output, const char* fmt, int& idx);
 
@@ -46,7 +163,7 @@ void write_one_rec(
   T&& v1,
   Ts&&... args)
 {
-  output += to_string(v1, params);
+  append_value(output, std::forward<T>(v1), params);
   format_rec2(loc, fmt, idx, output, std::forward<Ts>(args)...);
 }
 
@@ -72,16 +189,135 @@ void format_rec2(
   }
 }
 
-template <stringable T> std::string format(const Location&, T&& v)
+} // namespace format_details
+
+// A format string literal for NumArgs arguments, parsed at compile time. The
+// literal text between placeholders is kept as offsets into the string and
+// the parameters of every placeholder are resolved, so formatting only
+// copies text and converts the arguments. Malformed placeholders and
+// argument count mismatches fail the compilation.
+template <size_t NumArgs> struct FormatString {
+ public:
+  template <size_t N> consteval FormatString(const char (&fmt)[N]) : _fmt(fmt)
+  {
+    int idx = 0;
+    for (size_t i = 0; i <= NumArgs; i++) {
+      Text& text = _texts[i];
+      text.begin = idx;
+      while (fmt[idx]) {
+        if (
+          (fmt[idx] == '$' && fmt[idx + 1] == '$') ||
+          (fmt[idx] == '{' && fmt[idx + 1] == '{')) {
+          text.escaped = true;
+          idx += 2;
+        } else if (fmt[idx] == '$' || fmt[idx] == '{') {
+          break;
+        } else {
+          idx++;
+        }
+      }
+      text.end = idx;
+      if (i == NumArgs) {
+        if (fmt[idx]) {
+          format_details::format_string_error(
+            "Extra formats in format string");
+        }
+      } else if (fmt[idx] == 0) {
+        format_details::format_string_error("Extra arguments in format");
+      } else if (fmt[idx++] == '{') {
+        using format_details::parse_format_params;
+        if (auto err = parse_format_params(fmt, idx, _params[i])) {
+          format_details::format_string_error(err);
+        }
+      }
+    }
+  }
+
+  const char* fmt() const { return _fmt; }
+
+  template <stringable... Ts>
+    requires(sizeof...(Ts) == NumArgs)
+  void append(std::string& output, Ts&&... args) const
+  {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      ((_append_text(output, I),
+        format_details::append_value(output, args, _params[I])),
+       ...);
+    }(std::index_sequence_for<Ts...>());
+    _append_text(output, NumArgs);
+  }
+
+ private:
+  // Literal text in _fmt[begin, end), escaped is set if it contains '$$' or
+  // '{{'
+  struct Text {
+    int begin = 0;
+    int end = 0;
+    bool escaped = false;
+  };
+
+  void _append_text(std::string& output, size_t i) const
+  {
+    const Text& text = _texts[i];
+    if (!text.escaped) {
+      output.append(_fmt + text.begin, text.end - text.begin);
+      return;
+    }
+    // Every '$' or '{' in the text is the first of a pair
+    for (int idx = text.begin; idx < text.end; idx++) {
+      output += _fmt[idx];
+      if (_fmt[idx] == '$' || _fmt[idx] == '{') { idx++; }
+    }
+  }
+
+  const char* _fmt;
+  std::array<Text, NumArgs + 1> _texts;
+  std::array<FormatParams, NumArgs> _params;
+};
+
+// A format string only known at runtime, parsed on every call. Errors are
+// raised as Exn.
+struct RuntimeFormat {
+  const char* fmt;
+};
+
+inline RuntimeFormat runtime_format(const char* fmt) { return {fmt}; }
+inline RuntimeFormat runtime_format(const std::string& fmt)
+{
+  return {fmt.c_str()};
+}
+
+// Appends the formatted string to out. Not constrained on stringable, it is
+// checked by append, as Ts would be checked first in overload resolution
+// with format_to(out, value, params).
+template <class... Ts>
+void format_to(
+  std::string& out, const FormatString<sizeof...(Ts)>& fmt, Ts&&... args)
+{
+  fmt.append(out, std::forward<Ts>(args)...);
+}
+
+namespace format_details {
+
+template <lone_arg T> std::string format(const Location&, T&& v)
 {
   return to_string(v);
 }
 
 template <stringable... Ts>
-std::string format(const Location& loc, const char* fmt, Ts&&... args)
+std::string format(
+  const Location&, const FormatString<sizeof...(Ts)>& fmt, Ts&&... args)
 {
   std::string output;
-  format_rec2(loc, fmt, 0, output, std::forward<Ts>(args)...);
+  fmt.append(output, std::forward<Ts>(args)...);
+  return output;
+}
+
+template <stringable... Ts>
+std::string format(const Location& loc, RuntimeFormat fmt, Ts&&... args)
+{
+  std::string output;
+  format_rec2(loc, fmt.fmt, 0, output, std::forward<Ts>(args)...);
   return output;
 }
 
@@ -93,13 +329,20 @@ void print_str(const std::string& str);
 
 inline void print_line(const std::string& str) { print_str(str); }
 
-template <stringable T> void print_line(const Location& loc, T&& v)
+template <lone_arg T> void print_line(const Location& loc, T&& v)
 {
   print_str(bee::format_details::format(loc, std::forward<T>(v)));
 }
 
 template <stringable... Ts>
-void print_line(const Location& loc, const char* fmt, Ts&&... args)
+void print_line(
+  const Location& loc, const FormatString<sizeof...(Ts)>& fmt, Ts&&... args)
+{
+  print_str(bee::format_details::format(loc, fmt, std::forward<Ts>(args)...));
+}
+
+template <stringable... Ts>
+void print_line(const Location& loc, RuntimeFormat fmt, Ts&&... args)
 {
   print_str(bee::format_details::format(loc, fmt, std::forward<Ts>(args)...));
 }
@@ -110,20 +353,28 @@ void print_line(const Location& loc, const char* fmt, Ts&&... args)
 
 void print_err_str(const std::string& str);
 
-inline void print_err_line(const Location&, const std::string& str)
+template <lone_arg T> void print_err_line(const Location& loc, T&& v)
 {
-  print_err_str(str);
+  if constexpr (std::is_same_v<std::decay_t<T>, std::string>) {
+    print_err_str(v);
+  } else {
+    print_err_str(bee::format_details::format(loc, std::forward<T>(v)));
+  }
 }
 
-template <stringable T> void print_err_line(const Location& loc, T&& v)
+template <stringable... Ts>
+void print_err_line(
+  const Location& loc, const FormatString<sizeof...(Ts)>& fmt, Ts&&... args)
 {
-  print_err_str(bee::format_details::format(loc, std::forward<T>(v)));
+  print_err_str(
+    bee::format_details::format(loc, fmt, std::forward<Ts>(args)...));
 }
 
 template <stringable... Ts>
-void print_err_line(const Location& loc, const char* fmt, Ts... args)
+void print_err_line(const Location& loc, RuntimeFormat fmt, Ts&&... args)
 {
-  print_err_str(bee::format_details::format(loc, fmt, args...));
+  print_err_str(
+    bee::format_details::format(loc, fmt, std::forward<Ts>(args)...));
 }
 
 } // namespace format_details
@@ -143,6 +394,12 @@ template <stringable T, stringable F> struct to_string_t<std::pair<T, F>> {
   {
     return F("[$ $]", p.first, p.second);
   }
+
+  static void append(
+    std::string& out, const std::pair<T, F>& p, const FormatParams&)
+  {
+    format_to(out, "[$ $]", p.first, p.second);
+  }
 };
 
 } // namespace bee
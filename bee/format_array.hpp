@@ -13,6 +13,12 @@ template <class T, size_t S> struct to_string_t<std::array<T, S>> {
   {
     return convert_container(values);
   }
+
+  static void append(
+    std::string& out, const std::array<T, S>& values, const FormatParams&)
+  {
+    append_container(out, values);
+  }
 };
 
 } // namespace bee
@@ -13,6 +13,12 @@ template <class T, class F> struct to_string_t<std::map<T, F>> {
   {
     return convert_container(values);
   }
+
+  static void append(
+    std::string& out, const std::map<T, F>& values, const FormatParams&)
+  {
+    append_container(out, values);
+  }
 };
 
 template <class T, class F> struct to_string_t<std::multimap<T, F>> {
@@ -20,6 +26,12 @@ template <class T, class F> struct to_string_t<std::multimap<T, F>> {
   {
     return convert_container(values);
   }
+
+  static void append(
+    std::string& out, const std::multimap<T, F>& values, const FormatParams&)
+  {
+    append_container(out, values);
+  }
 };
 
 } // namespace bee
@@ -3,6 +3,7 @@
 #include <optional>
 #include <string>
 
+#include "format.hpp"
 #include "to_string.hpp"
 #include "to_string_t.hpp"
 
@@ -20,6 +21,16 @@ template <class T> struct to_string_t<std::optional<T>> {
       return "<nullopt>";
     }
   }
+
+  static void append(
+    std::string& out, const std::optional<T>& value, const FormatParams& p)
+  {
+    if (value.has_value()) {
+      format_to(out, *value, p);
+    } else {
+      out += "<nullopt>";
+    }
+  }
 };
 
 } // namespace bee
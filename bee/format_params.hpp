@@ -9,6 +9,9 @@ struct FormatParams {
   bool fixed = false;
   bool exact_decimal_places = false;
   bool hex = false;
+  // Shortest decimal that parses back to the same value, ignores
+  // decimal_places
+  bool shortest = false;
   int left_pad_zeroes = 0;
   int left_pad_spaces = 0;
 };
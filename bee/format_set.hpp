@@ -13,6 +13,12 @@ template <class T> struct to_string_t<std::set<T>> {
   {
     return convert_container(values);
   }
+
+  static void append(
+    std::string& out, const std::set<T>& values, const FormatParams&)
+  {
+    append_container(out, values);
+  }
 };
 
 } // namespace bee
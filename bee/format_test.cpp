@@ -1,9 +1,15 @@
 #include <limits>
 
+#include "date.hpp"
 #include "exn.hpp"
 #include "file_path.hpp"
 #include "format.hpp"
+#include "format_map.hpp"
+#include "format_optional.hpp"
+#include "format_vector.hpp"
+#include "span.hpp"
 #include "testing.hpp"
+#include "time.hpp"
 
 namespace bee {
 namespace {
@@ -154,7 +160,7 @@ TEST(raise_on_format_error)
     P("=======");
     P("fmt: '$'", fmt);
     P("-------");
-    print_exn([fmt, args...]() { P(fmt, args...); });
+    print_exn([fmt, args...]() { P(runtime_format(fmt), args...); });
   };
   run_test("nothing");
   run_test("{}", 1);
@@ -285,5 +291,59 @@ TEST(hex)
   PRINT_EXPR(F("{08x}", 0xabcd));
 }
 
+TEST(escapes)
+{
+  PRINT_EXPR(F("$$"));
+  PRINT_EXPR(F("$$$", 1));
+  PRINT_EXPR(F("{{$}", 1));
+  PRINT_EXPR(F("a$$b{{c$$${05}{{", 1, 2));
+  PRINT_EXPR(F("${.2f}$", 1, 2.5, "x"));
+}
+
+TEST(runtime_format)
+{
+  std::string fmt = "[$] [{,}] $$";
+  PRINT_EXPR(F(runtime_format(fmt), "a", 1234567));
+  PRINT_EXPR(F(fmt));
+  PRINT_EXPR(F(runtime_format(fmt.c_str() + 4), 1234567));
+}
+
+TEST(format_to)
+{
+  std::string out = "start:";
+  format_to(out, 42);
+  format_to(out, ' ');
+  format_to(out, 1234567, {.comma = true});
+  format_to(out, ' ');
+  format_to(out, 2.5, {.decimal_places = 2, .exact_decimal_places = true});
+  format_to(out, ' ');
+  format_to(out, std::string("str"), {.left_pad_spaces = 5});
+  format_to(out, '|');
+  P(out);
+
+  out.clear();
+  format_to(out, std::vector<int>{1, 2, 3});
+  format_to(out, " | ");
+  format_to(out, std::map<std::string, double>{{"a", 0.5}, {"b", -1}});
+  format_to(out, " | ");
+  format_to(out, std::optional<int>(7));
+  format_to(out, " | ");
+  format_to(out, std::optional<int>());
+  P(out);
+
+  out.clear();
+  format_to(out, Span::of_millis(1500));
+  format_to(out, " ");
+  format_to(out, Date(2024, 2, 29));
+  format_to(out, " ");
+  format_to(out, Time::of_nanos_since_epoch(1700000000123456789));
+  P(out);
+
+  out.clear();
+  format_to(out, "[$ {03} $$]", true, 7);
+  format_to(out, "[$]", std::vector<std::string>{"", "x"});
+  P(out);
+}
+
 } // namespace
 } // namespace bee
@@ -13,6 +13,12 @@ template <class T> struct to_string_t<std::vector<T>> {
   {
     return convert_container(values);
   }
+
+  static void append(
+    std::string& out, const std::vector<T>& values, const FormatParams&)
+  {
+    append_container(out, values);
+  }
 };
 
 } // namespace bee
@@ -0,0 +1,83 @@
+#include "futex.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include "time.hpp"
+
+#ifdef __linux
+
+#include <climits>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace bee {
+namespace {
+
+long futex(std::atomic<uint32_t>& word, int op, uint32_t val, timespec* ts)
+{
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+  return ::syscall(
+    SYS_futex, reinterpret_cast<uint32_t*>(&word), op, val, ts, nullptr, 0);
+}
+
+} // namespace
+
+bool Futex::wait(
+  std::atomic<uint32_t>& word, uint32_t expected, std::optional<Span> timeout)
+{
+  timespec ts;
+  timespec* ts_ptr = nullptr;
+  if (timeout.has_value()) {
+    int64_t nanos = std::max<int64_t>(timeout->to_nanos(), 0);
+    ts.tv_sec = nanos / 1000000000;
+    ts.tv_nsec = nanos % 1000000000;
+    ts_ptr = &ts;
+  }
+  long ret = futex(word, FUTEX_WAIT_PRIVATE, expected, ts_ptr);
+  return ret == 0 || errno != ETIMEDOUT;
+}
+
+void Futex::wake_one(std::atomic<uint32_t>& word)
+{
+  futex(word, FUTEX_WAKE_PRIVATE, 1, nullptr);
+}
+
+void Futex::wake_all(std::atomic<uint32_t>& word)
+{
+  futex(word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+}
+
+} // namespace bee
+
+#else
+
+namespace bee {
+
+// No futex with a timeout, untimed waits go through std::atomic::wait and
+// timed waits poll
+bool Futex::wait(
+  std::atomic<uint32_t>& word, uint32_t expected, std::optional<Span> timeout)
+{
+  if (!timeout.has_value()) {
+    word.wait(expected);
+    return true;
+  }
+  auto deadline = Time::monotonic() + *timeout;
+  while (word.load() == expected) {
+    auto now = Time::monotonic();
+    if (now >= deadline) { return false; }
+    std::min(deadline - now, Span::of_micros(100)).sleep();
+  }
+  return true;
+}
+
+void Futex::wake_one(std::atomic<uint32_t>& word) { word.notify_one(); }
+
+void Futex::wake_all(std::atomic<uint32_t>& word) { word.notify_all(); }
+
+} // namespace bee
+
+#endif
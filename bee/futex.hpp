@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+#include "span.hpp"
+
+namespace bee {
+
+// Parks threads on a 32 bit atomic word. Unlike std::atomic::wait it takes a
+// timeout, and sleepers are not tracked, so waking is always a syscall, callers
+// should record in the word itself whether anybody sleeps on it.
+struct Futex {
+ public:
+  // Sleeps while word == expected, until woken or the timeout expires. Returns
+  // false only if it timed out, spurious wake ups are possible.
+  static bool wait(
+    std::atomic<uint32_t>& word,
+    uint32_t expected,
+    std::optional<Span> timeout = std::nullopt);
+
+  static void wake_one(std::atomic<uint32_t>& word);
+  static void wake_all(std::atomic<uint32_t>& word);
+
+  // Hint for the body of spin loops
+  static inline void cpu_relax()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+};
+
+} // namespace bee
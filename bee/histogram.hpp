@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "format.hpp"
+#include "span.hpp"
+
+namespace bee {
+
+namespace histogram_details {
+
+template <class T> struct Value;
+
+template <> struct Value<int64_t> {
+  static int64_t to_int(int64_t value) { return value; }
+  static int64_t of_int(int64_t value) { return value; }
+};
+
+template <> struct Value<Span> {
+  static int64_t to_int(Span value) { return value.to_nanos(); }
+  static Span of_int(int64_t value) { return Span::of_nanos(value); }
+};
+
+} // namespace histogram_details
+
+// Log-linear histogram in the style of HdrHistogram. Values below 256 get a
+// bucket each, above that every power of two is split in 128 buckets, so a
+// bucket is never wider than 1/128th of its values. Values are clamped to
+// [0, 2^48), which is 78 hours for spans. Memory is fixed, about 43KB,
+// recording is O(1). The min and max are exact.
+//
+// Not thread safe, histograms filled by different threads can be merged.
+template <class T = int64_t> struct Histogram {
+ public:
+  Histogram() : _counts(NumBuckets, 0) {}
+
+  void record(T value, uint64_t count = 1)
+  {
+    int64_t v = std::max<int64_t>(Value::to_int(value), 0);
+    _counts[_bucket_of(v)] += count;
+    _count += count;
+    _sum += double(v) * count;
+    _min = std::min(_min, v);
+    _max = std::max(_max, v);
+  }
+
+  void merge(const Histogram& other)
+  {
+    for (int i = 0; i < NumBuckets; i++) { _counts[i] += other._counts[i]; }
+    _count += other._count;
+    _sum += other._sum;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+  }
+
+  void clear()
+  {
+    std::fill(_counts.begin(), _counts.end(), 0);
+    _count = 0;
+    _sum = 0;
+    _min = std::numeric_limits<int64_t>::max();
+    _max = 0;
+  }
+
+  uint64_t count() const { return _count; }
+  bool empty() const { return _count == 0; }
+
+  T min() const { return Value::of_int(empty() ? 0 : _min); }
+  T max() const { return Value::of_int(_max); }
+  T mean() const
+  {
+    return Value::of_int(empty() ? 0 : std::llround(_sum / _count));
+  }
+
+  // Smallest recorded value such that a fraction q of the values are at most
+  // it, q in [0, 1]. Exact up to the width of its bucket, the largest value
+  // of the bucket is returned.
+  T quantile(double q) const
+  {
+    if (empty()) { return Value::of_int(0); }
+    uint64_t rank = std::clamp<uint64_t>(std::ceil(q * _count), 1, _count);
+    uint64_t seen = 0;
+    for (int i = 0; i < NumBuckets; i++) {
+      seen += _counts[i];
+      if (seen >= rank) {
+        // The last bucket also holds the values that were clamped
+        int64_t highest = i == NumBuckets - 1 ? _max : _highest_of(i);
+        return Value::of_int(std::clamp(highest, _min, _max));
+      }
+    }
+    return Value::of_int(_max);
+  }
+
+  std::string to_string() const
+  {
+    return F(
+      "count:$ min:$ p50:$ p90:$ p99:$ p999:$ max:$",
+      count(),
+      min(),
+      quantile(0.5),
+      quantile(0.9),
+      quantile(0.99),
+      quantile(0.999),
+      max());
+  }
+
+ private:
+  using Value = histogram_details::Value<T>;
+
+  static constexpr int SubBits = 8;
+  static constexpr int64_t SubCount = int64_t(1) << SubBits;
+  static constexpr int64_t HalfCount = SubCount / 2;
+  static constexpr int MaxBits = 48;
+  static constexpr int64_t MaxValue = (int64_t(1) << MaxBits) - 1;
+  static constexpr int NumBuckets = (MaxBits - SubBits) * HalfCount + SubCount;
+
+  static int _bucket_of(int64_t value)
+  {
+    value = std::min(value, MaxValue);
+    if (value < SubCount) { return value; }
+    int shift = std::bit_width(uint64_t(value)) - SubBits;
+    return shift * HalfCount + (value >> shift);
+  }
+
+  static int64_t _highest_of(int bucket)
+  {
+    if (bucket < SubCount) { return bucket; }
+    int shift = bucket / HalfCount - 1;
+    int64_t sub = bucket - shift * HalfCount;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  std::vector<uint64_t> _counts;
+  uint64_t _count = 0;
+  double _sum = 0;
+  int64_t _min = std::numeric_limits<int64_t>::max();
+  int64_t _max = 0;
+};
+
+using LatencyHistogram = Histogram<Span>;
+
+} // namespace bee
@@ -0,0 +1,83 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "testing.hpp"
+
+namespace bee {
+namespace {
+
+TEST(small_values_are_exact)
+{
+  Histogram h;
+  for (int64_t v = 1; v <= 100; v++) { h.record(v); }
+  P(h);
+  P("mean: $ p25: $ q0: $ q1: $",
+    h.mean(),
+    h.quantile(0.25),
+    h.quantile(0),
+    h.quantile(1));
+}
+
+TEST(relative_error)
+{
+  // Every quantile is within a bucket, at most 1/128th above the exact value
+  std::mt19937_64 gen(7);
+  std::lognormal_distribution<double> dist(10, 3);
+  std::vector<int64_t> values;
+  Histogram h;
+  for (int i = 0; i < 100000; i++) {
+    int64_t v = std::min<double>(dist(gen), 1e14);
+    values.push_back(v);
+    h.record(v);
+  }
+  std::sort(values.begin(), values.end());
+  double worst = 0;
+  for (double q : {0.01, 0.1, 0.5, 0.9, 0.99, 0.999, 0.9999}) {
+    int64_t exact = values[std::ceil(q * values.size()) - 1];
+    int64_t got = h.quantile(q);
+    if (got < exact) { P("q:$ below exact, $ < $", q, got, exact); }
+    worst = std::max(worst, double(got - exact) / exact);
+  }
+  P("within 1/128: $", worst <= 1.0 / 128);
+  P("min:$ max:$", h.min() == values.front(), h.max() == values.back());
+}
+
+TEST(spans)
+{
+  LatencyHistogram h;
+  P("empty: $", h);
+  for (int i = 0; i < 990; i++) { h.record(Span::of_micros(10)); }
+  for (int i = 0; i < 9; i++) { h.record(Span::of_millis(3)); }
+  h.record(Span::of_seconds(2));
+  h.record(Span::of_nanos(-5));
+  P(h);
+}
+
+TEST(merge)
+{
+  Histogram a;
+  Histogram b;
+  for (int i = 0; i < 1000; i++) { a.record(i); }
+  for (int i = 1000; i < 2000; i++) { b.record(i, 2); }
+  a.merge(b);
+  P(a);
+  a.clear();
+  P("cleared: $", a);
+}
+
+TEST(clamped)
+{
+  Histogram h;
+  h.record(std::numeric_limits<int64_t>::max());
+  h.record(1);
+  P("max stays exact: $", h.max() == std::numeric_limits<int64_t>::max());
+  P("p99 clamped to max: $", h.quantile(0.99) == h.max());
+}
+
+} // namespace
+} // namespace bee
@@ -1,5 +1,9 @@
 #include "int_of_string.hpp"
 
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <limits>
 #include <type_traits>
 
@@ -9,29 +13,139 @@ namespace {
 const Error malformed_error = Error("Malformed number");
 const Error overflow_error = Error("Overflow");
 
+// SWAR, the 8 chars of a word are checked and converted at once. The first
+// char is in the lowest byte, so it is only used on little endian.
+namespace swar {
+
+constexpr uint64_t repeat(uint8_t byte)
+{
+  return uint64_t(0x0101010101010101) * byte;
+}
+
+inline uint64_t load(const char* p)
+{
+  uint64_t word;
+  std::memcpy(&word, p, 8);
+  return word;
+}
+
+// The last 0 < n < 8 chars before end, after 8 - n '0's so they read as 8
+// digits. Reads the 8 bytes before end, which must be in the string.
+inline uint64_t load_tail(const char* end, int n)
+{
+  const int skipped = 8 * (8 - n);
+  return (load(end - 8) >> skipped << skipped) | (repeat('0') >> (8 * n));
+}
+
+// A byte is a digit if its high nibble is 3 and stays 3 after adding 6
+inline bool is_eight_digits(uint64_t word)
+{
+  return ((word & repeat(0xf0)) |
+          (((word + repeat(0x06)) & repeat(0xf0)) >> 4)) == repeat(0x33);
+}
+
+// Combines the digits pairwise, then the pairs into two groups of 4, then
+// the groups
+inline uint32_t parse_eight_digits(uint64_t word)
+{
+  constexpr uint64_t mask = 0x000000ff000000ff;
+  constexpr uint64_t mul1 = 100 + (uint64_t(1000000) << 32);
+  constexpr uint64_t mul2 = 1 + (uint64_t(10000) << 32);
+  word -= repeat('0');
+  word = word * 10 + (word >> 8);
+  return ((word & mask) * mul1 + ((word >> 16) & mask) * mul2) >> 32;
+}
+
+constexpr std::array<uint32_t, 8> pow10 = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000};
+
+// Accumulates the digits from p into result, 8 at a time, and returns where
+// it stopped. The string must be at least 8 chars long, ending at end. Kept
+// out of line so short numbers don't pay for its registers.
+template <class UT>
+[[gnu::noinline]] const char* parse_digits(
+  const char* p, const char* end, UT& result)
+{
+  while (end - p >= 8) {
+    uint64_t word = load(p);
+    if (!is_eight_digits(word)) { return p; }
+    result = result * 100000000 + parse_eight_digits(word);
+    p += 8;
+  }
+  if (int n = end - p; n > 0) {
+    uint64_t word = load_tail(end, n);
+    if (is_eight_digits(word)) {
+      result = result * pow10[n] + parse_eight_digits(word);
+      return end;
+    }
+  }
+  return p;
+}
+
+} // namespace swar
+
 template <class T> struct Converter {
   using UT = std::make_unsigned_t<T>;
 
+  // Any number with at most this many digits fits
+  static constexpr int max_safe_digits = std::numeric_limits<T>::digits10;
+
+  // The decimal digits of max_value, which has max_safe_digits + 1 of them
+  template <UT max_value>
+  static constexpr auto max_digits = [] {
+    std::array<char, max_safe_digits + 1> out;
+    UT value = max_value;
+    for (int i = max_safe_digits; i >= 0; i--) {
+      out[i] = '0' + value % 10;
+      value /= 10;
+    }
+    return out;
+  }();
+
+  // Whether the max_safe_digits + 1 digits at p are more than max_value
+  template <UT max_value> static bool exceeds(const char* p)
+  {
+    for (int i = 0; i <= max_safe_digits; i++) {
+      if (p[i] != max_digits<max_value>[i]) {
+        return p[i] > max_digits<max_value>[i];
+      }
+    }
+    return false;
+  }
+
   template <UT max_value>
   static OrError<T> parse_gen(bool negate, int idx, const std::string_view& str)
   {
-    constexpr UT max_before_mul_10 = max_value / 10 + 1;
-    if (str.empty()) { return malformed_error; }
-    UT result = 0;
     if (idx >= std::ssize(str)) { return malformed_error; }
+    const char* p = str.data() + idx;
+    const char* const end = str.data() + str.size();
+    const char* digits = p;
 
-    for (; idx < std::ssize(str); idx++) {
-      char c = str[idx];
-      if (c < '0' || c > '9') { return malformed_error; }
-      int d = c - '0';
-      if (result >= max_before_mul_10) { return overflow_error; }
-      result *= 10;
-      if (result > max_value - d) { return overflow_error; }
-      result += d;
+    // Wraps around on overflow, which is only checked at the end
+    UT result = 0;
+    if constexpr (std::endian::native == std::endian::little) {
+      if (std::ssize(str) >= 8) { p = swar::parse_digits(p, end, result); }
+    }
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      result = result * 10 + (*p - '0');
+    }
+
+    // Only numbers with one more digit than is safe can either fit or not,
+    // as many as max_value. Overflow takes precedence over malformed chars
+    // after the digits.
+    if (p - digits > max_safe_digits) {
+      while (digits < p && *digits == '0') { digits++; }
+      if (const int num_digits = p - digits; num_digits > max_safe_digits) {
+        if (
+          num_digits > max_safe_digits + 1 || exceeds<max_value>(digits)) {
+          return overflow_error;
+        }
+      }
     }
+    if (p != end) { return malformed_error; }
 
     if (negate) {
-      return -T(result);
+      return T(-result);
     } else {
       return result;
     }
@@ -55,6 +169,37 @@ template <class T> struct Converter {
     if (str[0] == '+') { idx++; }
     return parse_gen<max_pos>(false, idx, str);
   }
+
+  static OrError<std::vector<T>> parse_all(
+    std::span<const std::string_view> strs)
+  {
+    std::vector<T> out;
+    out.reserve(strs.size());
+    for (const auto& str : strs) {
+      bail(value, parse(str), "Failed to parse element $", out.size());
+      out.push_back(value);
+    }
+    return out;
+  }
+
+  static OrError<std::vector<T>> parse_delimited(
+    std::string_view buffer, char delimiter)
+  {
+    std::vector<T> out;
+    while (!buffer.empty()) {
+      // Goes through memchr, which libc already vectorizes
+      size_t pos = buffer.find(delimiter);
+      bail(
+        value,
+        parse(buffer.substr(0, pos)),
+        "Failed to parse element $",
+        out.size());
+      out.push_back(value);
+      if (pos == std::string_view::npos) { break; }
+      buffer.remove_prefix(pos + 1);
+    }
+    return out;
+  }
 };
 
 } // namespace
@@ -63,6 +208,18 @@ template <class T> struct Converter {
   OrError<type> IntOfString<type>::parse(const std::string_view& str)          \
   {                                                                            \
     return Converter<type>::parse(str);                                        \
+  }                                                                            \
+                                                                               \
+  OrError<std::vector<type>> IntOfString<type>::parse_all(                     \
+    std::span<const std::string_view> strs)                                    \
+  {                                                                            \
+    return Converter<type>::parse_all(strs);                                   \
+  }                                                                            \
+                                                                               \
+  OrError<std::vector<type>> IntOfString<type>::parse_delimited(               \
+    std::string_view buffer, char delimiter)                                   \
+  {                                                                            \
+    return Converter<type>::parse_delimited(buffer, delimiter);                \
   }
 
 IMPLEMENT_PARSER(int);
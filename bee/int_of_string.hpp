@@ -1,14 +1,25 @@
 #pragma once
 
+#include <span>
+#include <string_view>
+#include <vector>
+
 #include "or_error.hpp"
 
 namespace bee {
 
 template <class T> struct IntOfString;
 
+// parse_all and parse_delimited fail on the first element that doesn't
+// parse. parse_delimited ignores a trailing delimiter, so a column of lines
+// can be parsed with '\n'.
 #define DECLARE_PARSER(T)                                                      \
   template <> struct IntOfString<T> {                                          \
     static OrError<T> parse(const std::string_view& t);                        \
+    static OrError<std::vector<T>> parse_all(                                  \
+      std::span<const std::string_view> strs);                                 \
+    static OrError<std::vector<T>> parse_delimited(                            \
+      std::string_view buffer, char delimiter);                                \
   };
 
 DECLARE_PARSER(int);
@@ -1,5 +1,11 @@
+#include <cstdint>
 #include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "format_vector.hpp"
 #include "int_of_string.hpp"
 #include "testing.hpp"
 
@@ -70,5 +76,112 @@ TEST(unsigned_long_long)
   PRINT_EXPR(f("184467440737095516000"));
 }
 
+TEST(swar_boundaries)
+{
+  auto f = IntOfString<long long>::parse;
+  PRINT_EXPR(f("1234567"));
+  PRINT_EXPR(f("12345678"));
+  PRINT_EXPR(f("123456789"));
+  PRINT_EXPR(f("1234567812345678"));
+  PRINT_EXPR(f("12345678123456789"));
+  PRINT_EXPR(f("-12345678123456789"));
+  PRINT_EXPR(f("000000000000000000000000001"));
+
+  // Only zeros, past the safe number of digits, and followed by more zeros
+  // that are not part of the view
+  std::string_view zeros = "000000000000000000000000000000";
+  PRINT_EXPR(IntOfString<int>::parse(zeros.substr(0, 10)));
+  PRINT_EXPR(f(zeros.substr(0, 19)));
+  PRINT_EXPR(IntOfString<unsigned long long>::parse(zeros.substr(0, 20)));
+  PRINT_EXPR(f("1234567x"));
+  PRINT_EXPR(f("12345678x"));
+  PRINT_EXPR(f("12345678/2345678"));
+  PRINT_EXPR(f("12345678:2345678"));
+  PRINT_EXPR(f("99999999999999999999x"));
+  PRINT_EXPR(f("9999999999999999999x"));
+  PRINT_EXPR(f("999999999999999999x"));
+  PRINT_EXPR(IntOfString<int>::parse("9999999999x"));
+  PRINT_EXPR(IntOfString<int>::parse("999999999x"));
+}
+
+// Digit at a time with an overflow check on each, the simplest parser
+template <class T> std::string reference(const std::string& str)
+{
+  using UT = std::make_unsigned_t<T>;
+  size_t idx = 0;
+  UT max_value = std::numeric_limits<T>::max();
+  bool negate = false;
+  if (!str.empty() && str[0] == '-') {
+    if (std::is_unsigned_v<T>) { return "Overflow"; }
+    max_value = UT(std::numeric_limits<T>::min());
+    negate = true;
+    idx++;
+  } else if (!str.empty() && str[0] == '+') {
+    idx++;
+  }
+  if (idx >= str.size()) { return "Malformed number"; }
+  UT result = 0;
+  for (; idx < str.size(); idx++) {
+    char c = str[idx];
+    if (c < '0' || c > '9') { return "Malformed number"; }
+    UT d = c - '0';
+    if (result > (max_value - d) / 10) { return "Overflow"; }
+    result = result * 10 + d;
+  }
+  return F(negate ? -T(result) : T(result));
+}
+
+template <class T> int check_matches_reference(std::mt19937_64& gen)
+{
+  int failures = 0;
+  for (int i = 0; i < 100000; i++) {
+    std::string str;
+    if (gen() % 4 == 0) { str += "+-"[gen() % 2]; }
+    int length = gen() % 25;
+    for (int j = 0; j < length; j++) {
+      str += gen() % 30 == 0 ? char(gen() % 128) : char('0' + gen() % 10);
+    }
+    auto value = IntOfString<T>::parse(str);
+    auto got = value.is_ok() ? F(value.value()) : value.error().msg();
+    auto expected = reference<T>(str);
+    if (got != expected) {
+      P("'$': got '$' expected '$'", str, got, expected);
+      failures++;
+    }
+  }
+  return failures;
+}
+
+TEST(matches_reference)
+{
+  std::mt19937_64 gen(42);
+  P("int failures: $", check_matches_reference<int>(gen));
+  P("unsigned failures: $", check_matches_reference<unsigned>(gen));
+  P("long long failures: $", check_matches_reference<long long>(gen));
+  P("unsigned long long failures: $",
+    check_matches_reference<unsigned long long>(gen));
+}
+
+TEST(parse_all)
+{
+  std::vector<std::string_view> strs = {"1", "-20", "300000000000"};
+  PRINT_EXPR(IntOfString<long long>::parse_all(strs));
+  PRINT_EXPR(IntOfString<int>::parse_all(strs));
+  PRINT_EXPR(IntOfString<int>::parse_all({}));
+}
+
+TEST(parse_delimited)
+{
+  auto f = IntOfString<int>::parse_delimited;
+  PRINT_EXPR(f("1,22,-333,4444", ','));
+  PRINT_EXPR(f("1\n22\n333\n", '\n'));
+  PRINT_EXPR(f("", ','));
+  PRINT_EXPR(f("7", ','));
+  PRINT_EXPR(f("1,,3", ','));
+  PRINT_EXPR(f("1,2,x", ','));
+  PRINT_EXPR(f("1,2,", ','));
+  PRINT_EXPR(f("1,2,,", ','));
+}
+
 } // namespace
 } // namespace bee
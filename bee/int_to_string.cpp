@@ -33,7 +33,8 @@ constexpr table3_t make_table3() noexcept
 constexpr table3_t table3 = make_table3();
 
 template <class T>
-inline std::string format_int(T number_orig, const FormatParams& p)
+inline void format_int(
+  fixed_rstring<32>& out, T number_orig, const FormatParams& p)
 {
   bool negative = false;
   using U = std::make_unsigned_t<T>;
@@ -45,8 +46,6 @@ inline std::string format_int(T number_orig, const FormatParams& p)
     number = number_orig;
   }
 
-  fixed_rstring<32> out;
-
   if (p.hex) {
     Hex::to_hex_rstring<U>(out, number);
   } else if (number == 0) {
@@ -77,7 +76,6 @@ inline std::string format_int(T number_orig, const FormatParams& p)
   } else if (p.sign) {
     out.prepend('+');
   }
-  return out.to_string();
 }
 
 } // namespace
@@ -85,7 +83,17 @@ inline std::string format_int(T number_orig, const FormatParams& p)
 #define IMPLEMENT_CONVERTER(T)                                                 \
   std::string to_string_t<T>::convert(T number, const FormatParams& p)         \
   {                                                                            \
-    return format_int<T>(number, p);                                           \
+    fixed_rstring<32> out;                                                     \
+    format_int<T>(out, number, p);                                             \
+    return out.to_string();                                                    \
+  }                                                                            \
+                                                                               \
+  void to_string_t<T>::append(                                                 \
+    std::string& out, T number, const FormatParams& p)                         \
+  {                                                                            \
+    fixed_rstring<32> buffer;                                                  \
+    format_int<T>(buffer, number, p);                                          \
+    buffer.append_to(out);                                                     \
   }
 
 IMPLEMENT_CONVERTER(signed char);
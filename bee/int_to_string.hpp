@@ -8,6 +8,7 @@ namespace bee {
 #define DECLARE_CONVERTER(T)                                                   \
   template <> struct to_string_t<T> {                                          \
     static std::string convert(T value, const FormatParams& p);                \
+    static void append(std::string& out, T value, const FormatParams& p);      \
   };
 
 DECLARE_CONVERTER(signed char);
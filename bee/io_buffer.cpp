@@ -0,0 +1,81 @@
+#include "io_buffer.hpp"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+#include <unistd.h>
+
+namespace bee {
+namespace {
+
+std::byte* allocate(size_t capacity, size_t alignment)
+{
+  return static_cast<std::byte*>(
+    ::operator new(capacity, std::align_val_t(alignment)));
+}
+
+size_t round_up(size_t size, size_t alignment)
+{
+  return (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// IOBuffer
+//
+
+IOBuffer::IOBuffer(size_t capacity, bool page_aligned)
+    : _alignment(page_aligned ? page_size() : __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+{
+  reallocate(capacity);
+}
+
+IOBuffer::IOBuffer(IOBuffer&& other) noexcept
+    : _data(std::exchange(other._data, nullptr)),
+      _capacity(std::exchange(other._capacity, 0)),
+      _alignment(other._alignment)
+{}
+
+IOBuffer& IOBuffer::operator=(IOBuffer&& other) noexcept
+{
+  if (this != &other) {
+    _free();
+    _data = std::exchange(other._data, nullptr);
+    _capacity = std::exchange(other._capacity, 0);
+    _alignment = other._alignment;
+  }
+  return *this;
+}
+
+IOBuffer::~IOBuffer() noexcept { _free(); }
+
+std::byte* IOBuffer::data() { return _data; }
+const std::byte* IOBuffer::data() const { return _data; }
+
+size_t IOBuffer::capacity() const { return _capacity; }
+
+void IOBuffer::reallocate(size_t capacity)
+{
+  _free();
+  // The capacity is rounded up so the end is aligned too, whole page aligned
+  // buffers can then be handed to O_DIRECT files
+  _capacity = round_up(capacity, _alignment);
+  _data = allocate(_capacity, _alignment);
+}
+
+size_t IOBuffer::page_size()
+{
+  static const size_t size = ::sysconf(_SC_PAGESIZE);
+  return size;
+}
+
+void IOBuffer::_free()
+{
+  if (_data == nullptr) { return; }
+  ::operator delete(_data, std::align_val_t(_alignment));
+  _data = nullptr;
+}
+
+} // namespace bee
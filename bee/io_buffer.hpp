@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+
+namespace bee {
+
+// Sizing of the buffer FileReader and FileWriter keep between the caller and
+// the file descriptor
+struct IOBufferOptions {
+  static constexpr size_t DefaultCapacity = 1 << 16;
+
+  size_t capacity = DefaultCapacity;
+
+  // Align the buffer start to the page size, as O_DIRECT style I/O requires
+  bool page_aligned = false;
+
+  // Only for readers, doubles the capacity up to max_capacity every time a
+  // read fills the whole buffer, so long sequential reads need fewer syscalls
+  bool adaptive = false;
+  size_t max_capacity = 1 << 22;
+};
+
+// Fixed capacity heap allocated byte buffer
+struct IOBuffer {
+ public:
+  explicit IOBuffer(size_t capacity, bool page_aligned = false);
+
+  IOBuffer(const IOBuffer& other) = delete;
+  IOBuffer(IOBuffer&& other) noexcept;
+
+  IOBuffer& operator=(const IOBuffer& other) = delete;
+  IOBuffer& operator=(IOBuffer&& other) noexcept;
+
+  ~IOBuffer() noexcept;
+
+  std::byte* data();
+  const std::byte* data() const;
+
+  size_t capacity() const;
+
+  // Replaces the storage with a new one of the given capacity, the contents
+  // are not preserved
+  void reallocate(size_t capacity);
+
+  static size_t page_size();
+
+ private:
+  void _free();
+
+  std::byte* _data = nullptr;
+  size_t _capacity = 0;
+  size_t _alignment;
+};
+
+} // namespace bee
@@ -0,0 +1,847 @@
+#include "io_ring.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "errno_msg.hpp"
+#include "time.hpp"
+
+namespace bee {
+namespace {
+
+constexpr int max_iovecs = 64;
+
+constexpr size_t max_read_chunk = max_iovecs * Slab::DefaultCapacity;
+
+bool is_again(int64_t res)
+{
+  return res == -EAGAIN || res == -EWOULDBLOCK || res == -EINTR;
+}
+
+// Points iov to the free space of buffer where the next max_size bytes go
+int read_iovecs(DataBuffer& buffer, size_t max_size, struct iovec* iov)
+{
+  max_size = std::min(max_size, max_read_chunk);
+  buffer.reserve(max_size);
+  std::array<std::span<std::byte>, max_iovecs> regions;
+  size_t num_regions = buffer.free_space(regions);
+  int count = 0;
+  size_t total = 0;
+  for (size_t i = 0; i < num_regions && total < max_size; i++) {
+    size_t len = std::min(regions[i].size(), max_size - total);
+    iov[count++] = {.iov_base = regions[i].data(), .iov_len = len};
+    total += len;
+  }
+  return count;
+}
+
+int write_iovecs(const DataBuffer& data, struct iovec* iov)
+{
+  int count = 0;
+  for (auto it = data.begin(); it != data.end() && count < max_iovecs; it++) {
+    iov[count++] = {
+      .iov_base = const_cast<std::byte*>(it->data()),
+      .iov_len = it->size(),
+    };
+  }
+  return count;
+}
+
+// FIFO over a vector that gets reused once drained, unlike a deque it stops
+// allocating once it reached its peak size
+template <class T> struct FifoVector {
+ public:
+  bool empty() const { return _head == _items.size(); }
+  const T& front() const { return _items[_head]; }
+
+  void push_back(const T& item) { _items.push_back(item); }
+
+  void pop()
+  {
+    if (++_head == _items.size()) {
+      _items.clear();
+      _head = 0;
+    }
+  }
+
+ private:
+  std::vector<T> _items;
+  size_t _head = 0;
+};
+
+struct Op {
+  enum class Kind { Read, Write, Accept, Fsync };
+
+  Kind kind;
+  FD::shared_ptr fd;
+
+  DataBuffer* buffer = nullptr;
+  size_t max_size = 0;
+
+  DataBuffer data;
+  size_t written = 0;
+
+  IoRing::read_callback on_read;
+  IoRing::write_callback on_write;
+  IoRing::accept_callback on_accept;
+  IoRing::fsync_callback on_fsync;
+
+  std::array<struct iovec, max_iovecs> iov;
+
+  // Sets up iov for the next attempt and returns how many entries it used
+  int prepare_iovecs()
+  {
+    if (kind == Kind::Read) {
+      return read_iovecs(*buffer, max_size, iov.data());
+    } else {
+      return write_iovecs(data, iov.data());
+    }
+  }
+
+  bool waits_for_output() const { return kind == Kind::Write; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// IoRingBase
+//
+
+// Keeps track of the operations and interprets their results, the backends
+// only differ on how the syscalls are issued
+struct IoRingBase : public IoRing {
+ public:
+  virtual ~IoRingBase() noexcept {}
+
+  virtual void read(
+    const FD::shared_ptr& fd,
+    DataBuffer& buffer,
+    size_t max_size,
+    read_callback&& callback) override
+  {
+    auto [slot, op] = _acquire(Op::Kind::Read, fd);
+    op->buffer = &buffer;
+    op->max_size = max_size;
+    op->on_read = std::move(callback);
+    _submit_later(slot);
+  }
+
+  virtual void write(
+    const FD::shared_ptr& fd,
+    DataBuffer&& data,
+    write_callback&& callback) override
+  {
+    auto [slot, op] = _acquire(Op::Kind::Write, fd);
+    op->data = std::move(data);
+    op->on_write = std::move(callback);
+    _submit_later(slot);
+  }
+
+  virtual void accept(
+    const FD::shared_ptr& fd, accept_callback&& callback) override
+  {
+    auto [slot, op] = _acquire(Op::Kind::Accept, fd);
+    op->on_accept = std::move(callback);
+    _submit_later(slot);
+  }
+
+  virtual void fsync(
+    const FD::shared_ptr& fd, fsync_callback&& callback) override
+  {
+    auto [slot, op] = _acquire(Op::Kind::Fsync, fd);
+    op->on_fsync = std::move(callback);
+    _submit_later(slot);
+  }
+
+  virtual size_t pending() const override
+  {
+    return _ops.size() - _free_slots.size();
+  }
+
+ protected:
+  // Slots of the operations that didn't complete yet
+  std::vector<uint32_t> _pending_slots() const
+  {
+    std::vector<bool> is_free(_ops.size());
+    for (uint32_t slot : _free_slots) { is_free[slot] = true; }
+    std::vector<uint32_t> slots;
+    for (uint32_t slot = 0; slot < _ops.size(); slot++) {
+      if (!is_free[slot]) { slots.push_back(slot); }
+    }
+    return slots;
+  }
+
+  enum class Outcome {
+    Done,
+    // Issue the syscall again right away
+    Again,
+    // Issue the syscall again once the fd is ready
+    WaitReady,
+  };
+
+  // Called for every new operation, which is not submitted until poll
+  virtual void _submit_later(uint32_t slot) = 0;
+
+  Op& _op(uint32_t slot) { return *_ops[slot]; }
+
+  // Takes the raw result of a syscall, bytes or -errno, and runs the callback
+  // if the operation is done
+  Outcome _finish(uint32_t slot, int64_t res)
+  {
+    auto& op = _op(slot);
+    if (is_again(res)) { return Outcome::WaitReady; }
+
+    if (op.kind == Op::Kind::Write && res > 0) {
+      op.data.consume(res);
+      op.written += res;
+      if (!op.data.empty()) { return Outcome::Again; }
+    }
+
+    // The slot is free again before the callback runs, so callbacks can queue
+    // new operations, and the Op is kept around to be reused
+    _free_slots.push_back(slot);
+    auto fd = std::move(op.fd);
+    switch (op.kind) {
+    case Op::Kind::Read: {
+      auto callback = std::move(op.on_read);
+      if (res > 0) {
+        op.buffer->commit(res);
+        callback(ReadResult(res));
+      } else if (res == 0 || res == -ECONNRESET) {
+        callback(ReadResult::eof());
+      } else {
+        callback(
+          Error::fmt("Failed to read fd($): $", fd->int_fd(), strerror(-res)));
+      }
+    } break;
+    case Op::Kind::Write: {
+      auto callback = std::move(op.on_write);
+      size_t written = std::exchange(op.written, 0);
+      bool incomplete = !op.data.empty();
+      op.data.clear();
+      if (res < 0) {
+        callback(
+          Error::fmt("Failed to write fd($): $", fd->int_fd(), strerror(-res)));
+      } else if (incomplete) {
+        callback(Error::fmt("Write to fd($) made no progress", fd->int_fd()));
+      } else {
+        callback(written);
+      }
+    } break;
+    case Op::Kind::Accept: {
+      auto callback = std::move(op.on_accept);
+      if (res < 0) {
+        callback(Error::fmt("Failed to accept connection: $", strerror(-res)));
+      } else {
+        callback(FD(res));
+      }
+    } break;
+    case Op::Kind::Fsync: {
+      auto callback = std::move(op.on_fsync);
+      // Same as FD::flush, files that can't be synced are not an error
+      if (res < 0 && res != -EROFS && res != -EINVAL) {
+        callback(Error::fmt("fsync failed: $", strerror(-res)));
+      } else {
+        callback(ok());
+      }
+    } break;
+    }
+    return Outcome::Done;
+  }
+
+ private:
+  std::pair<uint32_t, Op*> _acquire(Op::Kind kind, const FD::shared_ptr& fd)
+  {
+    uint32_t slot;
+    if (_free_slots.empty()) {
+      slot = _ops.size();
+      _ops.push_back(std::make_unique<Op>());
+    } else {
+      slot = _free_slots.back();
+      _free_slots.pop_back();
+    }
+    auto op = _ops[slot].get();
+    op->kind = kind;
+    op->fd = fd;
+    return {slot, op};
+  }
+
+  std::vector<std::unique_ptr<Op>> _ops;
+  std::vector<uint32_t> _free_slots;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// IoUringRing
+//
+
+int io_uring_setup(unsigned entries, struct io_uring_params* params)
+{
+  return ::syscall(__NR_io_uring_setup, entries, params);
+}
+
+int io_uring_enter(
+  int ring_fd,
+  unsigned to_submit,
+  unsigned min_complete,
+  unsigned flags,
+  const void* arg,
+  size_t arg_size)
+{
+  return ::syscall(
+    __NR_io_uring_enter,
+    ring_fd,
+    to_submit,
+    min_complete,
+    flags,
+    arg,
+    arg_size);
+}
+
+template <class T> T* offset_ptr(void* base, uint32_t offset)
+{
+  return reinterpret_cast<T*>(static_cast<std::byte*>(base) + offset);
+}
+
+unsigned load_acquire(const unsigned* ptr)
+{
+  return std::atomic_ref(*const_cast<unsigned*>(ptr))
+    .load(std::memory_order_acquire);
+}
+
+void store_release(unsigned* ptr, unsigned value)
+{
+  std::atomic_ref(*ptr).store(value, std::memory_order_release);
+}
+
+// Submission and completion queues shared with the kernel, see io_uring(7)
+struct IoUringRing final : public IoRingBase {
+ public:
+  static OrError<std::unique_ptr<IoUringRing>> create(size_t queue_depth)
+  {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // Completions are only looked at from poll, so the kernel doesn't need to
+    // interrupt the thread to post them
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    int ring_fd = io_uring_setup(queue_depth, &params);
+    if (ring_fd < 0 && errno == EINVAL) {
+      // Older kernels don't know about the flag
+      memset(&params, 0, sizeof(params));
+      ring_fd = io_uring_setup(queue_depth, &params);
+    }
+    if (ring_fd < 0) {
+      return Error::fmt("io_uring_setup failed: $", errno_msg());
+    }
+    auto ring = std::unique_ptr<IoUringRing>(new IoUringRing(FD(ring_fd)));
+
+    constexpr unsigned required_features = IORING_FEAT_SINGLE_MMAP |
+                                           IORING_FEAT_NODROP |
+                                           IORING_FEAT_RW_CUR_POS |
+                                           IORING_FEAT_EXT_ARG;
+    if ((params.features & required_features) != required_features) {
+      return Error("Kernel io_uring lacks required features");
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->_rings_size = std::max(sq_size, cq_size);
+    void* rings = ::mmap(
+      nullptr,
+      ring->_rings_size,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      ring_fd,
+      IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED) {
+      return Error::fmt("Failed to map io_uring rings: $", errno_msg());
+    }
+    ring->_rings = rings;
+
+    ring->_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(
+      nullptr,
+      ring->_sqes_size,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      ring_fd,
+      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return Error::fmt("Failed to map io_uring entries: $", errno_msg());
+    }
+    ring->_sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+    ring->_sq_entries = params.sq_entries;
+    ring->_sq_head = offset_ptr<unsigned>(rings, params.sq_off.head);
+    ring->_sq_tail = offset_ptr<unsigned>(rings, params.sq_off.tail);
+    ring->_sq_mask = *offset_ptr<unsigned>(rings, params.sq_off.ring_mask);
+    ring->_sq_array = offset_ptr<unsigned>(rings, params.sq_off.array);
+    ring->_cq_head = offset_ptr<unsigned>(rings, params.cq_off.head);
+    ring->_cq_tail = offset_ptr<unsigned>(rings, params.cq_off.tail);
+    ring->_cq_mask = *offset_ptr<unsigned>(rings, params.cq_off.ring_mask);
+    ring->_cqes = offset_ptr<struct io_uring_cqe>(rings, params.cq_off.cqes);
+    return ring;
+  }
+
+  virtual ~IoUringRing() noexcept
+  {
+    if (_sqes != nullptr && _rings != nullptr) { _cancel_in_flight(); }
+    if (_sqes != nullptr) { ::munmap(_sqes, _sqes_size); }
+    if (_rings != nullptr) { ::munmap(_rings, _rings_size); }
+  }
+
+  virtual OrError<size_t> poll(std::optional<Span> timeout) override
+  {
+    std::optional<Time> deadline;
+    if (timeout.has_value()) { deadline = Time::monotonic() + *timeout; }
+    size_t completed = 0;
+    bool timed_out = false;
+    while (true) {
+      unsigned to_submit = _fill_sqes();
+      // Only block when there is nothing else to do
+      bool wait =
+        completed == 0 && !timed_out && _waiting.empty() && pending() > 0;
+      if (to_submit > 0 || wait) {
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        if (deadline.has_value()) {
+          auto nanos =
+            std::max<int64_t>((*deadline - Time::monotonic()).to_nanos(), 0);
+          ts.tv_sec = nanos / 1000000000;
+          ts.tv_nsec = nanos % 1000000000;
+          arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+        int ret = io_uring_enter(
+          _ring_fd.int_fd(),
+          to_submit,
+          wait ? 1 : 0,
+          IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+          &arg,
+          sizeof(arg));
+        if (ret < 0) {
+          if (errno == ETIME) {
+            timed_out = true;
+          } else if (errno != EINTR) {
+            return Error::fmt("io_uring_enter failed: $", errno_msg());
+          }
+        }
+      }
+
+      completed += _reap();
+      // Retries go out before returning, otherwise they would sit in the
+      // queue until the next poll
+      if (!_waiting.empty()) { continue; }
+      if (completed > 0 || timed_out || pending() == 0) { break; }
+    }
+    return completed;
+  }
+
+  virtual Backend backend() const override { return Backend::IoUring; }
+
+ protected:
+  virtual void _submit_later(uint32_t slot) override
+  {
+    _waiting.push_back(_user_data(slot, false));
+  }
+
+ private:
+  explicit IoUringRing(FD&& ring_fd) : _ring_fd(std::move(ring_fd)) {}
+
+  // The low bit tells apart readiness polls from the operation itself
+  static uint64_t _user_data(uint32_t slot, bool is_poll)
+  {
+    return (uint64_t(slot) << 1) | (is_poll ? 1 : 0);
+  }
+
+  // No slot gets this high
+  static constexpr uint64_t cancel_user_data = ~uint64_t(0);
+
+  // The kernel may still read from or write to the buffers of the entries it
+  // was handed, which are freed along with the ring. Those are cancelled and
+  // waited for, without running their callbacks.
+  void _cancel_in_flight()
+  {
+    _waiting = {};
+    std::vector<uint64_t> to_cancel;
+    if (_in_flight > 0) {
+      // An operation only has one entry in the kernel at a time, either the
+      // operation itself or its readiness poll, cancelling the other one just
+      // fails
+      for (uint32_t slot : _pending_slots()) {
+        to_cancel.push_back(_user_data(slot, false));
+        to_cancel.push_back(_user_data(slot, true));
+      }
+    }
+    size_t next_cancel = 0;
+    while (_in_flight > 0) {
+      unsigned head = load_acquire(_sq_head);
+      unsigned tail = *_sq_tail;
+      while (next_cancel < to_cancel.size() && tail - head < _sq_entries) {
+        unsigned index = tail & _sq_mask;
+        auto sqe = &_sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = to_cancel[next_cancel++];
+        sqe->user_data = cancel_user_data;
+        _sq_array[index] = index;
+        tail++;
+      }
+      store_release(_sq_tail, tail);
+      // Also submits entries left in the queue by a failed poll
+      unsigned to_submit = tail - head;
+      int ret = io_uring_enter(
+        _ring_fd.int_fd(),
+        to_submit,
+        _cq_empty() ? 1 : 0,
+        IORING_ENTER_GETEVENTS,
+        nullptr,
+        0);
+      if (ret < 0 && errno != EINTR) {
+        // Nothing else to do, closing the ring still cancels what is left
+        // but doesn't wait for it
+        break;
+      }
+
+      unsigned cq_head = *_cq_head;
+      while (cq_head != load_acquire(_cq_tail)) {
+        if (_cqes[cq_head & _cq_mask].user_data != cancel_user_data) {
+          _in_flight--;
+        }
+        cq_head++;
+      }
+      store_release(_cq_head, cq_head);
+    }
+  }
+
+  // Moves as many waiting entries as fit to the submission queue and returns
+  // how many it moved
+  unsigned _fill_sqes()
+  {
+    unsigned head = load_acquire(_sq_head);
+    unsigned tail = *_sq_tail;
+    unsigned filled = 0;
+    while (!_waiting.empty() && tail - head < _sq_entries) {
+      uint64_t user_data = _waiting.front();
+      _waiting.pop();
+      unsigned index = tail & _sq_mask;
+      _prepare(&_sqes[index], user_data);
+      _sq_array[index] = index;
+      tail++;
+      filled++;
+    }
+    store_release(_sq_tail, tail);
+    _in_flight += filled;
+    return filled;
+  }
+
+  void _prepare(struct io_uring_sqe* sqe, uint64_t user_data)
+  {
+    auto& op = _op(user_data >> 1);
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = op.fd->int_fd();
+    sqe->user_data = user_data;
+    if (user_data & 1) {
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->poll32_events = op.waits_for_output() ? POLLOUT : POLLIN;
+      return;
+    }
+    switch (op.kind) {
+    case Op::Kind::Read:
+    case Op::Kind::Write:
+      sqe->opcode =
+        op.kind == Op::Kind::Read ? IORING_OP_READV : IORING_OP_WRITEV;
+      sqe->len = op.prepare_iovecs();
+      sqe->addr = reinterpret_cast<uint64_t>(op.iov.data());
+      // Use and update the file position, as read and write do
+      sqe->off = uint64_t(-1);
+      break;
+    case Op::Kind::Accept:
+      sqe->opcode = IORING_OP_ACCEPT;
+      sqe->accept_flags = SOCK_CLOEXEC;
+      break;
+    case Op::Kind::Fsync:
+      sqe->opcode = IORING_OP_FSYNC;
+      break;
+    }
+  }
+
+  bool _cq_empty() const { return *_cq_head == load_acquire(_cq_tail); }
+
+  size_t _reap()
+  {
+    size_t completed = 0;
+    unsigned head = *_cq_head;
+    while (head != load_acquire(_cq_tail)) {
+      auto cqe = _cqes[head & _cq_mask];
+      head++;
+      // Release the entry before running callbacks, they may queue more work
+      store_release(_cq_head, head);
+      _in_flight--;
+
+      uint32_t slot = cqe.user_data >> 1;
+      if (cqe.user_data & 1) {
+        // The fd is ready, or the poll failed and the retry will tell why
+        _waiting.push_back(_user_data(slot, false));
+        continue;
+      }
+      switch (_finish(slot, cqe.res)) {
+      case Outcome::Done:
+        completed++;
+        break;
+      case Outcome::Again:
+        _waiting.push_back(_user_data(slot, false));
+        break;
+      case Outcome::WaitReady:
+        _waiting.push_back(_user_data(slot, true));
+        break;
+      }
+    }
+    return completed;
+  }
+
+  FD _ring_fd;
+
+  void* _rings = nullptr;
+  size_t _rings_size = 0;
+  struct io_uring_sqe* _sqes = nullptr;
+  size_t _sqes_size = 0;
+
+  unsigned _sq_entries = 0;
+  unsigned* _sq_head = nullptr;
+  unsigned* _sq_tail = nullptr;
+  unsigned _sq_mask = 0;
+  unsigned* _sq_array = nullptr;
+
+  unsigned* _cq_head = nullptr;
+  unsigned* _cq_tail = nullptr;
+  unsigned _cq_mask = 0;
+  struct io_uring_cqe* _cqes = nullptr;
+
+  // Entries not yet in the submission queue
+  FifoVector<uint64_t> _waiting;
+  // Entries in the submission queue or in the kernel, whose completion was
+  // not reaped yet
+  size_t _in_flight = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// EpollRing
+//
+
+struct EpollRing final : public IoRingBase {
+ public:
+  static OrError<std::unique_ptr<EpollRing>> create()
+  {
+    int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+      return Error::fmt("epoll_create1 failed: $", errno_msg());
+    }
+    return std::unique_ptr<EpollRing>(new EpollRing(FD(epoll_fd)));
+  }
+
+  virtual ~EpollRing() noexcept {}
+
+  virtual OrError<size_t> poll(std::optional<Span> timeout) override
+  {
+    bail(completed, _run_ready());
+    if (completed > 0 || pending() == 0) { return completed; }
+
+    int timeout_ms = -1;
+    if (timeout.has_value()) {
+      // Round up, otherwise short timeouts would turn into busy polling
+      timeout_ms = (std::max<int64_t>(timeout->to_nanos(), 0) + 999999) /
+                   1000000;
+    }
+    std::array<struct epoll_event, 64> events;
+    int num_events = ::epoll_wait(
+      _epoll_fd.int_fd(), events.data(), events.size(), timeout_ms);
+    if (num_events < 0) {
+      if (errno == EINTR) { return 0; }
+      return Error::fmt("epoll_wait failed: $", errno_msg());
+    }
+    for (int i = 0; i < num_events; i++) {
+      int fd = events[i].data.fd;
+      auto& watch = _watches[fd];
+      uint32_t ev = events[i].events;
+      bool failed = ev & (EPOLLERR | EPOLLHUP);
+      if (ev & (EPOLLIN | EPOLLRDHUP) || failed) {
+        _ready.insert(_ready.end(), watch.input.begin(), watch.input.end());
+        watch.input.clear();
+      }
+      if (ev & EPOLLOUT || failed) {
+        _ready.insert(_ready.end(), watch.output.begin(), watch.output.end());
+        watch.output.clear();
+      }
+    }
+    bail(more, _run_ready());
+    return more;
+  }
+
+  virtual Backend backend() const override { return Backend::Epoll; }
+
+ protected:
+  virtual void _submit_later(uint32_t slot) override
+  {
+    _ready.push_back(slot);
+  }
+
+ private:
+  explicit EpollRing(FD&& epoll_fd) : _epoll_fd(std::move(epoll_fd)) {}
+
+  struct Watch {
+    std::vector<uint32_t> input;
+    std::vector<uint32_t> output;
+    uint32_t registered = 0;
+  };
+
+  static int64_t _perform(Op& op)
+  {
+    int fd = op.fd->int_fd();
+    int64_t ret = -1;
+    switch (op.kind) {
+    case Op::Kind::Read:
+      ret = ::readv(fd, op.iov.data(), op.prepare_iovecs());
+      break;
+    case Op::Kind::Write:
+      ret = ::writev(fd, op.iov.data(), op.prepare_iovecs());
+      break;
+    case Op::Kind::Accept:
+      ret = ::accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+      break;
+    case Op::Kind::Fsync:
+      ret = ::fsync(fd);
+      break;
+    }
+    return ret < 0 ? -errno : ret;
+  }
+
+  // Attempts every ready operation until it completes or would block
+  OrError<size_t> _run_ready()
+  {
+    size_t completed = 0;
+    _touched.clear();
+    while (!_ready.empty()) {
+      std::swap(_ready, _running);
+      _ready.clear();
+      for (uint32_t slot : _running) {
+        while (true) {
+          auto& op = _op(slot);
+          int fd = op.fd->int_fd();
+          bool output = op.waits_for_output();
+          auto outcome = _finish(slot, _perform(op));
+          if (outcome == Outcome::Again) { continue; }
+          if (outcome == Outcome::Done) {
+            completed++;
+          } else {
+            auto& watch = _watches[fd];
+            (output ? watch.output : watch.input).push_back(slot);
+          }
+          _touched.push_back(fd);
+          break;
+        }
+      }
+    }
+    for (int fd : _touched) { bail_unit(_update_watch(fd)); }
+    return completed;
+  }
+
+  // Registers with epoll the events the operations waiting on fd need
+  OrError<> _update_watch(int fd)
+  {
+    auto it = _watches.find(fd);
+    if (it == _watches.end()) { return ok(); }
+    auto& watch = it->second;
+    uint32_t wanted = 0;
+    if (!watch.input.empty()) { wanted |= EPOLLIN | EPOLLRDHUP; }
+    if (!watch.output.empty()) { wanted |= EPOLLOUT; }
+    if (wanted == watch.registered) {
+      if (wanted == 0) { _watches.erase(it); }
+      return ok();
+    }
+
+    struct epoll_event event = {.events = wanted, .data = {.fd = fd}};
+    int ctl;
+    if (wanted == 0) {
+      ctl = EPOLL_CTL_DEL;
+    } else if (watch.registered == 0) {
+      ctl = EPOLL_CTL_ADD;
+    } else {
+      ctl = EPOLL_CTL_MOD;
+    }
+    int ret = ::epoll_ctl(_epoll_fd.int_fd(), ctl, fd, &event);
+    if (ret != 0 && ctl == EPOLL_CTL_MOD && errno == ENOENT) {
+      // A callback closed the fd, which drops it from epoll, and the number
+      // got reused
+      ret = ::epoll_ctl(_epoll_fd.int_fd(), EPOLL_CTL_ADD, fd, &event);
+    }
+    if (ret != 0 && ctl == EPOLL_CTL_DEL) {
+      // Same, but the fd is gone already
+      if (errno == ENOENT || errno == EBADF) { ret = 0; }
+    }
+    if (ret != 0) {
+      return Error::fmt("epoll_ctl on fd($) failed: $", fd, errno_msg());
+    }
+    watch.registered = wanted;
+    if (wanted == 0) { _watches.erase(it); }
+    return ok();
+  }
+
+  FD _epoll_fd;
+
+  std::vector<uint32_t> _ready;
+  // Scratch space for _run_ready, kept to reuse the allocations
+  std::vector<uint32_t> _running;
+  std::vector<int> _touched;
+  std::unordered_map<int, Watch> _watches;
+};
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// IoRing
+//
+
+IoRing::IoRing() {}
+
+IoRing::~IoRing() noexcept {}
+
+OrError<IoRing::ptr> IoRing::create(size_t queue_depth)
+{
+  auto ring = create(Backend::IoUring, queue_depth);
+  if (ring.is_error()) { return create(Backend::Epoll, queue_depth); }
+  return ring;
+}
+
+OrError<IoRing::ptr> IoRing::create(Backend backend, size_t queue_depth)
+{
+  switch (backend) {
+  case Backend::IoUring: {
+    bail(ring, IoUringRing::create(queue_depth));
+    return ptr(std::move(ring));
+  }
+  case Backend::Epoll: {
+    bail(ring, EpollRing::create());
+    return ptr(std::move(ring));
+  }
+  }
+  assert(false && "This should not happen");
+}
+
+} // namespace bee
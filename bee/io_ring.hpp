@@ -0,0 +1,84 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "data_buffer.hpp"
+#include "fd.hpp"
+#include "or_error.hpp"
+#include "read_result.hpp"
+#include "span.hpp"
+
+namespace bee {
+
+// Asynchronous I/O over many FDs at once. Operations are only queued by read,
+// write, accept and fsync, poll hands the whole batch to the kernel and runs
+// the callbacks of the operations that complete.
+//
+// io_uring is used when the kernel supports it, otherwise readiness is tracked
+// with epoll and the operations run as plain syscalls, in which case fsync is
+// done synchronously from poll. Either way the FDs must be in non-blocking
+// mode, and must stay open while they have operations pending.
+struct IoRing {
+ public:
+  enum class Backend {
+    IoUring,
+    Epoll,
+  };
+
+  using ptr = std::unique_ptr<IoRing>;
+
+  using read_callback = std::function<void(OrError<ReadResult>&&)>;
+  using write_callback = std::function<void(OrError<size_t>&&)>;
+  using accept_callback = std::function<void(OrError<FD>&&)>;
+  using fsync_callback = std::function<void(OrError<>&&)>;
+
+  static constexpr size_t DefaultQueueDepth = 256;
+
+  // Uses io_uring when available and epoll otherwise
+  static OrError<ptr> create(size_t queue_depth = DefaultQueueDepth);
+  static OrError<ptr> create(
+    Backend backend, size_t queue_depth = DefaultQueueDepth);
+
+  IoRing(const IoRing&) = delete;
+  IoRing(IoRing&&) = delete;
+  IoRing& operator=(const IoRing&) = delete;
+  IoRing& operator=(IoRing&&) = delete;
+
+  // Operations still pending are dropped without running their callbacks,
+  // once the kernel is done with their buffers
+  virtual ~IoRing() noexcept;
+
+  // Appends up to max_size bytes to buffer, completes as soon as some data or
+  // EOF is available. The buffer must not be touched until the callback runs.
+  virtual void read(
+    const FD::shared_ptr& fd,
+    DataBuffer& buffer,
+    size_t max_size,
+    read_callback&& callback) = 0;
+
+  // Completes once all of data was written, with the number of bytes written
+  virtual void write(
+    const FD::shared_ptr& fd, DataBuffer&& data, write_callback&& callback) = 0;
+
+  // Completes with the next connection on a listening socket
+  virtual void accept(const FD::shared_ptr& fd, accept_callback&& callback) = 0;
+
+  virtual void fsync(const FD::shared_ptr& fd, fsync_callback&& callback) = 0;
+
+  // Submits the queued operations and runs the callbacks of the ones that
+  // complete, waiting up to timeout for at least one when nothing completed
+  // right away, or forever without a timeout. Returns how many completed.
+  virtual OrError<size_t> poll(std::optional<Span> timeout = std::nullopt) = 0;
+
+  // Operations queued or in flight
+  virtual size_t pending() const = 0;
+
+  virtual Backend backend() const = 0;
+
+ protected:
+  IoRing();
+};
+
+} // namespace bee
@@ -0,0 +1,274 @@
+#include "io_ring.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "errno_msg.hpp"
+#include "scoped_tmp_dir.hpp"
+#include "socket.hpp"
+#include "testing.hpp"
+
+using std::string;
+using std::vector;
+
+namespace bee {
+namespace {
+
+// The default is io_uring when the kernel allows it and epoll otherwise, so
+// the output is the same either way
+enum class TestBackend {
+  Default,
+  Epoll,
+};
+
+const vector<TestBackend> backends = {
+  TestBackend::Default,
+  TestBackend::Epoll,
+};
+
+const char* backend_name(TestBackend backend)
+{
+  switch (backend) {
+  case TestBackend::Default:
+    return "default";
+  case TestBackend::Epoll:
+    return "epoll";
+  }
+  return "unknown";
+}
+
+OrError<IoRing::ptr> create_ring(
+  TestBackend backend, size_t queue_depth = IoRing::DefaultQueueDepth)
+{
+  switch (backend) {
+  case TestBackend::Default:
+    return IoRing::create(queue_depth);
+  case TestBackend::Epoll:
+    return IoRing::create(IoRing::Backend::Epoll, queue_depth);
+  }
+  return Error("Unknown backend");
+}
+
+// For the syscalls that set up a test, which return -1 and set errno on
+// failure
+OrError<> check_syscall(int ret, const char* name)
+{
+  if (ret != 0) { return Error::fmt("$ failed: $", name, errno_msg()); }
+  return ok();
+}
+
+Pipe create_pipe()
+{
+  auto pipe = Pipe::create().value();
+  pipe.read_fd->set_blocking(false).value();
+  pipe.write_fd->set_blocking(false).value();
+  return pipe;
+}
+
+void run_until_done(IoRing& ring)
+{
+  while (ring.pending() > 0) { must_unit(ring.poll(Span::of_seconds(5))); }
+}
+
+TEST(pipe_roundtrip)
+{
+  for (auto backend : backends) {
+    P("backend: $", backend_name(backend));
+    must(ring, create_ring(backend));
+    auto pipe = create_pipe();
+
+    DataBuffer output;
+    ring->read(pipe.read_fd, output, 1024, [&](OrError<ReadResult>&& ret) {
+      P("read: $", ret.value().bytes_read());
+    });
+    must(completed, ring->poll(Span::of_millis(10)));
+    P("completed before write: $", completed);
+
+    ring->write(
+      pipe.write_fd, DataBuffer("hello world"), [](OrError<size_t>&& ret) {
+        P("written: $", ret.value());
+      });
+    run_until_done(*ring);
+    P("output: '$'", output.to_string());
+
+    pipe.write_fd->close();
+    ring->read(pipe.read_fd, output, 1024, [](OrError<ReadResult>&& ret) {
+      P("eof: $", ret.value().is_eof());
+    });
+    run_until_done(*ring);
+  }
+}
+
+TEST(many_pipes)
+{
+  for (auto backend : backends) {
+    must(ring, create_ring(backend, 32));
+    constexpr int num_pipes = 100;
+    constexpr size_t size = 200000;
+    vector<Pipe> pipes;
+    vector<DataBuffer> outputs(num_pipes);
+    vector<string> expected;
+    int writes_done = 0;
+    std::function<void(int)> read_more = [&](int i) {
+      ring->read(
+        pipes[i].read_fd, outputs[i], size, [&, i](OrError<ReadResult>&& ret) {
+          if (!ret.value().is_eof()) { read_more(i); }
+        });
+    };
+    for (int i = 0; i < num_pipes; i++) {
+      pipes.push_back(create_pipe());
+      expected.push_back(string(size, 'a' + i % 26));
+      ring->write(
+        pipes[i].write_fd,
+        DataBuffer(expected.back()),
+        [&, i](OrError<size_t>&& ret) {
+          assert(ret.value() == size);
+          pipes[i].write_fd->close();
+          writes_done++;
+        });
+      read_more(i);
+    }
+    run_until_done(*ring);
+    int matches = 0;
+    for (int i = 0; i < num_pipes; i++) {
+      if (outputs[i].to_string() == expected[i]) { matches++; }
+    }
+    P("$: writes done: $ matches: $",
+      backend_name(backend),
+      writes_done,
+      matches);
+  }
+}
+
+TEST(socketpair_echo)
+{
+  for (auto backend : backends) {
+    must(ring, create_ring(backend));
+    int fds[2];
+    must_unit(check_syscall(
+      ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds),
+      "socketpair"));
+    auto client = FD(fds[0]).to_shared();
+    auto server = FD(fds[1]).to_shared();
+
+    DataBuffer server_input;
+    DataBuffer client_input;
+    ring->read(server, server_input, 1024, [&](OrError<ReadResult>&& ret) {
+      must_unit(ret);
+      ring->write(server, std::move(server_input), [](OrError<size_t>&& ret) {
+        must_unit(ret);
+      });
+    });
+    ring->write(client, DataBuffer("ping"), [](OrError<size_t>&& ret) {
+      must_unit(ret);
+    });
+    ring->read(client, client_input, 1024, [](OrError<ReadResult>&& ret) {
+      must_unit(ret);
+    });
+    run_until_done(*ring);
+    P("$: echoed '$'", backend_name(backend), client_input.to_string());
+  }
+}
+
+TEST(accept)
+{
+  for (auto backend : backends) {
+    must(ring, create_ring(backend));
+    must(tmp_dir, ScopedTmpDir::create());
+    auto path = (tmp_dir.path() / "socket").to_string();
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, path.data(), sizeof(addr.sun_path) - 1);
+    auto addr_ptr = reinterpret_cast<struct sockaddr*>(&addr);
+
+    must(listener, create_socket_fd(AF_UNIX));
+    must_unit(listener.set_blocking(false));
+    must_unit(check_syscall(
+      ::bind(listener.int_fd(), addr_ptr, sizeof(addr)), "bind"));
+    must_unit(check_syscall(::listen(listener.int_fd(), 8), "listen"));
+    auto listener_ptr = std::move(listener).to_shared();
+
+    std::optional<FD> accepted;
+    ring->accept(listener_ptr, [&](OrError<FD>&& ret) {
+      accepted.emplace(std::move(ret.value()));
+    });
+    must(completed, ring->poll(Span::of_millis(10)));
+    P("completed before connect: $", completed);
+
+    must(client, create_socket_fd(AF_UNIX));
+    must_unit(check_syscall(
+      ::connect(client.int_fd(), addr_ptr, sizeof(addr)), "connect"));
+    run_until_done(*ring);
+    P("$: accepted: $", backend_name(backend), accepted.has_value());
+  }
+}
+
+TEST(fsync)
+{
+  for (auto backend : backends) {
+    must(ring, create_ring(backend));
+    must(tmp_dir, ScopedTmpDir::create());
+    must(fd, FD::create_file(tmp_dir.path() / "file"));
+    auto file = std::move(fd).to_shared();
+    ring->write(file, DataBuffer("some content"), [&](OrError<size_t>&& ret) {
+      must_unit(ret);
+      ring->fsync(file, [&](OrError<>&& ret) {
+        P("$: fsync ok: $", backend_name(backend), ret.is_ok());
+      });
+    });
+    run_until_done(*ring);
+  }
+}
+
+TEST(destroy_with_blocked_write)
+{
+  for (auto backend : backends) {
+    must(ring, create_ring(backend));
+    int fds[2];
+    must_unit(check_syscall(
+      ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds),
+      "socketpair"));
+    auto client = FD(fds[0]).to_shared();
+    auto server = FD(fds[1]).to_shared();
+
+    // More than the socket buffers hold, with nobody reading it
+    DataBuffer data(string(16 << 20, 'x'));
+    bool write_done = false;
+    ring->write(client, std::move(data), [&](OrError<size_t>&&) {
+      write_done = true;
+    });
+    DataBuffer input;
+    bool read_done = false;
+    ring->read(client, input, 1024, [&](OrError<ReadResult>&&) {
+      read_done = true;
+    });
+    must_unit(ring->poll(Span::of_millis(10)));
+    P("$: pending: $", backend_name(backend), ring->pending());
+    ring = nullptr;
+
+    // The read was cancelled, it doesn't get the data sent after the ring is
+    // gone
+    must_unit(server->write(DataBuffer("late")));
+    Span::of_millis(10).sleep();
+    P("write done: $, read done: $, input: '$'",
+      write_done,
+      read_done,
+      input.to_string());
+  }
+}
+
+TEST(errors)
+{
+  for (auto backend : backends) {
+    must(ring, create_ring(backend));
+    auto pipe = create_pipe();
+    DataBuffer output;
+    // Reading from the write end fails
+    ring->read(pipe.write_fd, output, 10, [&](OrError<ReadResult>&& ret) {
+      P("$: read error: $", backend_name(backend), ret.is_error());
+    });
+    run_until_done(*ring);
+  }
+}
+
+} // namespace
+} // namespace bee
@@ -0,0 +1,178 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <sys/mman.h>
+
+#include "errno_msg.hpp"
+#include "fd.hpp"
+
+using std::string;
+using std::vector;
+
+namespace bee {
+namespace {
+
+int to_system_advice(MapAdvice advice)
+{
+  switch (advice) {
+  case MapAdvice::Normal:
+    return MADV_NORMAL;
+  case MapAdvice::Sequential:
+    return MADV_SEQUENTIAL;
+  case MapAdvice::Random:
+    return MADV_RANDOM;
+  case MapAdvice::WillNeed:
+    return MADV_WILLNEED;
+  }
+  assert(false && "This should not happen");
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+// MappedFile
+//
+
+MappedFile::MappedFile(std::byte* data, size_t size) : _data(data), _size(size)
+{}
+
+MappedFile::~MappedFile() noexcept { close(); }
+
+OrError<MappedFile::ptr> MappedFile::open(
+  const FilePath& filename, MapAdvice advice)
+{
+  bail(fd, FD::open_file(filename));
+  bail(size, fd.remaining_bytes(), "Failed to get size of '$'", filename);
+  // mmap refuses empty mappings, an empty file needs no mapping anyway
+  if (size == 0) { return ptr(new MappedFile(nullptr, 0)); }
+  void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.int_fd(), 0);
+  if (data == MAP_FAILED) {
+    return Error::fmt("Failed to mmap file '$': $", filename, errno_msg());
+  }
+  auto file = ptr(new MappedFile(static_cast<std::byte*>(data), size));
+  bail_unit(file->advise(advice));
+  return file;
+}
+
+OrError<> MappedFile::advise(MapAdvice advice)
+{
+  if (_data == nullptr) { return ok(); }
+  if (::madvise(_data, _size, to_system_advice(advice)) != 0) {
+    return Error::fmt("madvise failed: $", errno_msg());
+  }
+  return ok();
+}
+
+std::span<const std::byte> MappedFile::bytes() const { return {_data, _size}; }
+
+std::string_view MappedFile::view() const
+{
+  return {reinterpret_cast<const char*>(_data), _size};
+}
+
+size_t MappedFile::size() const { return _size; }
+
+std::string_view MappedFile::_remaining_view() const
+{
+  return view().substr(_pos);
+}
+
+OrError<std::optional<string>> MappedFile::read_line()
+{
+  bail(line, read_line_view());
+  if (!line.has_value()) { return std::nullopt; }
+  return string(*line);
+}
+
+OrError<std::optional<std::string_view>> MappedFile::read_line_view()
+{
+  auto remaining = _remaining_view();
+  if (remaining.empty()) { return std::nullopt; }
+  auto eol = remaining.find('\n');
+  std::string_view line;
+  if (eol == std::string_view::npos) {
+    line = remaining;
+    _pos = _size;
+  } else {
+    line = remaining.substr(0, eol);
+    _pos += eol + 1;
+  }
+  if (line.find('\r') != std::string_view::npos) {
+    _line_scratch.assign(line);
+    std::erase(_line_scratch, '\r');
+    line = _line_scratch;
+    // Matches FileReader, a trailing '\r' alone is not a line
+    if (line.empty() && eol == std::string_view::npos) {
+      return std::nullopt;
+    }
+  }
+  return line;
+}
+
+OrError<vector<string>> MappedFile::read_all_lines()
+{
+  vector<string> output;
+  while (true) {
+    bail(line, read_line_view());
+    if (!line.has_value()) { break; }
+    output.emplace_back(*line);
+  }
+  return output;
+}
+
+OrError<string> MappedFile::read_all()
+{
+  string output(_remaining_view());
+  _pos = _size;
+  return output;
+}
+
+OrError<vector<std::byte>> MappedFile::read_all_bytes()
+{
+  vector<std::byte> output(_data + _pos, _data + _size);
+  _pos = _size;
+  return output;
+}
+
+OrError<size_t> MappedFile::remaining_bytes() { return _size - _pos; }
+
+bool MappedFile::close()
+{
+  if (_data == nullptr) { return false; }
+  auto ret = ::munmap(_data, _size);
+  _data = nullptr;
+  _size = 0;
+  _pos = 0;
+  return ret == 0;
+}
+
+OrError<size_t> MappedFile::read_raw(std::byte* buffer, size_t size)
+{
+  size_t to_copy = std::min(size, _size - _pos);
+  memcpy(buffer, _data + _pos, to_copy);
+  _pos += to_copy;
+  return to_copy;
+}
+
+OrError<string> MappedFile::read_file(const FilePath& filename)
+{
+  bail(file, MappedFile::open(filename));
+  return file->read_all();
+}
+
+OrError<vector<std::byte>> MappedFile::read_file_bytes(const FilePath& filename)
+{
+  bail(file, MappedFile::open(filename));
+  return file->read_all_bytes();
+}
+
+OrError<vector<string>> MappedFile::read_file_lines(const FilePath& filename)
+{
+  bail(file, MappedFile::open(filename));
+  return file->read_all_lines();
+}
+
+} // namespace bee
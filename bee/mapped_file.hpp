@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "file_path.hpp"
+#include "or_error.hpp"
+#include "reader.hpp"
+
+namespace bee {
+
+enum class MapAdvice {
+  Normal,
+  Sequential,
+  Random,
+  WillNeed,
+};
+
+// Read only memory mapping of a whole file. Offers the same reading methods
+// as FileReader, but lines and contents can be looked at in place without
+// copying them out of the mapping.
+struct MappedFile final : public Reader {
+ public:
+  using ptr = std::unique_ptr<MappedFile>;
+
+  static OrError<ptr> open(
+    const FilePath& filename, MapAdvice advice = MapAdvice::Sequential);
+
+  static OrError<std::string> read_file(const FilePath& filename);
+  static OrError<std::vector<std::byte>> read_file_bytes(
+    const FilePath& filename);
+
+  static OrError<std::vector<std::string>> read_file_lines(
+    const FilePath& filename);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile& operator=(MappedFile&&) = delete;
+
+  virtual ~MappedFile() noexcept;
+
+  // Hints the kernel about how the mapping is going to be accessed
+  OrError<> advise(MapAdvice advice);
+
+  // The whole file, regardless of how much was already read
+  std::span<const std::byte> bytes() const;
+  std::string_view view() const;
+
+  size_t size() const;
+
+  OrError<std::optional<std::string>> read_line();
+
+  // Same as read_line, but points into the mapping. It only needs a copy when
+  // the line has '\r' characters to drop, the view is valid until the next
+  // read.
+  OrError<std::optional<std::string_view>> read_line_view();
+
+  OrError<std::vector<std::string>> read_all_lines();
+
+  OrError<std::string> read_all();
+  OrError<std::vector<std::byte>> read_all_bytes();
+
+  virtual OrError<size_t> remaining_bytes() override;
+
+  virtual bool close() override;
+
+ protected:
+  [[nodiscard]] virtual OrError<size_t> read_raw(
+    std::byte* buffer, size_t size) override;
+
+ private:
+  MappedFile(std::byte* data, size_t size);
+
+  std::string_view _remaining_view() const;
+
+  std::byte* _data;
+  size_t _size;
+  size_t _pos = 0;
+
+  std::string _line_scratch;
+};
+
+} // namespace bee
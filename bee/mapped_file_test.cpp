@@ -0,0 +1,72 @@
+#include "file_reader.hpp"
+#include "file_writer.hpp"
+#include "mapped_file.hpp"
+#include "scoped_tmp_dir.hpp"
+#include "testing.hpp"
+
+using std::string;
+
+namespace bee {
+namespace {
+
+TEST(read_lines)
+{
+  must(dir, ScopedTmpDir::create());
+  auto path = dir.path() / "lines.txt";
+  must_unit(FileWriter::write_file(
+    path, "first\r\nsecond\n\nwith\rcr\nno trailing new line"));
+  must(file, MappedFile::open(path));
+  P("size: $", file->size());
+  while (true) {
+    must(line, file->read_line_view());
+    if (!line.has_value()) { break; }
+    P("'$'", *line);
+  }
+}
+
+TEST(same_as_file_reader)
+{
+  must(dir, ScopedTmpDir::create());
+  auto path = dir.path() / "content.txt";
+  string content;
+  for (int i = 0; i < 10000; i++) { content += F("line $\n", i * 31); }
+  must_unit(FileWriter::write_file(path, content));
+  must(mapped_lines, MappedFile::read_file_lines(path));
+  must(read_lines, FileReader::read_file_lines(path));
+  P("lines: $ matches: $", mapped_lines.size(), mapped_lines == read_lines);
+  must(mapped_content, MappedFile::read_file(path));
+  P("content matches: $", mapped_content == content);
+}
+
+TEST(reader_interface)
+{
+  must(dir, ScopedTmpDir::create());
+  auto path = dir.path() / "content.txt";
+  must_unit(FileWriter::write_file(path, "0123456789"));
+  must(file, MappedFile::open(path, MapAdvice::WillNeed));
+  Reader& reader = *file;
+  must(first, reader.read_str(4));
+  must(remaining, reader.remaining_bytes());
+  must(rest, reader.read_str(100));
+  P("'$' remaining:$ '$'", first, remaining, rest);
+  P("view: '$'", file->view());
+}
+
+TEST(empty_file)
+{
+  must(dir, ScopedTmpDir::create());
+  auto path = dir.path() / "empty.txt";
+  must_unit(FileWriter::write_file(path, ""));
+  must(file, MappedFile::open(path));
+  must(line, file->read_line());
+  P("size: $ has line: $", file->size(), line.has_value());
+}
+
+TEST(missing_file)
+{
+  auto file = MappedFile::open(FilePath("/this/file/does/not/exist"));
+  P("is error: $", file.is_error());
+}
+
+} // namespace
+} // namespace bee
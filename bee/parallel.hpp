@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace bee {
+
+struct ParallelOptions {
+  // Defaults to ThreadPool::global()
+  ThreadPool* pool = nullptr;
+
+  // Threads taking part, including the calling thread. Zero uses every worker
+  // of the pool.
+  int num_workers = 0;
+
+  // Ranges smaller than this are not split further
+  size_t grain_size = 4096;
+};
+
+namespace parallel_details {
+
+inline ThreadPool& pool(const ParallelOptions& options)
+{
+  return options.pool != nullptr ? *options.pool : ThreadPool::global();
+}
+
+inline int num_workers(const ParallelOptions& options)
+{
+  if (options.num_workers > 0) { return options.num_workers; }
+  return pool(options).num_workers();
+}
+
+} // namespace parallel_details
+
+// Splits [begin, end) into ranges of at least grain_size and calls
+// fn(range_begin, range_end) for each. Ranges are claimed dynamically, so
+// uneven work still balances. The calling thread works on ranges too, which
+// makes nesting inside pool tasks safe. If fn throws, the ranges not started
+// yet are skipped and the first exception is rethrown once every worker is
+// done.
+template <class F>
+void parallel_for_ranges(
+  size_t begin, size_t end, F&& fn, const ParallelOptions& options = {})
+{
+  if (begin >= end) { return; }
+  size_t size = end - begin;
+  size_t workers = parallel_details::num_workers(options);
+  size_t grain = std::max<size_t>(options.grain_size, 1);
+  // A few ranges per worker, so that one slow range doesn't hold up the rest
+  size_t num_ranges =
+    std::clamp<size_t>((size + grain - 1) / grain, 1, workers * 4);
+  if (num_ranges == 1 || workers == 1) {
+    fn(begin, end);
+    return;
+  }
+
+  std::atomic<size_t> next = 0;
+  auto run = [&]() {
+    while (true) {
+      size_t i = next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= num_ranges) { break; }
+      try {
+        fn(begin + size * i / num_ranges, begin + size * (i + 1) / num_ranges);
+      } catch (...) {
+        next.store(num_ranges, std::memory_order_relaxed);
+        throw;
+      }
+    }
+  };
+
+  auto& pool = parallel_details::pool(options);
+  std::vector<std::future<void>> helpers;
+  for (size_t i = 1; i < std::min(workers, num_ranges); i++) {
+    helpers.push_back(pool.submit(run));
+  }
+  // The helpers use the locals of this frame, they all have to finish before
+  // an exception leaves it
+  std::exception_ptr error;
+  try {
+    run();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  for (auto& helper : helpers) {
+    pool.wait(helper);
+    try {
+      helper.get();
+    } catch (...) {
+      if (error == nullptr) { error = std::current_exception(); }
+    }
+  }
+  if (error != nullptr) { std::rethrow_exception(error); }
+}
+
+// Calls fn(i) for every i in [begin, end)
+template <class F>
+void parallel_for(
+  size_t begin, size_t end, F&& fn, const ParallelOptions& options = {})
+{
+  parallel_for_ranges(
+    begin,
+    end,
+    [&](size_t range_begin, size_t range_end) {
+      for (size_t i = range_begin; i < range_end; i++) { fn(i); }
+    },
+    options);
+}
+
+// out[i] = fn(in[i]) for the range starting at first, out may alias in
+template <
+  std::random_access_iterator InIt,
+  std::random_access_iterator OutIt,
+  class F>
+void parallel_transform(
+  InIt first, InIt last, OutIt out, F&& fn, const ParallelOptions& options = {})
+{
+  parallel_for_ranges(
+    0,
+    last - first,
+    [&](size_t range_begin, size_t range_end) {
+      std::transform(
+        first + range_begin, first + range_end, out + range_begin, fn);
+    },
+    options);
+}
+
+// Folds the range with op, which has to be associative. Partial results are
+// combined in the order of the ranges, so op doesn't have to be commutative.
+template <std::random_access_iterator It, class T, class Op = std::plus<>>
+T parallel_reduce(
+  It first, It last, T init, Op&& op = {}, const ParallelOptions& options = {})
+{
+  // One partial per range, in order
+  std::vector<std::optional<T>> partials;
+  size_t size = last - first;
+  size_t workers = parallel_details::num_workers(options);
+  size_t grain = std::max<size_t>(options.grain_size, 1);
+  size_t num_ranges =
+    std::clamp<size_t>((size + grain - 1) / grain, 1, workers * 4);
+  partials.resize(num_ranges);
+  parallel_for(
+    0,
+    num_ranges,
+    [&](size_t i) {
+      auto range_first = first + size * i / num_ranges;
+      auto range_last = first + size * (i + 1) / num_ranges;
+      if (range_first == range_last) { return; }
+      T partial = T(*range_first);
+      for (auto it = range_first + 1; it != range_last; ++it) {
+        partial = op(std::move(partial), *it);
+      }
+      partials[i] = std::move(partial);
+    },
+    {
+      .pool = options.pool,
+      .num_workers = options.num_workers,
+      .grain_size = 1,
+    });
+  for (auto& partial : partials) {
+    if (partial.has_value()) {
+      init = op(std::move(init), std::move(*partial));
+    }
+  }
+  return init;
+}
+
+namespace parallel_details {
+
+// Merges two sorted runs into out, split into pieces that merge independently:
+// the first run is cut at even positions and the second run at the matching
+// lower bounds, so equal elements keep taking the first run first
+template <class It, class OutIt, class Cmp>
+void add_merge_pieces(
+  It a_first,
+  It a_last,
+  It b_first,
+  It b_last,
+  OutIt out,
+  size_t num_pieces,
+  Cmp& cmp,
+  std::vector<std::function<void()>>& pieces)
+{
+  size_t a_size = a_last - a_first;
+  num_pieces = std::clamp<size_t>(num_pieces, 1, std::max<size_t>(a_size, 1));
+  It prev_a = a_first;
+  It prev_b = b_first;
+  for (size_t i = 1; i <= num_pieces; i++) {
+    It a = a_last;
+    It b = b_last;
+    if (i < num_pieces) {
+      a = a_first + a_size * i / num_pieces;
+      b = std::lower_bound(b_first, b_last, *a, cmp);
+    }
+    auto piece_out = out + ((prev_a - a_first) + (prev_b - b_first));
+    pieces.push_back([=, &cmp]() {
+      std::merge(
+        std::make_move_iterator(prev_a),
+        std::make_move_iterator(a),
+        std::make_move_iterator(prev_b),
+        std::make_move_iterator(b),
+        piece_out,
+        cmp);
+    });
+    prev_a = a;
+    prev_b = b;
+  }
+}
+
+} // namespace parallel_details
+
+// Merge sort: every worker sorts a slice, then the sorted runs are merged
+// pairwise, each merge split across the workers. Not stable. Needs a buffer as
+// large as the range, the elements must be default constructible.
+template <std::random_access_iterator It, class Cmp = std::less<>>
+void parallel_sort(
+  It first, It last, Cmp cmp = {}, const ParallelOptions& options = {})
+{
+  using T = typename std::iterator_traits<It>::value_type;
+  size_t size = last - first;
+  size_t workers = parallel_details::num_workers(options);
+  size_t grain = std::max<size_t>(options.grain_size, 1);
+  size_t num_runs = std::clamp<size_t>(size / grain, 1, workers);
+  if (num_runs == 1) {
+    std::sort(first, last, cmp);
+    return;
+  }
+
+  std::vector<size_t> bounds;
+  for (size_t i = 0; i <= num_runs; i++) {
+    bounds.push_back(size * i / num_runs);
+  }
+  ParallelOptions one_each = {
+    .pool = options.pool,
+    .num_workers = options.num_workers,
+    .grain_size = 1,
+  };
+  parallel_for(
+    0,
+    num_runs,
+    [&](size_t i) {
+      std::sort(first + bounds[i], first + bounds[i + 1], cmp);
+    },
+    one_each);
+
+  std::vector<T> buffer(size);
+  bool in_buffer = false;
+  std::vector<std::function<void()>> pieces;
+  while (bounds.size() > 2) {
+    pieces.clear();
+    std::vector<size_t> merged_bounds;
+    size_t merges = (bounds.size() - 1) / 2;
+    size_t pieces_per_merge = std::max<size_t>(workers / merges, 1);
+    auto merge_round = [&](auto src, auto dst) {
+      for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+        merged_bounds.push_back(bounds[i]);
+        if (i + 2 < bounds.size()) {
+          parallel_details::add_merge_pieces(
+            src + bounds[i],
+            src + bounds[i + 1],
+            src + bounds[i + 1],
+            src + bounds[i + 2],
+            dst + bounds[i],
+            pieces_per_merge,
+            cmp,
+            pieces);
+        } else {
+          // Odd run out, moves over as it is
+          auto from = src + bounds[i];
+          auto to = src + bounds[i + 1];
+          auto out = dst + bounds[i];
+          pieces.push_back([=]() { std::move(from, to, out); });
+        }
+      }
+    };
+    if (in_buffer) {
+      merge_round(buffer.begin(), first);
+    } else {
+      merge_round(first, buffer.begin());
+    }
+    merged_bounds.push_back(size);
+    parallel_for(0, pieces.size(), [&](size_t i) { pieces[i](); }, one_each);
+    bounds = std::move(merged_bounds);
+    in_buffer = !in_buffer;
+  }
+  if (in_buffer) {
+    parallel_for_ranges(
+      0,
+      size,
+      [&](size_t range_begin, size_t range_end) {
+        std::move(
+          buffer.begin() + range_begin,
+          buffer.begin() + range_end,
+          first + range_begin);
+      },
+      options);
+  }
+}
+
+template <class C, class Cmp = std::less<>>
+void parallel_sort(C& cont, Cmp cmp = {}, const ParallelOptions& options = {})
+{
+  parallel_sort(cont.begin(), cont.end(), std::move(cmp), options);
+}
+
+} // namespace bee
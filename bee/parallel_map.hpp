@@ -1,15 +1,76 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <stop_token>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "bee/on_destroy.hpp"
 #include "bee/pop_queue.hpp"
 #include "bee/queue.hpp"
+#include "bee/span.hpp"
+#include "bee/thread_pool.hpp"
+#include "bee/time.hpp"
 
 namespace bee {
 
 struct ParallelMap {
+  // Results move between threads in batches of up to this many, workers flush
+  // a partial batch when MaxBatchDelay passed since their last flush so slow
+  // maps still stream their results
+  static constexpr size_t MaxBatchSize = 256;
+  static inline const Span MaxBatchDelay = Span::of_millis(1);
+
+  struct Options {
+    // How many workers of the global ThreadPool take part in the map
+    int num_workers = 1;
+
+    // Yield the results in the order of the inputs instead of in the order
+    // they complete
+    bool ordered = false;
+
+    // When ordered, workers don't start on an input more than this many
+    // positions ahead of the last result the consumer got to, which bounds
+    // how many results wait to be reordered. Workers that get too far ahead
+    // return to the pool and the consumer resubmits them as it catches up.
+    size_t reorder_window = 16384;
+
+    // Workers claim contiguous ranges of inputs instead of one input at a
+    // time. Ranges start large and shrink as the remaining work does, so the
+    // workers still finish together.
+    bool chunked = false;
+  };
+
+  // Results of consecutive inputs starting at start
+  template <class R> struct Chunk {
+    size_t start;
+    std::vector<R> values;
+  };
+
+  struct Window {
+    std::mutex mutex;
+    // Position of the first input whose result the consumer hasn't got to
+    size_t emitted = 0;
+    int parked = 0;
+  };
+
+  // Whether the next input to be claimed is close enough to the consumer,
+  // called with the window mutex held
+  template <class T>
+  static bool in_window(
+    const PopQueue<T>& inputs, const Window& window, const Options& options)
+  {
+    size_t next = inputs.size() - inputs.remaining();
+    return next < window.emitted + std::max<size_t>(options.reorder_window, 1);
+  }
+
   template <class T, class R>
   struct State : public std::enable_shared_from_this<State<T, R>> {
     using ptr = std::shared_ptr<State>;
@@ -18,46 +79,126 @@ struct ParallelMap {
 
     struct Iterator {
      public:
-      Iterator(ptr state) : _state(state), _it(state->output_queue->begin()) {}
+      Iterator(ptr state) : _state(state) { _next_chunk(); }
 
       Iterator(const Iterator& other) = delete;
       Iterator(Iterator&& other) = default;
 
-      R& operator*() { return *_it; }
+      R& operator*() { return _values[_index]; }
 
       Iterator& operator++()
       {
-        ++_it;
-        if (_it.ended()) { _state->join(); }
+        if (++_index == _values.size()) { _next_chunk(); }
         return *this;
       }
 
-      bool operator==(const EndIterator&) const { return _it.ended(); }
+      bool operator==(const EndIterator&) const { return _ended; }
 
      private:
+      void _next_chunk()
+      {
+        _values.clear();
+        _index = 0;
+        while (_values.empty()) {
+          if (!_take_pending() && !_refill()) {
+            _ended = true;
+            _state->join();
+            return;
+          }
+        }
+      }
+
+      // Unordered takes any chunk, ordered only the one that comes next
+      bool _take_pending()
+      {
+        if (_pending.empty()) { return false; }
+        auto it = _pending.begin();
+        if (_state->options.ordered && it->first != _next) { return false; }
+        _values = std::move(it->second);
+        _next = it->first + _values.size();
+        _pending.erase(it);
+        if (_state->options.ordered) { _state->advance_window(_next); }
+        return true;
+      }
+
+      // Returns false once all the results were received
+      bool _refill()
+      {
+        auto& queue = *_state->output_queue;
+        auto& pool = _state->pool;
+        _received.clear();
+        if (pool.is_worker_thread()) {
+          // Blocking here could leave no worker to produce the results
+          pool.help_until([&]() {
+            return queue.pop_many_non_blocking(_received, MaxBatchSize) > 0 ||
+                   queue.is_closed_and_empty();
+          });
+        } else {
+          queue.pop_many(_received, MaxBatchSize);
+        }
+        for (auto& chunk : _received) {
+          _pending.emplace(chunk.start, std::move(chunk.values));
+        }
+        return !_received.empty();
+      }
+
       ptr _state;
-      typename bee::Queue<R>::Iterator _it;
+      std::vector<R> _values;
+      size_t _index = 0;
+      bool _ended = false;
+
+      std::vector<Chunk<R>> _received;
+      std::map<size_t, std::vector<R>> _pending;
+      size_t _next = 0;
     };
 
-    State() {}
+    State(
+      ThreadPool& pool,
+      const Options& options,
+      const bee::PopQueue<T>::ptr& input_queue)
+        : pool(pool), options(options), input_queue(input_queue)
+    {}
 
     ~State() { assert(_joined); }
 
     State(const State& other) = delete;
     State(State&& other) = delete;
 
+    // Resubmits the parked workers once the next input is within the window
+    void advance_window(size_t emitted)
+    {
+      int resume = 0;
+      {
+        std::unique_lock lk(window->mutex);
+        window->emitted = emitted;
+        if (window->parked > 0 && in_window(*input_queue, *window, options)) {
+          resume = std::exchange(window->parked, 0);
+        }
+      }
+      for (int i = 0; i < resume; i++) { tasks.push_back(pool.submit(worker)); }
+    }
+
     void join()
     {
       assert(!_joined);
-      waiter.join();
+      for (auto& task : tasks) {
+        pool.wait(task);
+        task.get();
+      }
       _joined = true;
     }
 
     Iterator begin() { return Iterator(this->shared_from_this()); }
     EndIterator end() { return EndIterator(); }
 
-    bee::Queue<R>::ptr output_queue = bee::Queue<R>::create();
-    std::thread waiter;
+    ThreadPool& pool;
+    const Options options;
+    bee::PopQueue<T>::ptr input_queue;
+    bee::Queue<Chunk<R>>::ptr output_queue = bee::Queue<Chunk<R>>::create();
+    std::shared_ptr<Window> window = std::make_shared<Window>();
+    // Submitted once per worker, and again for every parked worker resumed
+    std::function<void()> worker;
+    std::vector<std::future<void>> tasks;
 
    private:
     bool _joined = false;
@@ -78,6 +219,8 @@ struct ParallelMap {
     typename S::ptr _state;
   };
 
+  // Runs on the global ThreadPool, num_workers caps how many of its workers
+  // take part in this map
   template <
     class Inputs,
     class F,
@@ -85,27 +228,286 @@ struct ParallelMap {
     std::move_constructible R = std::invoke_result_t<F, T>>
   static StateWrapper<T, R> go(Inputs&& inputs, int num_workers, F&& map)
   {
+    return go(
+      std::forward<Inputs>(inputs),
+      Options{.num_workers = num_workers},
+      std::forward<F>(map));
+  }
+
+  template <
+    class Inputs,
+    class F,
+    class T = typename std::decay_t<Inputs>::value_type,
+    std::move_constructible R = std::invoke_result_t<F, T>>
+  static StateWrapper<T, R> go(
+    Inputs&& inputs, const Options& options, F&& map)
+  {
+    int num_workers = std::max(options.num_workers, 1);
+    auto& pool = ThreadPool::global();
     auto input_queue = bee::PopQueue<T>::create(std::forward<Inputs>(inputs));
-    auto state = std::make_shared<State<T, R>>();
+    auto state = std::make_shared<State<T, R>>(pool, options, input_queue);
 
-    std::vector<std::thread> workers;
-    for (int i = 0; i < num_workers; i++) {
-      workers.emplace_back(
-        [input_queue, output_queue = state->output_queue, map] {
-          for (auto&& input : *input_queue) {
-            output_queue->push(map(std::move(input)));
+    auto chunk_size = [input_queue, options, num_workers]() -> size_t {
+      if (!options.chunked) { return 1; }
+      size_t n = input_queue->remaining() / (4 * num_workers);
+      if (options.ordered) {
+        n = std::min(n, options.reorder_window / num_workers);
+      }
+      return std::max<size_t>(n, 1);
+    };
+
+    // The last worker to finish closes the output
+    auto running = std::make_shared<std::atomic<int>>(num_workers);
+    state->worker = [input_queue,
+                     output_queue = state->output_queue,
+                     window = state->window,
+                     options,
+                     chunk_size,
+                     map,
+                     running] {
+      bool parked = false;
+      OnDestroy close([&]() {
+        if (!parked && running->fetch_sub(1) == 1) { output_queue->close(); }
+      });
+      std::vector<Chunk<R>> batch;
+      size_t batch_size = 0;
+      auto last_flush = Time::monotonic();
+      auto flush = [&](Time now) {
+        output_queue->push_many(batch);
+        batch.clear();
+        batch_size = 0;
+        last_flush = now;
+      };
+      // Called with the window mutex held
+      auto must_park = [&]() {
+        return input_queue->remaining() > 0 &&
+               !in_window(*input_queue, *window, options);
+      };
+      while (true) {
+        if (options.ordered) {
+          // Don't block the pool waiting for the consumer, park and let it
+          // resubmit this worker. The consumer may be waiting for results
+          // that are still in the batch.
+          std::unique_lock lk(window->mutex);
+          if (must_park()) {
+            lk.unlock();
+            flush(Time::monotonic());
+            lk.lock();
+            if (must_park()) {
+              window->parked++;
+              parked = true;
+              return;
+            }
           }
-        });
+        }
+        auto [start, inputs] = input_queue->pop_range(chunk_size());
+        if (inputs.empty()) { break; }
+        if (
+          batch.empty() ||
+          batch.back().start + batch.back().values.size() != start) {
+          batch.push_back(Chunk<R>{.start = start, .values = {}});
+        }
+        auto& values = batch.back().values;
+        for (auto& input : inputs) { values.push_back(map(std::move(input))); }
+        batch_size += inputs.size();
+        auto now = Time::monotonic();
+        if (batch_size >= MaxBatchSize || now - last_flush >= MaxBatchDelay) {
+          flush(now);
+        }
+      }
+      flush(Time::monotonic());
+    };
+    for (int i = 0; i < num_workers; i++) {
+      state->tasks.push_back(pool.submit(state->worker));
     }
 
-    state->waiter = std::thread([workers = std::move(workers),
-                                 output_queue = state->output_queue]() mutable {
-      for (auto&& worker : workers) { worker.join(); }
-      output_queue->close();
-    });
-
     return state;
   }
+
+  struct StreamOptions {
+    int num_workers = 1;
+
+    // Cap on the inputs waiting to be mapped, and separately on the results
+    // waiting to be consumed. A slow consumer blocks the workers, which in
+    // turn block whoever feeds the input, so memory stays flat however long
+    // the stream is.
+    size_t max_in_flight = 1024;
+  };
+
+  // Unlike go, the workers of a stream are dedicated threads, they spend their
+  // time blocked on the input and the output and would starve the pool
+  template <class T, class R>
+  struct Stream : public std::enable_shared_from_this<Stream<T, R>> {
+   public:
+    using ptr = std::shared_ptr<Stream>;
+
+    struct EndIterator {};
+
+    struct Iterator {
+     public:
+      Iterator(ptr stream) : _stream(stream) { _refill(); }
+
+      Iterator(const Iterator& other) = delete;
+      Iterator(Iterator&& other) = default;
+
+      R& operator*() { return _batch[_index]; }
+
+      Iterator& operator++()
+      {
+        if (++_index == _batch.size()) { _refill(); }
+        return *this;
+      }
+
+      bool operator==(const EndIterator&) const { return _batch.empty(); }
+
+     private:
+      void _refill()
+      {
+        _batch.clear();
+        _index = 0;
+        _stream->output->pop_many(_batch, MaxBatchSize);
+        if (_batch.empty()) { _stream->join(); }
+      }
+
+      ptr _stream;
+      std::vector<R> _batch;
+      size_t _index = 0;
+    };
+
+    Stream(const StreamOptions& options, const typename Queue<T>::ptr& input)
+        : input(input),
+          output(std::make_shared<Queue<R>>(_max_queue_size(options)))
+    {}
+
+    // Stopping early closes the output and stops the workers waiting on the
+    // input, a source given to the stream is left open with the values the
+    // workers didn't take
+    ~Stream()
+    {
+      stop.request_stop();
+      output->close();
+      if (owns_input) { input->close(); }
+      join();
+    }
+
+    Stream(const Stream& other) = delete;
+    Stream(Stream&& other) = delete;
+
+    void join()
+    {
+      for (auto& thread : threads) {
+        if (thread.joinable()) { thread.join(); }
+      }
+    }
+
+    Iterator begin() { return Iterator(this->shared_from_this()); }
+    EndIterator end() { return EndIterator(); }
+
+    typename Queue<T>::ptr input;
+    typename Queue<R>::ptr output;
+    // Whether the input was created by the stream rather than given to it
+    bool owns_input = false;
+    std::stop_source stop;
+    std::vector<std::thread> threads;
+  };
+
+  template <class T, class R> struct StreamWrapper {
+   public:
+    using S = Stream<T, R>;
+
+    StreamWrapper(const typename S::ptr& stream) : _stream(stream) {}
+
+    auto begin() { return _stream->begin(); }
+    auto end() { return _stream->end(); }
+
+    void join() { _stream->join(); }
+
+   private:
+    typename S::ptr _stream;
+  };
+
+  // Maps values popped from source until it is closed and drained. The source
+  // should be bounded for the stream to apply backpressure to its producer.
+  template <
+    class T,
+    class F,
+    std::move_constructible R = std::invoke_result_t<F, T>>
+  static StreamWrapper<T, R> stream(
+    const std::shared_ptr<Queue<T>>& source,
+    const StreamOptions& options,
+    F&& map)
+  {
+    return _start_stream<T, R>(source, options, std::forward<F>(map));
+  }
+
+  // Maps the values between begin and end, which are read by a feeder thread
+  // as the workers need them, so the range can be much larger than memory.
+  // The iterators have to stay valid until the stream is done.
+  template <
+    class It,
+    class Sentinel,
+    class F,
+    class T = std::decay_t<decltype(*std::declval<It>())>,
+    std::move_constructible R = std::invoke_result_t<F, T>>
+  static StreamWrapper<T, R> stream(
+    It begin, Sentinel end, const StreamOptions& options, F&& map)
+  {
+    auto input = std::make_shared<Queue<T>>(_max_queue_size(options));
+    auto stream = _start_stream<T, R>(input, options, std::forward<F>(map));
+    stream->owns_input = true;
+    stream->threads.emplace_back(
+      [input, begin = std::move(begin), end]() mutable {
+        for (; begin != end; ++begin) {
+          if (!input->push(*begin)) { break; }
+        }
+        input->close();
+      });
+    return stream;
+  }
+
+ private:
+  static int _max_queue_size(const StreamOptions& options)
+  {
+    return std::max<size_t>(options.max_in_flight, 1);
+  }
+
+  template <class T, class R, class F>
+  static Stream<T, R>::ptr _start_stream(
+    const typename Queue<T>::ptr& source,
+    const StreamOptions& options,
+    F&& map)
+  {
+    auto stream = std::make_shared<Stream<T, R>>(options, source);
+    int num_workers = std::max(options.num_workers, 1);
+    // Small batches, they count towards the values in flight
+    size_t batch_size = std::clamp<size_t>(
+      options.max_in_flight / num_workers, 1, MaxBatchSize);
+    auto running = std::make_shared<std::atomic<int>>(num_workers);
+    for (int i = 0; i < num_workers; i++) {
+      stream->threads.emplace_back(
+        [input = stream->input,
+         output = stream->output,
+         stop = stream->stop.get_token(),
+         batch_size,
+         map,
+         running] {
+          OnDestroy close([&]() {
+            if (running->fetch_sub(1) == 1) { output->close(); }
+          });
+          std::vector<T> inputs;
+          std::vector<R> results;
+          while (input->pop_many(inputs, batch_size, stop) > 0) {
+            for (auto& value : inputs) {
+              results.push_back(map(std::move(value)));
+            }
+            inputs.clear();
+            if (output->push_many(results) < results.size()) { break; }
+            results.clear();
+          }
+        });
+    }
+    return stream;
+  }
 };
 
 } // namespace bee
@@ -41,5 +41,215 @@ TEST(basic)
   P(outputs);
 }
 
+TEST(empty)
+{
+  vector<int> inputs;
+  int count = 0;
+  for (auto r : ParallelMap::go(inputs, 4, [](int v) { return v; })) {
+    count += r;
+  }
+  P("count: $", count);
+}
+
+TEST(many_batches)
+{
+  vector<int> inputs;
+  for (int i = 0; i < 100000; i++) { inputs.push_back(i); }
+  int64_t sum = 0;
+  int count = 0;
+  for (auto r : ParallelMap::go(inputs, 4, [](int v) { return 2 * v; })) {
+    sum += r;
+    count++;
+  }
+  P("count: $ sum: $", count, sum);
+}
+
+TEST(ordered)
+{
+  vector<int> inputs;
+  for (int i = 5; i < 50; i++) { inputs.push_back(i); }
+  vector<pair<int, bool>> outputs;
+  for (auto r : ParallelMap::go(
+         inputs, {.num_workers = 3, .ordered = true}, check_prime_runner)) {
+    outputs.push_back(r);
+  }
+  P(outputs);
+}
+
+TEST(modes)
+{
+  constexpr int size = 100000;
+  for (bool ordered : {false, true}) {
+    for (bool chunked : {false, true}) {
+      vector<int> inputs;
+      for (int i = 0; i < size; i++) { inputs.push_back(i); }
+      ParallelMap::Options options = {
+        .num_workers = 4,
+        .ordered = ordered,
+        .reorder_window = 1000,
+        .chunked = chunked,
+      };
+      int64_t sum = 0;
+      int count = 0;
+      bool in_order = true;
+      for (auto r : ParallelMap::go(inputs, options, [](int v) { return v; })) {
+        in_order = in_order && r == count;
+        sum += r;
+        count++;
+      }
+      P("ordered:$ chunked:$ count:$ sum:$ in order:$",
+        ordered,
+        chunked,
+        count,
+        sum,
+        ordered ? in_order : true);
+    }
+  }
+}
+
+TEST(ordered_nested)
+{
+  // The inner maps consume their results from pool workers
+  vector<int> outer = {1, 2, 3, 4, 5, 6};
+  ParallelMap::Options inner_options = {
+    .num_workers = 4,
+    .ordered = true,
+    .reorder_window = 16,
+  };
+  vector<int> outputs;
+  for (auto r : ParallelMap::go(
+         outer, {.num_workers = 6, .ordered = true}, [&](int n) {
+           vector<int> inner;
+           for (int i = 0; i < 1000; i++) { inner.push_back(i); }
+           int last = -1;
+           bool in_order = true;
+           for (int v : ParallelMap::go(
+                  inner, inner_options, [](int v) { return v; })) {
+             in_order = in_order && v == last + 1;
+             last = v;
+           }
+           return in_order ? n : -n;
+         })) {
+    outputs.push_back(r);
+  }
+  P(outputs);
+}
+
+// Counts the live instances, to check how much of a stream is in memory
+struct Record {
+  static inline std::atomic<int> live = 0;
+  static inline std::atomic<int> peak = 0;
+
+  explicit Record(int value) : value(value) { _inc(); }
+  Record(const Record& other) : value(other.value) { _inc(); }
+  Record(Record&& other) : value(other.value) { _inc(); }
+  ~Record() { live--; }
+
+  Record& operator=(const Record& other) = default;
+  Record& operator=(Record&& other) = default;
+
+  static void reset() { peak = live.load(); }
+
+  int value;
+
+ private:
+  static void _inc()
+  {
+    int now = ++live;
+    int prev = peak.load();
+    while (now > prev && !peak.compare_exchange_weak(prev, now)) {}
+  }
+};
+
+// Generates records as it is advanced, standing in for a huge file
+struct RecordSource {
+  int position;
+
+  Record operator*() const { return Record(position); }
+  RecordSource& operator++()
+  {
+    position++;
+    return *this;
+  }
+  bool operator!=(const RecordSource& other) const
+  {
+    return position != other.position;
+  }
+};
+
+TEST(stream_from_iterators)
+{
+  for (int size : {10000, 1000000}) {
+    Record::reset();
+    int64_t sum = 0;
+    int count = 0;
+    for (auto& r : ParallelMap::stream(
+           RecordSource{0},
+           RecordSource{size},
+           {.num_workers = 4, .max_in_flight = 128},
+           [](Record&& r) { return Record(r.value * 2); })) {
+      sum += r.value;
+      count++;
+    }
+    // Inputs and outputs in the queues, in the hands of the workers and the
+    // consumer's batch, independent of the size of the stream
+    P("size:$ count:$ sum:$ peak live bounded:$",
+      size,
+      count,
+      sum,
+      Record::peak < 128 * 2 + 4 * 32 * 2 + 256 + 8);
+  }
+}
+
+TEST(stream_from_queue)
+{
+  auto source = std::make_shared<Queue<int>>(16);
+  std::thread producer([&]() {
+    for (int i = 0; i < 10000; i++) { source->push(i); }
+    source->close();
+  });
+  int64_t sum = 0;
+  for (auto r : ParallelMap::stream(
+         source, {.num_workers = 3, .max_in_flight = 16}, [](int v) {
+           return v + 1;
+         })) {
+    sum += r;
+  }
+  producer.join();
+  P("sum: $", sum);
+}
+
+TEST(stream_stopped_early)
+{
+  int count = 0;
+  {
+    auto stream = ParallelMap::stream(
+      RecordSource{0},
+      RecordSource{1000000},
+      {.num_workers = 2, .max_in_flight = 16},
+      [](Record&& r) { return r.value; });
+    for (int v : stream) {
+      if (v >= 0 && ++count == 100) { break; }
+    }
+  }
+  P("count: $ live records: $", count, Record::live.load());
+}
+
+TEST(stream_stopped_early_on_open_source)
+{
+  auto source = std::make_shared<Queue<int>>(16);
+  for (int i = 0; i < 10; i++) { source->push(i); }
+  int count = 0;
+  // The workers wait on the source, which stays open after the loop
+  for (int v : ParallelMap::stream(
+         source, {.num_workers = 2, .max_in_flight = 4}, [](int v) {
+           return v;
+         })) {
+    if (v >= 0 && ++count == 3) { break; }
+  }
+  P("count: $ source still open: $", count, source->push(10));
+  source->close();
+}
+
 } // namespace
 } // namespace bee
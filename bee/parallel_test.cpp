@@ -0,0 +1,162 @@
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "format_vector.hpp"
+#include "testing.hpp"
+
+using std::string;
+using std::vector;
+
+namespace bee {
+namespace {
+
+vector<int> random_ints(size_t size, int seed)
+{
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> dist(-1000000, 1000000);
+  vector<int> out(size);
+  for (auto& v : out) { v = dist(gen); }
+  return out;
+}
+
+TEST(parallel_for)
+{
+  auto pool = ThreadPool::create(4);
+  vector<int> hits(100000, 0);
+  parallel_for(
+    0,
+    hits.size(),
+    [&](size_t i) { hits[i]++; },
+    {.pool = pool.get(), .grain_size = 100});
+  P("all hit once: $", std::ranges::all_of(hits, [](int h) { return h == 1; }));
+
+  int calls = 0;
+  parallel_for_ranges(
+    5, 5, [&](size_t, size_t) { calls++; }, {.pool = pool.get()});
+  P("empty range calls: $", calls);
+}
+
+TEST(parallel_transform)
+{
+  auto pool = ThreadPool::create(4);
+  vector<int> in(10000);
+  for (int i = 0; i < std::ssize(in); i++) { in[i] = i; }
+  vector<string> out(in.size());
+  parallel_transform(
+    in.begin(),
+    in.end(),
+    out.begin(),
+    [](int v) { return std::to_string(v * 2); },
+    {.pool = pool.get(), .grain_size = 64});
+  P("$ $ $", out[0], out[1234], out.back());
+}
+
+TEST(parallel_reduce)
+{
+  auto pool = ThreadPool::create(4);
+  vector<int> in(1000001);
+  for (int i = 0; i < std::ssize(in); i++) { in[i] = i; }
+  ParallelOptions options = {.pool = pool.get(), .grain_size = 1000};
+  P("sum: $", parallel_reduce(in.begin(), in.end(), int64_t(0), {}, options));
+  P("max: $",
+    parallel_reduce(
+      in.begin(),
+      in.end(),
+      0,
+      [](int a, int b) { return std::max(a, b); },
+      options));
+
+  // Not commutative, the partials have to be combined in order
+  vector<string> words;
+  for (int i = 0; i < 2000; i++) { words.push_back(string(1, 'a' + i % 26)); }
+  auto joined = parallel_reduce(
+    words.begin(),
+    words.end(),
+    string(),
+    [](string a, const string& b) { return a + b; },
+    {.pool = pool.get(), .grain_size = 10});
+  string expected;
+  for (auto& w : words) { expected += w; }
+  P("concat in order: $", joined == expected);
+
+  vector<int> empty;
+  P("empty: $", parallel_reduce(empty.begin(), empty.end(), 42, {}, options));
+}
+
+TEST(parallel_sort)
+{
+  auto pool = ThreadPool::create(4);
+  for (size_t size : {0, 1, 1000, 100000, 1000003}) {
+    for (int workers : {1, 2, 3, 4, 7}) {
+      auto values = random_ints(size, size + workers);
+      auto expected = values;
+      std::sort(expected.begin(), expected.end());
+      parallel_sort(
+        values,
+        std::less<>(),
+        {.pool = pool.get(), .num_workers = workers, .grain_size = 100});
+      if (values != expected) { P("size:$ workers:$ mismatch", size, workers); }
+    }
+  }
+  auto values = random_ints(100000, 1);
+  parallel_sort(values, std::greater<>(), {.pool = pool.get()});
+  P("descending: $", std::ranges::is_sorted(values, std::greater<>()));
+  P("done");
+}
+
+TEST(exceptions)
+{
+  auto pool = ThreadPool::create(4);
+  std::atomic<int> calls = 0;
+  try {
+    parallel_for(
+      0,
+      100000,
+      [&](size_t i) {
+        calls++;
+        if (i % 1000 == 999) { throw std::runtime_error("oops"); }
+      },
+      {.pool = pool.get(), .grain_size = 100});
+  } catch (const std::runtime_error& e) {
+    P("caught: $", e.what());
+  }
+  P("stopped early: $", calls.load() < 100000);
+
+  vector<int> values = random_ints(100000, 3);
+  try {
+    parallel_sort(
+      values,
+      [](int a, int b) {
+        if (a == b) { throw std::runtime_error("duplicate"); }
+        return a < b;
+      },
+      {.pool = pool.get(), .grain_size = 1000});
+  } catch (const std::runtime_error& e) {
+    P("caught: $", e.what());
+  }
+}
+
+TEST(nested)
+{
+  auto pool = ThreadPool::create(2);
+  vector<int64_t> sums(8);
+  ParallelOptions options = {.pool = pool.get(), .grain_size = 1};
+  parallel_for(
+    0,
+    sums.size(),
+    [&](size_t i) {
+      vector<int> in(10000, i);
+      sums[i] = parallel_reduce(in.begin(), in.end(), int64_t(0), {}, options);
+    },
+    options);
+  P(sums);
+}
+
+} // namespace
+} // namespace bee
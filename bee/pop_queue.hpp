@@ -1,11 +1,12 @@
 #pragma once
 
-#include <condition_variable>
-#include <list>
+#include <algorithm>
+#include <atomic>
 #include <memory>
-#include <mutex>
 #include <optional>
-#include <variant>
+#include <span>
+#include <utility>
+#include <vector>
 
 #include "span.hpp"
 
@@ -59,6 +60,26 @@ template <std::move_constructible T> struct PopQueue {
     return std::move(_queue[idx]);
   }
 
+  // Claims up to max_n consecutive elements with a single atomic add. Returns
+  // the index of the first one along with the elements, which the caller may
+  // move from. The span is empty once everything was claimed.
+  std::pair<size_t, std::span<T>> pop_range(size_t max_n)
+  {
+    size_t idx = _head.fetch_add(max_n);
+    if (idx >= _queue.size()) return {_queue.size(), {}};
+    size_t n = std::min(max_n, _queue.size() - idx);
+    return {idx, std::span<T>(_queue.data() + idx, n)};
+  }
+
+  size_t size() const { return _queue.size(); }
+
+  // Not claimed yet, only an estimate while other threads pop
+  size_t remaining() const
+  {
+    size_t head = _head.load(std::memory_order_relaxed);
+    return head >= _queue.size() ? 0 : _queue.size() - head;
+  }
+
   Iterator begin() { return Iterator(this); }
   EndIterator end() { return EndIterator(); }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <type_traits>
 
 #include "format.hpp"
 #include "location.hpp"
@@ -13,21 +14,30 @@ namespace details {
 
 void print_file_str(LogOutput out, const std::string& str);
 
-inline void print_file_line(
-  LogOutput out, const Location&, const std::string& str)
+template <format_details::lone_arg T>
+void print_file_line(LogOutput out, const Location& loc, T&& v)
 {
-  print_file_str(out, str);
+  if constexpr (std::is_same_v<std::decay_t<T>, std::string>) {
+    print_file_str(out, v);
+  } else {
+    print_file_str(out, bee::format_details::format(loc, std::forward<T>(v)));
+  }
 }
 
-template <stringable T>
-void print_file_line(LogOutput out, const Location& loc, T&& v)
+template <stringable... Ts>
+void print_file_line(
+  LogOutput out,
+  const Location& loc,
+  const FormatString<sizeof...(Ts)>& fmt,
+  Ts&&... args)
 {
-  print_file_str(out, bee::format_details::format(loc, std::forward<T>(v)));
+  print_file_str(
+    out, bee::format_details::format(loc, fmt, std::forward<Ts>(args)...));
 }
 
 template <stringable... Ts>
 void print_file_line(
-  LogOutput out, const Location& loc, const char* fmt, Ts&&... args)
+  LogOutput out, const Location& loc, RuntimeFormat fmt, Ts&&... args)
 {
   print_file_str(
     out, bee::format_details::format(loc, fmt, std::forward<Ts>(args)...));
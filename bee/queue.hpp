@@ -1,11 +1,17 @@
 #pragma once
 
+#include <algorithm>
 #include <condition_variable>
-#include <list>
+#include <deque>
+#include <iterator>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <ranges>
+#include <span>
+#include <stop_token>
 #include <variant>
+#include <vector>
 
 #include "span.hpp"
 
@@ -97,6 +103,48 @@ template <std::move_constructible T> struct Queue {
     }
   }
 
+  // Blocks until at least one value is available, then moves up to max_n of
+  // them to the back of out under a single lock. Returns how many were popped,
+  // zero only if the queue is closed and empty.
+  size_t pop_many(std::vector<T>& out, size_t max_n)
+  {
+    auto lk = lock();
+    _wait_readable(lk);
+    return _pop_many_no_lock(out, max_n);
+  }
+
+  // Same, but also returns zero once stop is requested, which wakes it up
+  // without the queue being closed
+  size_t pop_many(std::vector<T>& out, size_t max_n, std::stop_token stop)
+  {
+    std::stop_callback wake(stop, [this] {
+      auto lk = lock();
+      _read_cv.notify_all();
+    });
+    auto lk = lock();
+    if (!_is_readable() && !stop.stop_requested()) {
+      _waiting_readers++;
+      _read_cv.wait(
+        lk, [&] { return _is_readable() || stop.stop_requested(); });
+      _waiting_readers--;
+    }
+    if (stop.stop_requested()) { return 0; }
+    return _pop_many_no_lock(out, max_n);
+  }
+
+  size_t pop_many_non_blocking(std::vector<T>& out, size_t max_n)
+  {
+    auto lk = lock();
+    return _pop_many_no_lock(out, max_n);
+  }
+
+  std::vector<T> pop_many(size_t max_n)
+  {
+    std::vector<T> out;
+    pop_many(out, max_n);
+    return out;
+  }
+
   bool wait_available()
   {
     auto lk = lock();
@@ -115,10 +163,43 @@ template <std::move_constructible T> struct Queue {
     _wait_writable(lk);
     if (_closed) { return false; }
     _queue.emplace_back(std::forward<U>(args)...);
-    _read_cv.notify_one();
+    _notify_readers(1);
     return true;
   }
 
+  // Pushes every element of the range, taking the lock once per batch that
+  // fits in the queue instead of once per element. Returns how many elements
+  // were pushed, which is less than the size of the range only if the queue
+  // got closed.
+  template <std::ranges::input_range R>
+  size_t push_range(R&& range)
+    requires std::constructible_from<T, std::ranges::range_reference_t<R>>
+  {
+    auto it = std::ranges::begin(range);
+    auto end = std::ranges::end(range);
+    size_t pushed = 0;
+    auto lk = lock();
+    while (it != end) {
+      _wait_writable(lk);
+      if (_closed) { break; }
+      size_t batch = 0;
+      for (; it != end && !_is_full(); ++it, ++batch) {
+        _queue.emplace_back(*it);
+      }
+      _notify_readers(batch);
+      pushed += batch;
+    }
+    return pushed;
+  }
+
+  // Moves the values out of the span
+  size_t push_many(std::span<T> values)
+  {
+    return push_range(std::ranges::subrange(
+      std::make_move_iterator(values.begin()),
+      std::make_move_iterator(values.end())));
+  }
+
   void close()
   {
     auto lk = lock();
@@ -148,35 +229,78 @@ template <std::move_constructible T> struct Queue {
     if (_queue.empty()) { return std::nullopt; }
     auto ret = std::move(_queue.front());
     _queue.pop_front();
-    _write_cv.notify_one();
+    _notify_writers(1);
     return ret;
   }
 
+  size_t _pop_many_no_lock(std::vector<T>& out, size_t max_n)
+  {
+    size_t n = std::min(max_n, _queue.size());
+    out.insert(
+      out.end(),
+      std::make_move_iterator(_queue.begin()),
+      std::make_move_iterator(_queue.begin() + n));
+    _queue.erase(_queue.begin(), _queue.begin() + n);
+    _notify_writers(n);
+    return n;
+  }
+
   bool _is_readable() const { return !_queue.empty() || _closed; }
 
+  bool _is_full() const
+  {
+    return _max_size.has_value() && std::ssize(_queue) >= *_max_size;
+  }
+
+  // Only signal threads that are actually blocked, and no more of them than
+  // there are new values or free slots for
+  static void _notify(
+    std::condition_variable& cv, int waiting, size_t available)
+  {
+    if (waiting == 0 || available == 0) { return; }
+    if (available == 1) {
+      cv.notify_one();
+    } else {
+      cv.notify_all();
+    }
+  }
+
+  void _notify_readers(size_t n) { _notify(_read_cv, _waiting_readers, n); }
+
+  void _notify_writers(size_t n) { _notify(_write_cv, _waiting_writers, n); }
+
   void _wait_readable(ul& lk)
   {
+    if (_is_readable()) { return; }
+    _waiting_readers++;
     _read_cv.wait(lk, [this] { return _is_readable(); });
+    _waiting_readers--;
   }
 
   void _wait_readable_with_timeout(ul& lk, Span timeout)
   {
+    if (_is_readable()) { return; }
+    _waiting_readers++;
     _read_cv.wait_for(
       lk, timeout.to_chrono(), [this] { return _is_readable(); });
+    _waiting_readers--;
   }
 
   void _wait_writable(ul& lk)
   {
-    if (!_max_size.has_value()) { return; }
-    _write_cv.wait(
-      lk, [this] { return std::ssize(_queue) < *_max_size || _closed; });
+    if (!_is_full() || _closed) { return; }
+    _waiting_writers++;
+    _write_cv.wait(lk, [this] { return !_is_full() || _closed; });
+    _waiting_writers--;
   }
 
   std::optional<int> _max_size;
   std::condition_variable _read_cv;
   std::condition_variable _write_cv;
   mutable std::mutex _mutex;
-  std::list<T> _queue;
+  std::deque<T> _queue;
+  int _waiting_readers = 0;
+  int _waiting_writers = 0;
   bool _closed = false;
 };
 
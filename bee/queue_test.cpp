@@ -0,0 +1,87 @@
+#include "queue.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "format_vector.hpp"
+#include "testing.hpp"
+
+using std::string;
+using std::vector;
+
+namespace bee {
+namespace {
+
+TEST(push_pop)
+{
+  Queue<int> queue;
+  for (int i = 0; i < 3; i++) { queue.push(i); }
+  P(*queue.pop());
+  P(*queue.pop_non_blocking());
+  P(*queue.pop_with_timeout(Span::of_millis(10)));
+  P("timed out: $", queue.pop_with_timeout(Span::of_millis(10)).timed_out());
+}
+
+TEST(push_many)
+{
+  Queue<string> queue;
+  vector<string> values = {"a", "b", "c"};
+  P("pushed: $", queue.push_many(values));
+  P("moved from: $", values[0].empty());
+  P("pushed: $", queue.push_range(vector<string>{"d", "e"}));
+  P(queue.pop_many(2));
+  P(queue.pop_many(10));
+}
+
+TEST(pop_many_appends)
+{
+  Queue<int> queue;
+  P("pushed: $", queue.push_range(vector<int>{1, 2, 3}));
+  vector<int> out = {0};
+  P("popped: $", queue.pop_many(out, 2));
+  P(out);
+  queue.close();
+  P("popped: $", queue.pop_many(out, 2));
+  P("popped: $", queue.pop_many(out, 2));
+  P(out);
+}
+
+TEST(pop_many_stopped)
+{
+  Queue<int> queue;
+  std::stop_source stop;
+  vector<int> out;
+  std::thread consumer(
+    [&] { P("popped: $", queue.pop_many(out, 2, stop.get_token())); });
+  Span::of_millis(10).sleep();
+  stop.request_stop();
+  consumer.join();
+  P("closed: $", queue.is_closed_and_empty());
+  P("pushed: $", queue.push(1));
+  P("popped after stop: $", queue.pop_many(out, 2, stop.get_token()));
+}
+
+TEST(push_range_bounded)
+{
+  auto queue = std::make_shared<Queue<int>>(4);
+  vector<int> received;
+  std::thread consumer([&] {
+    while (true) {
+      auto batch = queue->pop_many(3);
+      if (batch.empty()) { break; }
+      assert(batch.size() <= 4);
+      received.insert(received.end(), batch.begin(), batch.end());
+    }
+  });
+  vector<int> values;
+  for (int i = 0; i < 20; i++) { values.push_back(i); }
+  P("pushed: $", queue->push_many(values));
+  queue->close();
+  consumer.join();
+  P(received);
+  P("push after close: $", queue->push_range(values));
+}
+
+} // namespace
+} // namespace bee
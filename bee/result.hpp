@@ -1,7 +1,6 @@
 #pragma once
 
 #include <concepts>
-#include <tuple>
 #include <type_traits>
 #include <variant>
 
@@ -258,23 +257,21 @@ template <class T, class E> struct [[nodiscard]] Result {
 
 namespace details {
 
-template <class T, class Args>
-void maybe_add_location(Result<T, Error>& e, Location&& loc, Args&& args)
+// The message is built by a lambda so the format string is still a literal
+// where it is parsed, and so it is only formatted on errors
+template <class T, class Msg>
+void maybe_add_location(Result<T, Error>& e, Location&& loc, Msg&& msg)
 {
-  std::apply(
-    [&]<class... A>(A&&... a) {
-      e.unchecked_error().add_tag_with_location(
-        std::move(loc), bee::maybe_format(std::forward<A>(a)...));
-    },
-    std::forward<Args>(args));
+  e.unchecked_error().add_tag_with_location(std::move(loc), msg());
 }
 
-template <class T, class E, class Args>
+template <class T, class E, class Msg>
   requires(!std::same_as<E, Error>)
-void maybe_add_location(Result<T, E>&, Location&&, Args&&)
+void maybe_add_location(Result<T, E>&, Location&&, Msg&&)
 {
+  // Only maybe_format() without arguments returns a const char*
   static_assert(
-    std::tuple_size_v<Args> == 0,
+    std::is_same_v<std::invoke_result_t<Msg>, const char*>,
     "Cannot add tag with when error type is not Error");
 }
 
@@ -284,7 +281,7 @@ void maybe_add_location(Result<T, E>&, Location&&, Args&&)
   auto __var##var = (or_error);                                                \
   if ((__var##var).is_error()) [[unlikely]] {                                  \
     bee::details::maybe_add_location(                                          \
-      __var##var, HERE, std::forward_as_tuple(msg));                           \
+      __var##var, HERE, [&] { return bee::maybe_format(msg); });               \
     return std::move(__var##var).unchecked_error();                            \
   }                                                                            \
   auto& var = (__var##var).value()
@@ -294,7 +291,7 @@ void maybe_add_location(Result<T, E>&, Location&&, Args&&)
     auto __var = (or_error);                                                   \
     if (__var.is_error()) [[unlikely]] {                                       \
       bee::details::maybe_add_location(                                        \
-        __var, HERE, std::forward_as_tuple(msg));                              \
+        __var, HERE, [&] { return bee::maybe_format(msg); });                  \
       return __var.unchecked_error();                                          \
     }                                                                          \
     var = std::move(__var).value();                                            \
@@ -305,7 +302,7 @@ void maybe_add_location(Result<T, E>&, Location&&, Args&&)
     auto __var = (or_error);                                                   \
     if (__var.is_error()) [[unlikely]] {                                       \
       bee::details::maybe_add_location(                                        \
-        __var, HERE, std::forward_as_tuple(msg));                              \
+        __var, HERE, [&] { return bee::maybe_format(msg); });                  \
       return std::move(__var).unchecked_error();                               \
     }                                                                          \
   } while (false)
@@ -314,7 +311,7 @@ void maybe_add_location(Result<T, E>&, Location&&, Args&&)
   auto __var##var = (or_error);                                                \
   if ((__var##var).is_error()) [[unlikely]] {                                  \
     bee::details::maybe_add_location(                                          \
-      __var##var, HERE, std::forward_as_tuple(msg));                           \
+      __var##var, HERE, [&] { return bee::maybe_format(msg); });               \
     (__var##var).unchecked_error().raise();                                    \
   }                                                                            \
   auto& var = (__var##var).value()
@@ -324,7 +321,7 @@ void maybe_add_location(Result<T, E>&, Location&&, Args&&)
     auto __var = (or_error);                                                   \
     if (__var.is_error()) [[unlikely]] {                                       \
       bee::details::maybe_add_location(                                        \
-        __var, HERE, std::forward_as_tuple(msg));                              \
+        __var, HERE, [&] { return bee::maybe_format(msg); });                  \
       (__var).unchecked_error().raise();                                       \
     }                                                                          \
     var = std::move(__var).value();                                            \
@@ -335,7 +332,7 @@ void maybe_add_location(Result<T, E>&, Location&&, Args&&)
     auto __var = (or_error);                                                   \
     if (__var.is_error()) [[unlikely]] {                                       \
       bee::details::maybe_add_location(                                        \
-        __var, HERE, std::forward_as_tuple(msg));                              \
+        __var, HERE, [&] { return bee::maybe_format(msg); });                  \
       __var.unchecked_error().raise();                                         \
     }                                                                          \
   } while (false)
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+
+#include "futex.hpp"
+#include "queue.hpp"
+#include "span.hpp"
+#include "time.hpp"
+
+namespace bee {
+
+// Bounded multi producer multi consumer queue over a fixed power of two ring.
+// Every slot carries a sequence number that tells producers and consumers
+// whether it is free for the current lap, so a push or pop is a single compare
+// and swap on the tail or head, without any lock. Threads that find the queue
+// full or empty spin for a little while and then park on a futex. Same
+// interface as Queue, which it can replace when the queue doesn't need to be
+// unbounded.
+template <std::move_constructible T> struct RingQueue {
+ public:
+  using ptr = std::shared_ptr<RingQueue>;
+
+  using TimedOut = typename Queue<T>::TimedOut;
+  using QueueClosed = typename Queue<T>::QueueClosed;
+  using GetResult = typename Queue<T>::GetResult;
+
+  static constexpr size_t DefaultCapacity = 1024;
+
+  struct EndIterator {};
+
+  struct Iterator {
+   public:
+    Iterator(RingQueue<T>* queue) : _queue(queue), _value(_queue->pop()) {}
+
+    T& operator*() { return *_value; }
+
+    Iterator& operator++()
+    {
+      _value = _queue->pop();
+      return *this;
+    }
+
+    bool operator==(const EndIterator&) const { return ended(); }
+
+    bool ended() const { return !_value.has_value(); }
+
+   private:
+    RingQueue<T>* _queue;
+    std::optional<T> _value;
+  };
+
+  static ptr create(size_t capacity = DefaultCapacity)
+  {
+    return std::make_shared<RingQueue>(capacity);
+  }
+
+  // The capacity is rounded up to a power of two
+  explicit RingQueue(size_t capacity = DefaultCapacity)
+      : _mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        _slots(new Slot[_mask + 1])
+  {
+    for (size_t i = 0; i <= _mask; i++) {
+      _slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~RingQueue()
+  {
+    size_t tail = _tail.load() & ~ClosedBit;
+    for (size_t pos = _head.load(); pos != tail; pos++) {
+      auto& slot = _slots[pos & _mask];
+      if (slot.seq.load() == pos + 1) { slot.value()->~T(); }
+    }
+  }
+
+  RingQueue(const RingQueue& other) = delete;
+  RingQueue(RingQueue&& other) = delete;
+
+  RingQueue& operator=(RingQueue&& other) = delete;
+
+  size_t capacity() const { return _mask + 1; }
+
+  std::optional<T> pop_non_blocking()
+  {
+    std::optional<T> out;
+    _try_pop(out);
+    return out;
+  }
+
+  std::optional<T> pop()
+  {
+    std::optional<T> out;
+    _pop_until(out, std::nullopt);
+    return out;
+  }
+
+  GetResult pop_with_timeout(Span timeout)
+  {
+    std::optional<T> out;
+    switch (_pop_until(out, Time::monotonic() + timeout)) {
+    case State::Ok:
+      return std::move(*out);
+    case State::Closed:
+      return QueueClosed{};
+    case State::Unavailable:
+      break;
+    }
+    return TimedOut{};
+  }
+
+  bool wait_available()
+  {
+    return _wait(_push_epoch, std::nullopt, [this] {
+      return _is_readable();
+    }) && !_is_empty();
+  }
+
+  bool push(T&& value) { return emplace(std::move(value)); }
+  bool push(const T& value) { return emplace(value); }
+
+  // Blocks while the queue is full, returns false if the queue is closed
+  template <class... U>
+  bool emplace(U&&... args)
+    requires std::constructible_from<T, U...>
+  {
+    State state = _try_emplace(std::forward<U>(args)...);
+    if (state != State::Unavailable) { return state == State::Ok; }
+    _wait(_pop_epoch, std::nullopt, [&] {
+      state = _try_emplace(std::forward<U>(args)...);
+      return state != State::Unavailable;
+    });
+    return state == State::Ok;
+  }
+
+  void close()
+  {
+    size_t tail = _tail.fetch_or(ClosedBit);
+    if (tail & ClosedBit) { return; }
+    _notify(_push_epoch);
+    _notify(_pop_epoch);
+  }
+
+  bool is_closed_and_empty() const
+  {
+    size_t tail = _tail.load();
+    return (tail & ClosedBit) && _head.load() == (tail & ~ClosedBit);
+  }
+
+  Iterator begin() { return Iterator(this); }
+
+  EndIterator end() { return EndIterator(); }
+
+ private:
+  // Producers only ever increment the tail, so the top bit is free to close
+  // the queue atomically with respect to them
+  static constexpr size_t ClosedBit = size_t(1) << (sizeof(size_t) * 8 - 1);
+
+  // Spinning only helps if the thread that will make progress is running on
+  // another core
+  static int _spin_count()
+  {
+    static const int count = std::thread::hardware_concurrency() > 1 ? 128 : 0;
+    return count;
+  }
+
+  // Not std::hardware_destructive_interference_size, its value is not stable
+  // across compiler flags
+  static constexpr size_t CacheLine = 64;
+
+  enum class State {
+    Ok,
+    // Full for producers, empty for consumers
+    Unavailable,
+    Closed,
+  };
+
+  struct Slot {
+    // pos when free for the producer at pos, pos + 1 once it holds the value
+    // for the consumer at pos
+    std::atomic<size_t> seq;
+    alignas(T) std::byte storage[sizeof(T)];
+
+    T* value() { return std::launder(reinterpret_cast<T*>(storage)); }
+  };
+
+  template <class... U> State _try_emplace(U&&... args)
+  {
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      if (pos & ClosedBit) { return State::Closed; }
+      slot = &_slots[pos & _mask];
+      size_t seq = slot->seq.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return State::Unavailable;
+      } else {
+        pos = _tail.load(std::memory_order_relaxed);
+      }
+    }
+    new (slot->storage) T(std::forward<U>(args)...);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    _notify(_push_epoch);
+    return State::Ok;
+  }
+
+  State _try_pop(std::optional<T>& out)
+  {
+    size_t pos = _head.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &_slots[pos & _mask];
+      size_t seq = slot->seq.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // Either empty or the producer of this slot hasn't finished writing
+        // it yet, only the former is final once closed
+        size_t tail = _tail.load(std::memory_order_acquire);
+        if ((tail & ClosedBit) && pos == (tail & ~ClosedBit)) {
+          return State::Closed;
+        }
+        return State::Unavailable;
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+    T* value = slot->value();
+    out.emplace(std::move(*value));
+    value->~T();
+    slot->seq.store(pos + _mask + 1, std::memory_order_release);
+    _notify(_pop_epoch);
+    return State::Ok;
+  }
+
+  State _pop_until(std::optional<T>& out, std::optional<Time> deadline)
+  {
+    State state = _try_pop(out);
+    if (state != State::Unavailable) { return state; }
+    _wait(_push_epoch, deadline, [&] {
+      state = _try_pop(out);
+      return state != State::Unavailable;
+    });
+    return state;
+  }
+
+  bool _is_empty() const
+  {
+    size_t head = _head.load();
+    auto& slot = _slots[head & _mask];
+    return slot.seq.load(std::memory_order_acquire) != head + 1;
+  }
+
+  bool _is_readable() const
+  {
+    return !_is_empty() || (_tail.load() & ClosedBit);
+  }
+
+  // The low bit of an epoch is set while some thread is parked on it. Waking
+  // clears it, so a producer racing ahead of a woken consumer that hasn't run
+  // yet doesn't pay for a syscall on every push. The fence pairs with the one
+  // in _wait: either the waiter sees the slot that was just published, or this
+  // sees the waiter's bit.
+  static void _notify(std::atomic<uint32_t>& epoch)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t current = epoch.load(std::memory_order_relaxed);
+    if ((current & 1) == 0) { return; }
+    // Only wakers clear the bit, if this fails another one woke everyone
+    if (epoch.compare_exchange_strong(current, current + 1)) {
+      Futex::wake_all(epoch);
+    }
+  }
+
+  // Returns false if the deadline passed before ready returned true
+  template <class F>
+  static bool _wait(
+    std::atomic<uint32_t>& epoch, std::optional<Time> deadline, F&& ready)
+  {
+    for (int i = 0, n = _spin_count(); i < n; i++) {
+      if (ready()) { return true; }
+      Futex::cpu_relax();
+    }
+    while (true) {
+      uint32_t current = epoch.load();
+      if ((current & 1) == 0) {
+        if (!epoch.compare_exchange_weak(current, current + 1)) { continue; }
+        current++;
+      }
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready()) { return true; }
+      std::optional<Span> timeout;
+      if (deadline.has_value()) {
+        timeout = *deadline - Time::monotonic();
+        if (*timeout <= Span::zero()) { return false; }
+      }
+      Futex::wait(epoch, current, timeout);
+    }
+  }
+
+  const size_t _mask;
+  std::unique_ptr<Slot[]> _slots;
+
+  alignas(CacheLine) std::atomic<size_t> _head = 0;
+  alignas(CacheLine) std::atomic<size_t> _tail = 0;
+
+  // Parked consumers sleep on pushes, parked producers on pops
+  alignas(CacheLine) std::atomic<uint32_t> _push_epoch = 0;
+  alignas(CacheLine) std::atomic<uint32_t> _pop_epoch = 0;
+};
+
+} // namespace bee
@@ -0,0 +1,137 @@
+#include "ring_queue.hpp"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "format_vector.hpp"
+#include "testing.hpp"
+
+using std::string;
+using std::vector;
+
+namespace bee {
+namespace {
+
+TEST(basic)
+{
+  RingQueue<int> queue(5);
+  P("capacity: $", queue.capacity());
+  for (int i = 0; i < 8; i++) { queue.push(i); }
+  vector<int> popped;
+  while (auto v = queue.pop_non_blocking()) { popped.push_back(*v); }
+  P(popped);
+  P("empty pop: $", queue.pop_non_blocking().has_value());
+}
+
+TEST(wraps_around)
+{
+  RingQueue<string> queue(4);
+  int64_t sum = 0;
+  for (int i = 0; i < 1000; i++) {
+    queue.push(F(i));
+    queue.push(F(i + 1));
+    sum += std::stoi(*queue.pop());
+    sum += std::stoi(*queue.pop());
+  }
+  P("sum: $", sum);
+}
+
+TEST(timeout)
+{
+  RingQueue<int> queue(4);
+  auto ret = queue.pop_with_timeout(Span::of_millis(10));
+  P("timed out: $", ret.timed_out());
+  queue.push(42);
+  auto ret2 = queue.pop_with_timeout(Span::of_millis(10));
+  P("value: $", *ret2);
+  queue.close();
+  auto ret3 = queue.pop_with_timeout(Span::of_millis(10));
+  P("closed: $", ret3.closed());
+}
+
+TEST(close)
+{
+  RingQueue<std::unique_ptr<int>> queue(4);
+  queue.push(std::make_unique<int>(1));
+  queue.push(std::make_unique<int>(2));
+  queue.close();
+  P("push after close: $", queue.push(std::make_unique<int>(3)));
+  P("closed and empty: $", queue.is_closed_and_empty());
+  for (auto& v : queue) { P(*v); }
+  P("closed and empty: $", queue.is_closed_and_empty());
+}
+
+TEST(close_wakes_up_waiters)
+{
+  auto queue = RingQueue<int>::create(2);
+  queue->push(1);
+  queue->push(2);
+  std::thread producer([&] { P("blocked push: $", queue->push(3)); });
+  Span::of_millis(20).sleep();
+  queue->close();
+  producer.join();
+
+  std::thread consumer([&] {
+    int count = 0;
+    for (int v : *queue) { count += v; }
+    P("drained: $", count);
+  });
+  consumer.join();
+}
+
+TEST(destructor_frees_elements)
+{
+  auto counter = std::make_shared<int>(0);
+  {
+    RingQueue<std::shared_ptr<int>> queue(8);
+    for (int i = 0; i < 5; i++) { queue.push(counter); }
+    queue.pop();
+    P("use count: $", counter.use_count());
+  }
+  P("use count: $", counter.use_count());
+}
+
+TEST(many_producers_many_consumers)
+{
+  constexpr int num_producers = 4;
+  constexpr int num_consumers = 4;
+  constexpr int per_producer = 100000;
+  auto queue = RingQueue<int>::create(64);
+
+  vector<std::thread> producers;
+  for (int p = 0; p < num_producers; p++) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < per_producer; i++) {
+        queue->push(p * per_producer + i);
+      }
+    });
+  }
+  vector<int64_t> sums(num_consumers);
+  vector<int> counts(num_consumers);
+  vector<std::thread> consumers;
+  for (int c = 0; c < num_consumers; c++) {
+    consumers.emplace_back([&, c] {
+      for (int v : *queue) {
+        sums[c] += v;
+        counts[c]++;
+      }
+    });
+  }
+  for (auto& t : producers) { t.join(); }
+  queue->close();
+  for (auto& t : consumers) { t.join(); }
+
+  int64_t sum = 0;
+  int count = 0;
+  for (int c = 0; c < num_consumers; c++) {
+    sum += sums[c];
+    count += counts[c];
+  }
+  int64_t n = num_producers * per_producer;
+  P("count: $ sum matches: $", count, sum == n * (n - 1) / 2);
+}
+
+} // namespace
+} // namespace bee
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <memory>
 #include <random>
 #include <vector>
 
 namespace bee {
 
+// Uniform sample of a stream, reservoir sampling with Algorithm L: once the
+// reservoir is full the number of elements to skip before the next one is
+// taken is drawn directly, so the elements skipped cost a counter increment
+// and the work is O(k * (1 + log(n / k))) random draws for n elements.
 template <class T> struct Sampler {
  public:
   Sampler(int num_samples, uint32_t seed)
@@ -17,9 +24,34 @@ template <class T> struct Sampler {
     _seem_elements++;
     if (int(_sample.size()) < _num_samples) {
       _sample.push_back(std::forward<U>(item));
-    } else {
-      int r = _rand_int(_seem_elements);
-      if (r < _num_samples) { _sample.at(r) = std::forward<U>(item); }
+      if (int(_sample.size()) == _num_samples) { _start_skipping(); }
+    } else if (_seem_elements == _next_taken) {
+      _sample[_rand_int(_num_samples)] = std::forward<U>(item);
+      _w *= std::exp(std::log(_rand_unit()) / _num_samples);
+      _skip();
+    }
+  }
+
+  // Same as calling maybe_add on every element, but jumps over the elements
+  // that are skipped
+  template <std::random_access_iterator It> void add_range(It begin, It end)
+  {
+    if (_num_samples <= 0) {
+      _seem_elements += end - begin;
+      return;
+    }
+    while (begin != end && int(_sample.size()) < _num_samples) {
+      maybe_add(*begin++);
+    }
+    while (begin != end) {
+      int64_t until_taken = _next_taken - _seem_elements - 1;
+      if (until_taken >= end - begin) {
+        _seem_elements += end - begin;
+        return;
+      }
+      begin += until_taken;
+      _seem_elements += until_taken;
+      maybe_add(*begin++);
     }
   }
 
@@ -33,9 +65,34 @@ template <class T> struct Sampler {
     return dist(_rng);
   }
 
+  // Uniform in (0, 1)
+  double _rand_unit()
+  {
+    return 1.0 - std::generate_canonical<double, 53>(_rng);
+  }
+
+  void _start_skipping()
+  {
+    _w = std::exp(std::log(_rand_unit()) / _num_samples);
+    _next_taken = _seem_elements;
+    _skip();
+  }
+
+  // Draws how many elements go by before the next one is taken. _w is the
+  // largest of the random keys of the elements in the reservoir.
+  void _skip()
+  {
+    double skipped = std::floor(std::log(_rand_unit()) / std::log1p(-_w));
+    _next_taken += int64_t(std::min(skipped, 1e18)) + 1;
+  }
+
   std::vector<T> _sample;
   const int _num_samples;
-  int _seem_elements = 0;
+  int64_t _seem_elements = 0;
+
+  // Algorithm L state, the element count at which the next element is taken
+  double _w = 1.0;
+  int64_t _next_taken = 0;
 
   std::mt19937_64 _rng;
 };
@@ -0,0 +1,71 @@
+#include "sampler.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "testing.hpp"
+
+using std::vector;
+
+namespace bee {
+namespace {
+
+TEST(fills_reservoir_first)
+{
+  Sampler<int> sampler(5, 1);
+  for (int i = 0; i < 3; i++) { sampler.maybe_add(i); }
+  P("size: $", sampler.sample().size());
+  for (int i = 3; i < 1000; i++) { sampler.maybe_add(i); }
+  P("size: $", sampler.sample().size());
+}
+
+// Each of n elements should end up in the sample with probability k / n
+void check_uniform(bool use_range)
+{
+  constexpr int n = 1000;
+  constexpr int k = 10;
+  constexpr int rounds = 20000;
+  vector<int> input(n);
+  std::iota(input.begin(), input.end(), 0);
+  vector<int> hits(n, 0);
+  for (int round = 0; round < rounds; round++) {
+    Sampler<int> sampler(k, round);
+    if (use_range) {
+      sampler.add_range(input.begin(), input.end());
+    } else {
+      for (int v : input) { sampler.maybe_add(v); }
+    }
+    for (int v : sampler.sample()) { hits[v]++; }
+  }
+  // Expected 200 hits per element, with a standard deviation of about 14
+  double chi_square = 0;
+  for (int h : hits) { chi_square += (h - 200.0) * (h - 200.0) / 200.0; }
+  auto [min, max] = std::minmax_element(hits.begin(), hits.end());
+  P("range:$ min>=140:$ max<=260:$ chi_square<1150:$",
+    use_range,
+    *min >= 140,
+    *max <= 260,
+    chi_square < 1150);
+}
+
+TEST(uniform)
+{
+  check_uniform(false);
+  check_uniform(true);
+}
+
+TEST(range_matches_one_by_one)
+{
+  vector<int> input(100000);
+  std::iota(input.begin(), input.end(), 0);
+  Sampler<int> one_by_one(20, 3);
+  for (int v : input) { one_by_one.maybe_add(v); }
+  Sampler<int> range(20, 3);
+  range.add_range(input.begin(), input.begin() + 5);
+  range.add_range(input.begin() + 5, input.end());
+  P("same sample: $", one_by_one.sample() == range.sample());
+}
+
+} // namespace
+} // namespace bee
@@ -1,32 +1,370 @@
 #include "simple_timer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+#include <map>
+
+#include "cycle_clock.hpp"
+#include "format.hpp"
 #include "print.hpp"
+#include "string_util.hpp"
+#include "trace.hpp"
 
 namespace bee {
 
+////////////////////////////////////////////////////////////////////////////////
+// ThreadState
+//
+
+namespace {
+
+constexpr uint32_t Nil = std::numeric_limits<uint32_t>::max();
+constexpr int NumBuckets = 64;
+constexpr int64_t NoMin = std::numeric_limits<int64_t>::max();
+
+// Written only by the thread owning it, so updates are a plain load and store,
+// and read by reports from any thread
+struct Counter {
+ public:
+  Counter(int64_t initial = 0) : _value(initial) {}
+
+  int64_t load() const { return _value.load(std::memory_order_relaxed); }
+  void store(int64_t value) { _value.store(value, std::memory_order_relaxed); }
+  void add(int64_t value) { store(load() + value); }
+
+ private:
+  std::atomic<int64_t> _value;
+};
+
+// Bucket i holds durations of [2^(i-1), 2^i) ticks
+int bucket_of(int64_t ticks) { return std::bit_width(uint64_t(ticks)); }
+
+} // namespace
+
+struct SimpleTimer::ThreadState {
+ public:
+  struct Node {
+    uint32_t timer = Nil;
+    uint32_t parent = Nil;
+
+    // Only used by the owning thread
+    uint32_t first_child = Nil;
+    uint32_t next_sibling = Nil;
+
+    // Whether it is under a node of the same timer, its time is then already
+    // part of that one
+    bool nested = false;
+
+    Counter count;
+    Counter total_ticks;
+    Counter child_ticks;
+    Counter min_ticks = NoMin;
+    Counter max_ticks;
+    std::array<Counter, NumBuckets> buckets;
+
+    void record(int64_t ticks)
+    {
+      // The TSCs of different cores can be slightly off
+      ticks = std::max<int64_t>(ticks, 0);
+      count.add(1);
+      total_ticks.add(ticks);
+      if (ticks < min_ticks.load()) { min_ticks.store(ticks); }
+      if (ticks > max_ticks.load()) { max_ticks.store(ticks); }
+      buckets[bucket_of(ticks)].add(1);
+    }
+
+    void reset()
+    {
+      count.store(0);
+      total_ticks.store(0);
+      child_ticks.store(0);
+      min_ticks.store(NoMin);
+      max_ticks.store(0);
+      for (auto& bucket : buckets) { bucket.store(0); }
+    }
+
+    void add(const Node& other)
+    {
+      count.add(other.count.load());
+      total_ticks.add(other.total_ticks.load());
+      child_ticks.add(other.child_ticks.load());
+      min_ticks.store(std::min(min_ticks.load(), other.min_ticks.load()));
+      max_ticks.store(std::max(max_ticks.load(), other.max_ticks.load()));
+      for (int i = 0; i < NumBuckets; i++) {
+        buckets[i].add(other.buckets[i].load());
+      }
+    }
+  };
+
+  // Nodes of a timer, kept up to date by nodes_of
+  struct TimerNodes {
+    std::vector<uint32_t> all;
+    // Those not nested in the same timer, their totals add up to the time of
+    // the timer
+    std::vector<uint32_t> outermost;
+  };
+
+  ThreadState()
+  {
+    // Node 0 is the top of the thread, outside of any timer
+    _chunks[0] = new Node[ChunkSize];
+    _size = 1;
+  }
+
+  ~ThreadState()
+  {
+    for (auto& chunk : _chunks) { delete[] chunk.load(); }
+  }
+
+  ThreadState(const ThreadState&) = delete;
+  ThreadState& operator=(const ThreadState&) = delete;
+
+  Node& node(uint32_t index)
+  {
+    return _chunks[index / ChunkSize].load(
+      std::memory_order_relaxed)[index % ChunkSize];
+  }
+
+  // Nodes below this index are safe to read from any thread
+  uint32_t size() const { return _size.load(std::memory_order_acquire); }
+
+  // Returns Nil when out of nodes, the call is then not recorded
+  uint32_t enter(uint32_t timer)
+  {
+    auto& open = _open_calls(timer);
+    uint32_t index = _child(_current, timer, open > 0);
+    if (index != Nil) {
+      _current = index;
+      open++;
+    }
+    return index;
+  }
+
+  void exit(uint32_t index, int64_t ticks)
+  {
+    if (index == Nil) { return; }
+    auto& n = node(index);
+    n.record(ticks);
+    if (n.parent != 0) { node(n.parent).child_ticks.add(ticks); }
+    _open_calls(n.timer)--;
+    _current = n.parent;
+  }
+
+  void record_nested(uint32_t timer, int64_t ticks)
+  {
+    uint32_t index = _child(_current, timer, _open_calls(timer) > 0);
+    if (index == Nil) { return; }
+    auto& n = node(index);
+    n.record(ticks);
+    if (_current != 0) { node(_current).child_ticks.add(ticks); }
+  }
+
+  // Adds the counters of a thread that exited to the nodes of the same paths
+  void absorb(ThreadState& other)
+  {
+    uint32_t size = other.size();
+    std::vector<uint32_t> to_local(size, Nil);
+    to_local[0] = 0;
+    for (uint32_t i = 1; i < size; i++) {
+      auto& n = other.node(i);
+      uint32_t parent = to_local[n.parent];
+      if (parent == Nil) { continue; }
+      to_local[i] = _child(parent, n.timer, n.nested);
+      if (to_local[i] != Nil) { node(to_local[i]).add(n); }
+    }
+  }
+
+  // Only called with the mutex of SimpleTimer held, the index is extended
+  // with the nodes created since the last call
+  const TimerNodes& nodes_of(uint32_t timer)
+  {
+    uint32_t size = this->size();
+    for (; _indexed < size; _indexed++) {
+      auto& n = node(_indexed);
+      if (n.timer >= _by_timer.size()) { _by_timer.resize(n.timer + 1); }
+      auto& nodes = _by_timer[n.timer];
+      nodes.all.push_back(_indexed);
+      if (!n.nested) { nodes.outermost.push_back(_indexed); }
+    }
+    static const TimerNodes empty;
+    return timer < _by_timer.size() ? _by_timer[timer] : empty;
+  }
+
+ private:
+  static constexpr uint32_t ChunkSize = 256;
+  static constexpr uint32_t MaxChunks = 1024;
+
+  uint32_t _child(uint32_t parent, uint32_t timer, bool nested)
+  {
+    auto& p = node(parent);
+    for (uint32_t c = p.first_child; c != Nil; c = node(c).next_sibling) {
+      if (node(c).timer == timer) { return c; }
+    }
+    uint32_t index = _size.load(std::memory_order_relaxed);
+    if (index / ChunkSize >= MaxChunks) { return Nil; }
+    if (index % ChunkSize == 0) {
+      _chunks[index / ChunkSize].store(
+        new Node[ChunkSize], std::memory_order_relaxed);
+    }
+    auto& n = node(index);
+    n.timer = timer;
+    n.parent = parent;
+    n.nested = nested;
+    n.next_sibling = p.first_child;
+    p.first_child = index;
+    _size.store(index + 1, std::memory_order_release);
+    return index;
+  }
+
+  std::array<std::atomic<Node*>, MaxChunks> _chunks{};
+  std::atomic<uint32_t> _size;
+
+  uint32_t& _open_calls(uint32_t timer)
+  {
+    if (timer >= _open_by_timer.size()) [[unlikely]] {
+      _open_by_timer.resize(timer + 1);
+    }
+    return _open_by_timer[timer];
+  }
+
+  // Node of the innermost open scope
+  uint32_t _current = 0;
+  // Scopes open on the thread, per timer
+  std::vector<uint32_t> _open_by_timer;
+
+  uint32_t _indexed = 1;
+  std::vector<TimerNodes> _by_timer;
+};
+
+namespace {
+
+thread_local SimpleTimer::ThreadState* current_thread_state = nullptr;
+
+} // namespace
+
+// Hands the tree of a thread over to the tree of the exited threads when the
+// thread exits, which frees it
+struct SimpleTimer::ThreadOwner {
+ public:
+  ThreadState* state = nullptr;
+
+  ~ThreadOwner()
+  {
+    current_thread_state = nullptr;
+    auto& self = singleton();
+    std::unique_lock lk(self._mutex);
+    self._threads[0]->absorb(*state);
+    std::erase_if(
+      self._threads, [&](const auto& s) { return s.get() == state; });
+  }
+};
+
+namespace {
+
+// A node of the call trees of every thread, merged by path
+struct MergedNode {
+  uint32_t timer = Nil;
+  int64_t count = 0;
+  int64_t total_ticks = 0;
+  int64_t child_ticks = 0;
+  int64_t self_ticks = 0;
+  int64_t min_ticks = NoMin;
+  int64_t max_ticks = 0;
+  std::array<int64_t, NumBuckets> buckets{};
+  std::vector<uint32_t> children;
+  std::map<uint32_t, uint32_t> child_by_timer;
+
+  void add(SimpleTimer::ThreadState::Node& node)
+  {
+    count += node.count.load();
+    total_ticks += node.total_ticks.load();
+    child_ticks += node.child_ticks.load();
+    min_ticks = std::min(min_ticks, node.min_ticks.load());
+    max_ticks = std::max(max_ticks, node.max_ticks.load());
+    for (int i = 0; i < NumBuckets; i++) {
+      buckets[i] += node.buckets[i].load();
+    }
+  }
+
+  void merge(const MergedNode& other)
+  {
+    count += other.count;
+    min_ticks = std::min(min_ticks, other.min_ticks);
+    max_ticks = std::max(max_ticks, other.max_ticks);
+    for (int i = 0; i < NumBuckets; i++) { buckets[i] += other.buckets[i]; }
+  }
+
+  Span percentile(double p) const
+  {
+    int64_t rank = std::clamp<int64_t>(p * count, 1, count);
+    int64_t seen = 0;
+    for (int i = 0; i < NumBuckets; i++) {
+      seen += buckets[i];
+      if (seen >= rank) {
+        int64_t upper = i >= 63 ? max_ticks : int64_t(1) << i;
+        return CycleClock::to_span(std::clamp(upper, min_ticks, max_ticks));
+      }
+    }
+    return CycleClock::to_span(max_ticks);
+  }
+};
+
+} // namespace
+
 ////////////////////////////////////////////////////////////////////////////////
 // Timer
 //
 
-SimpleTimer::Timer::Timer(const std::string& name) : _name(name) {}
+SimpleTimer::Timer::Timer(const std::string& name, uint32_t index)
+    : _name(name), _index(index)
+{}
 
 void SimpleTimer::Timer::add_call(const bee::Span& duration)
 {
-  _call_count.fetch_add(1);
-  while (true) {
-    auto tt = _total_time.load();
-    if (_total_time.compare_exchange_strong(tt, tt + duration)) { break; }
+  _thread_state().record_nested(_index, CycleClock::to_ticks(duration));
+}
+
+bee::Span SimpleTimer::Timer::total_time() const
+{
+  auto& self = singleton();
+  std::unique_lock lk(self._mutex);
+  int64_t ticks = 0;
+  for (const auto& state : self._threads) {
+    for (uint32_t i : state->nodes_of(_index).outermost) {
+      ticks += state->node(i).total_ticks.load();
+    }
+  }
+  return CycleClock::to_span(ticks);
+}
+
+int64_t SimpleTimer::Timer::call_count() const
+{
+  auto& self = singleton();
+  std::unique_lock lk(self._mutex);
+  int64_t count = 0;
+  for (const auto& state : self._threads) {
+    for (uint32_t i : state->nodes_of(_index).all) {
+      count += state->node(i).count.load();
+    }
   }
+  return count;
 }
 
-bee::Span SimpleTimer::Timer::total_time() const { return _total_time; }
-int64_t SimpleTimer::Timer::call_count() const { return _call_count; }
 const std::string& SimpleTimer::Timer::name() const { return _name; }
 
+uint32_t SimpleTimer::Timer::index() const { return _index; }
+
 void SimpleTimer::Timer::reset()
 {
-  _call_count = 0;
-  _total_time = bee::Span::zero();
+  auto& self = singleton();
+  std::unique_lock lk(self._mutex);
+  for (const auto& state : self._threads) {
+    for (uint32_t i : state->nodes_of(_index).all) {
+      state->node(i).reset();
+    }
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -34,20 +372,66 @@ void SimpleTimer::Timer::reset()
 //
 
 SimpleTimer::Scoped::Scoped(const Timer::ptr& timer)
-    : _timer(timer), _start(bee::Time::monotonic())
+    : _state(&_thread_state()),
+      _node(_state->enter(timer->index())),
+      _name(timer->name().c_str()),
+      _start(CycleClock::now())
 {}
 
 SimpleTimer::Scoped::~Scoped()
 {
-  auto duration = bee::Time::monotonic() - _start;
-  _timer->add_call(duration);
+  int64_t ticks = CycleClock::now() - _start;
+  _state->exit(_node, ticks);
+  if (Trace::is_recording()) [[unlikely]] {
+    Trace::record(
+      _name, CycleClock::to_time(_start), CycleClock::to_span(ticks));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Report
+//
+
+std::string SimpleTimer::Report::to_string() const
+{
+  std::vector<std::string> lines;
+  for (const auto& timer : timers) {
+    lines.push_back(F(
+      "name:$ count:$ avg_time:$ total_time:$ self_time:$ min:$ p50:$ "
+      "p99:$ max:$",
+      timer.name,
+      timer.count,
+      timer.total / timer.count,
+      timer.total,
+      timer.self,
+      timer.min,
+      timer.p50,
+      timer.p99,
+      timer.max));
+  }
+  if (!roots.empty()) { lines.push_back("Call tree:"); }
+  auto add_node = [&](auto& self, const CallNode& node, int depth) -> void {
+    lines.push_back(
+      std::string(depth * 2, ' ') +
+      F("$ count:$ total:$ self:$",
+        node.name,
+        node.count,
+        node.total,
+        node.self));
+    for (const auto& child : node.children) { self(self, child, depth + 1); }
+  };
+  for (const auto& root : roots) { add_node(add_node, root, 1); }
+  return join(lines, "\n");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // SimpleTimer
 //
 
-SimpleTimer::SimpleTimer() {}
+SimpleTimer::SimpleTimer()
+{
+  _threads.push_back(std::make_unique<ThreadState>());
+}
 SimpleTimer::~SimpleTimer() {}
 
 SimpleTimer& SimpleTimer::singleton()
@@ -56,32 +440,120 @@ SimpleTimer& SimpleTimer::singleton()
   return tracer;
 }
 
+SimpleTimer::ThreadState& SimpleTimer::_thread_state()
+{
+  if (current_thread_state == nullptr) [[unlikely]] {
+    static thread_local ThreadOwner owner;
+    auto state = std::make_unique<ThreadState>();
+    owner.state = state.get();
+    current_thread_state = state.get();
+    auto& self = singleton();
+    std::unique_lock lk(self._mutex);
+    self._threads.push_back(std::move(state));
+  }
+  return *current_thread_state;
+}
+
 SimpleTimer::TimerWrapper SimpleTimer::create_timer(const std::string& name)
 {
-  auto timer = std::make_shared<Timer>(name);
-  SimpleTimer::singleton()._register_timer(timer);
+  auto& self = singleton();
+  std::unique_lock lk(self._mutex);
+  auto timer = std::make_shared<Timer>(name, self._timers.size());
+  self._timers.push_back(timer);
   return timer;
 }
 
-void SimpleTimer::_register_timer(const Timer::ptr& timer)
+SimpleTimer::Report SimpleTimer::report()
 {
-  _timers.push_back(timer);
+  auto& self = singleton();
+  std::unique_lock lk(self._mutex);
+
+  std::vector<MergedNode> merged(1);
+  for (const auto& state : self._threads) {
+    uint32_t size = state->size();
+    // Parents are always created before their children
+    std::vector<uint32_t> to_merged(size);
+    to_merged[0] = 0;
+    for (uint32_t i = 1; i < size; i++) {
+      auto& node = state->node(i);
+      uint32_t parent = to_merged[node.parent];
+      auto it = merged[parent].child_by_timer.find(node.timer);
+      if (it == merged[parent].child_by_timer.end()) {
+        uint32_t index = merged.size();
+        merged.emplace_back();
+        merged.back().timer = node.timer;
+        merged[parent].children.push_back(index);
+        it = merged[parent].child_by_timer.emplace(node.timer, index).first;
+      }
+      to_merged[i] = it->second;
+      merged[it->second].add(node);
+    }
+  }
+
+  // Flat per timer. Calls of a timer nested in a call of the same timer are
+  // already part of the outer total.
+  std::vector<MergedNode> flat(self._timers.size());
+  std::vector<int> open(self._timers.size(), 0);
+  auto to_call_node = [&](auto& rec, uint32_t index) -> CallNode {
+    auto& node = merged[index];
+    auto& timer = flat[node.timer];
+    timer.merge(node);
+    if (open[node.timer] == 0) { timer.total_ticks += node.total_ticks; }
+    int64_t self_ticks = node.total_ticks - node.child_ticks;
+    timer.self_ticks += self_ticks;
+    CallNode out = {
+      .name = self._timers[node.timer]->name(),
+      .count = node.count,
+      .total = CycleClock::to_span(node.total_ticks),
+      .self = CycleClock::to_span(self_ticks),
+      .children = {},
+    };
+    open[node.timer]++;
+    for (uint32_t child : node.children) {
+      auto call_node = rec(rec, child);
+      if (call_node.count > 0) { out.children.push_back(std::move(call_node)); }
+    }
+    open[node.timer]--;
+    return out;
+  };
+
+  Report report;
+  for (uint32_t root : merged[0].children) {
+    auto call_node = to_call_node(to_call_node, root);
+    if (call_node.count > 0) { report.roots.push_back(std::move(call_node)); }
+  }
+  for (size_t i = 0; i < flat.size(); i++) {
+    const auto& timer = flat[i];
+    if (timer.count == 0) { continue; }
+    report.timers.push_back({
+      .name = self._timers[i]->name(),
+      .count = timer.count,
+      .total = CycleClock::to_span(timer.total_ticks),
+      .self = CycleClock::to_span(timer.self_ticks),
+      .min = CycleClock::to_span(timer.min_ticks),
+      .p50 = timer.percentile(0.5),
+      .p99 = timer.percentile(0.99),
+      .max = CycleClock::to_span(timer.max_ticks),
+    });
+  }
+  return report;
 }
 
-void SimpleTimer::show_summary()
+void SimpleTimer::reset_all()
 {
-  for (const auto& timer : singleton()._timers) {
-    auto count = timer->call_count();
-    auto total_time = timer->total_time();
-    if (count == 0) { continue; }
-    auto avg_time = total_time / count;
-    P("name:$ count:$ avg_time:$ total_time:$",
-      timer->name(),
-      count,
-      avg_time,
-      total_time);
-    timer->reset();
+  auto& self = singleton();
+  std::unique_lock lk(self._mutex);
+  for (const auto& state : self._threads) {
+    uint32_t size = state->size();
+    for (uint32_t i = 1; i < size; i++) { state->node(i).reset(); }
   }
 }
 
+void SimpleTimer::show_summary()
+{
+  auto summary = report();
+  if (!summary.timers.empty()) { P(summary.to_string()); }
+  reset_all();
+}
+
 } // namespace bee
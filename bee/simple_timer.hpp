@@ -1,7 +1,10 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include "bee/span.hpp"
@@ -9,14 +12,19 @@
 
 namespace bee {
 
+// Named timers for code regions. Every thread accumulates into its own call
+// tree, keyed by the path of timers from the top of the thread, so a scope
+// only touches memory of its own thread. Scopes are timed with CycleClock and
+// kept in its ticks, the trees are merged and converted when a report is made.
 struct SimpleTimer {
  public:
   struct Scoped;
+  struct ThreadState;
 
   struct Timer : public std::enable_shared_from_this<Timer> {
    public:
     using ptr = std::shared_ptr<Timer>;
-    Timer(const std::string& name);
+    Timer(const std::string& name, uint32_t index);
 
     Timer(const Timer& other) = delete;
     Timer(Timer&& other) = delete;
@@ -24,20 +32,23 @@ struct SimpleTimer {
     Timer& operator=(const Timer& other) = delete;
     Timer& operator=(Timer&& other) = delete;
 
+    // Records a call nested in the scope open on the calling thread
     void add_call(const bee::Span& duration);
 
+    // Summed over all threads, calls nested in a call to the same timer are
+    // only counted once
     bee::Span total_time() const;
     int64_t call_count() const;
 
     const std::string& name() const;
+    uint32_t index() const;
 
+    // Calls running on other threads while this runs may be partially lost
     void reset();
 
    private:
     const std::string _name;
-
-    std::atomic<bee::Span> _total_time = bee::Span::zero();
-    std::atomic<int64_t> _call_count = 0;
+    const uint32_t _index;
   };
 
   struct Scoped {
@@ -45,9 +56,15 @@ struct SimpleTimer {
     Scoped(const Timer::ptr& timer);
     ~Scoped();
 
+    Scoped(const Scoped& other) = delete;
+    Scoped& operator=(const Scoped& other) = delete;
+
    private:
-    Timer::ptr _timer;
-    const bee::Time _start;
+    ThreadState* _state;
+    uint32_t _node;
+    const char* _name;
+    // CycleClock reading
+    const int64_t _start;
   };
 
   struct TimerWrapper {
@@ -60,6 +77,37 @@ struct SimpleTimer {
     Timer::ptr _timer;
   };
 
+  // Flat statistics of a timer over every thread and call path. Percentiles
+  // are the upper bound of a power of two bucket, clamped to [min, max].
+  struct TimerSummary {
+    std::string name;
+    int64_t count = 0;
+    Span total = Span::zero();
+    Span self = Span::zero();
+    Span min = Span::zero();
+    Span p50 = Span::zero();
+    Span p99 = Span::zero();
+    Span max = Span::zero();
+  };
+
+  // One node per distinct path of nested timers, merged over threads. Self
+  // time is the total minus the time spent in nested timers.
+  struct CallNode {
+    std::string name;
+    int64_t count = 0;
+    Span total = Span::zero();
+    Span self = Span::zero();
+    std::vector<CallNode> children;
+  };
+
+  struct Report {
+    std::vector<TimerSummary> timers;
+    // Timers opened outside of any other
+    std::vector<CallNode> roots;
+
+    std::string to_string() const;
+  };
+
   ~SimpleTimer();
 
   SimpleTimer(const SimpleTimer& other) = delete;
@@ -68,8 +116,13 @@ struct SimpleTimer {
   SimpleTimer& operator=(const SimpleTimer& other) = delete;
   SimpleTimer& operator=(SimpleTimer&& other) = delete;
 
+  // Prints the report and resets every timer
   static void show_summary();
 
+  static Report report();
+
+  static void reset_all();
+
   static SimpleTimer& singleton();
 
   static TimerWrapper create_timer(const std::string& name);
@@ -77,9 +130,15 @@ struct SimpleTimer {
  private:
   SimpleTimer();
 
-  void _register_timer(const std::shared_ptr<Timer>& timer);
+  struct ThreadOwner;
+
+  static ThreadState& _thread_state();
 
+  std::mutex _mutex;
   std::vector<std::shared_ptr<Timer>> _timers;
+  // One per running thread, the first one holds what the threads that exited
+  // recorded
+  std::vector<std::unique_ptr<ThreadState>> _threads;
 };
 
 } // namespace bee
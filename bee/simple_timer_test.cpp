@@ -0,0 +1,96 @@
+#include "simple_timer.hpp"
+
+#include <thread>
+
+#include "testing.hpp"
+
+namespace bee {
+namespace {
+
+auto outer_timer = SimpleTimer::create_timer("outer");
+auto inner_timer = SimpleTimer::create_timer("inner");
+auto leaf_timer = SimpleTimer::create_timer("leaf");
+auto recursive_timer = SimpleTimer::create_timer("recursive");
+
+void print_tree(const SimpleTimer::CallNode& node, int depth)
+{
+  P("$ count:$ self<=total:$",
+    std::string(depth * 2, ' ') + node.name,
+    node.count,
+    node.self <= node.total);
+  for (const auto& child : node.children) { print_tree(child, depth + 1); }
+}
+
+void print_report()
+{
+  auto report = SimpleTimer::report();
+  for (const auto& timer : report.timers) {
+    P("$ count:$ min<=p50<=p99<=max:$",
+      timer.name,
+      timer.count,
+      timer.min <= timer.p50 && timer.p50 <= timer.p99 &&
+        timer.p99 <= timer.max);
+  }
+  for (const auto& root : report.roots) { print_tree(root, 1); }
+}
+
+void recurse(int depth)
+{
+  auto scope = recursive_timer();
+  if (depth > 0) { recurse(depth - 1); }
+}
+
+TEST(call_tree)
+{
+  auto work = []() {
+    for (int i = 0; i < 10; i++) {
+      auto outer = outer_timer();
+      for (int j = 0; j < 3; j++) {
+        auto inner = inner_timer();
+        auto leaf = leaf_timer();
+      }
+      auto leaf = leaf_timer();
+    }
+    auto leaf = leaf_timer();
+  };
+  work();
+  // Trees of every thread are merged by path
+  std::thread thread(work);
+  thread.join();
+  print_report();
+  SimpleTimer::reset_all();
+  P("after reset: $", SimpleTimer::report().timers.size());
+}
+
+TEST(recursion)
+{
+  recurse(4);
+  auto report = SimpleTimer::report();
+  auto& timer = report.timers.at(0);
+  auto& root = report.roots.at(0);
+  P("$ count:$ total is outermost call:$",
+    timer.name,
+    timer.count,
+    timer.total == root.total);
+  print_tree(root, 1);
+  SimpleTimer::reset_all();
+}
+
+TEST(exited_threads)
+{
+  // What exited threads recorded is kept in a tree of its own
+  for (int i = 0; i < 3; i++) {
+    std::thread thread([]() {
+      auto outer = outer_timer();
+      recurse(2);
+    });
+    thread.join();
+  }
+  auto outer = outer_timer();
+  recurse(1);
+  print_report();
+  SimpleTimer::reset_all();
+}
+
+} // namespace
+} // namespace bee
@@ -0,0 +1,194 @@
+#include "slab.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include <tuple>
+#include <utility>
+
+namespace bee {
+
+////////////////////////////////////////////////////////////////////////////////
+// SlabPool
+//
+
+struct SlabPool {
+ public:
+  static constexpr size_t MaxFreeSlabs = 64;
+
+  static Slab* pop()
+  {
+    auto& list = _list;
+    if (list.head == nullptr) { return nullptr; }
+    auto slab = list.head;
+    list.head = slab->_next_free;
+    list.size--;
+    slab->_next_free = nullptr;
+    return slab;
+  }
+
+  static bool push(Slab* slab)
+  {
+    auto& list = _list;
+    if (list.closed || list.size >= MaxFreeSlabs) { return false; }
+    // Make sure the free list gets drained when the thread exits
+    std::ignore = &_cleanup;
+    slab->_next_free = list.head;
+    list.head = slab;
+    list.size++;
+    return true;
+  }
+
+ private:
+  // Trivially destructible on purpose, slabs can still be released after the
+  // cleanup below has run (e.g. by static DataBuffers), at which point they
+  // are just freed
+  struct FreeList {
+    Slab* head = nullptr;
+    size_t size = 0;
+    bool closed = false;
+  };
+
+  struct Cleanup {
+    ~Cleanup()
+    {
+      _list.closed = true;
+      while (auto slab = pop()) { Slab::_destroy(slab); }
+    }
+  };
+
+  static thread_local FreeList _list;
+  static thread_local Cleanup _cleanup;
+};
+
+thread_local SlabPool::FreeList SlabPool::_list;
+thread_local SlabPool::Cleanup SlabPool::_cleanup;
+
+////////////////////////////////////////////////////////////////////////////////
+// Slab
+//
+
+Slab::Slab(Kind kind, size_t capacity)
+    : _kind(kind),
+      _capacity(capacity),
+      _used(0),
+      _data(reinterpret_cast<std::byte*>(this + 1))
+{}
+
+Slab::Slab(Bytes&& data)
+    : _kind(Kind::Adopted),
+      _capacity(data.size()),
+      _used(data.size()),
+      _data(data.data()),
+      _adopted(std::move(data))
+{}
+
+Slab::~Slab() noexcept {}
+
+Slab* Slab::allocate(size_t min_capacity)
+{
+  if (min_capacity <= DefaultCapacity) {
+    if (auto slab = SlabPool::pop()) {
+      slab->_reset();
+      return slab;
+    }
+    void* mem = ::operator new(sizeof(Slab) + DefaultCapacity);
+    return new (mem) Slab(Kind::Pooled, DefaultCapacity);
+  } else {
+    void* mem = ::operator new(sizeof(Slab) + min_capacity);
+    return new (mem) Slab(Kind::Dedicated, min_capacity);
+  }
+}
+
+Slab* Slab::adopt(Bytes&& data)
+{
+  void* mem = ::operator new(sizeof(Slab));
+  return new (mem) Slab(std::move(data));
+}
+
+void Slab::add_ref() { _refs.fetch_add(1, std::memory_order_relaxed); }
+
+void Slab::release()
+{
+  if (_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) { return; }
+  if (_kind == Kind::Pooled && SlabPool::push(this)) { return; }
+  _destroy(this);
+}
+
+bool Slab::is_shared() const
+{
+  return _refs.load(std::memory_order_acquire) != 1;
+}
+
+std::byte* Slab::data() { return _data; }
+const std::byte* Slab::data() const { return _data; }
+
+size_t Slab::capacity() const { return _capacity; }
+size_t Slab::used() const { return _used; }
+size_t Slab::available() const { return _capacity - _used; }
+
+size_t Slab::bump(size_t size)
+{
+  size_t claimed = std::min(size, available());
+  _used += claimed;
+  return claimed;
+}
+
+void Slab::_reset()
+{
+  assert(_kind == Kind::Pooled);
+  _refs.store(1, std::memory_order_relaxed);
+  _used = 0;
+}
+
+void Slab::_destroy(Slab* slab)
+{
+  slab->~Slab();
+  ::operator delete(slab);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SlabRef
+//
+
+SlabRef::SlabRef() : _slab(nullptr) {}
+SlabRef::SlabRef(Slab* slab) : _slab(slab) {}
+
+SlabRef::SlabRef(const SlabRef& other) : _slab(other._slab)
+{
+  if (_slab != nullptr) { _slab->add_ref(); }
+}
+
+SlabRef::SlabRef(SlabRef&& other) noexcept : _slab(other._slab)
+{
+  other._slab = nullptr;
+}
+
+SlabRef& SlabRef::operator=(const SlabRef& other)
+{
+  if (other._slab != nullptr) { other._slab->add_ref(); }
+  if (_slab != nullptr) { _slab->release(); }
+  _slab = other._slab;
+  return *this;
+}
+
+SlabRef& SlabRef::operator=(SlabRef&& other) noexcept
+{
+  if (this != &other) {
+    if (_slab != nullptr) { _slab->release(); }
+    _slab = std::exchange(other._slab, nullptr);
+  }
+  return *this;
+}
+
+SlabRef::~SlabRef() noexcept
+{
+  if (_slab != nullptr) { _slab->release(); }
+}
+
+Slab* SlabRef::get() const { return _slab; }
+Slab* SlabRef::operator->() const { return _slab; }
+
+bool SlabRef::has_value() const { return _slab != nullptr; }
+
+} // namespace bee
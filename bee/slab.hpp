@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "bytes.hpp"
+
+namespace bee {
+
+// Reference counted chunk of memory backing DataBlocks. Slabs of the default
+// capacity are recycled through a per thread free list, so getting a new one
+// is usually just popping a pointer.
+struct Slab {
+ public:
+  static constexpr size_t DefaultCapacity = 1 << 14;
+
+  Slab(const Slab& other) = delete;
+  Slab(Slab&& other) = delete;
+
+  Slab& operator=(const Slab& other) = delete;
+  Slab& operator=(Slab&& other) = delete;
+
+  // Returns a slab with at least min_capacity bytes and one reference
+  static Slab* allocate(size_t min_capacity = DefaultCapacity);
+
+  // Wraps the storage of data without copying it, the slab is full
+  static Slab* adopt(Bytes&& data);
+
+  void add_ref();
+  void release();
+
+  bool is_shared() const;
+
+  std::byte* data();
+  const std::byte* data() const;
+
+  size_t capacity() const;
+  size_t used() const;
+  size_t available() const;
+
+  // Claims up to size bytes past the used region and returns how many were
+  // claimed, the claimed region starts at the old value of used()
+  size_t bump(size_t size);
+
+ private:
+  enum class Kind { Pooled, Dedicated, Adopted };
+
+  Slab(Kind kind, size_t capacity);
+  explicit Slab(Bytes&& data);
+  ~Slab() noexcept;
+
+  void _reset();
+  static void _destroy(Slab* slab);
+
+  friend struct SlabPool;
+
+  std::atomic<uint32_t> _refs = 1;
+  const Kind _kind;
+  size_t _capacity;
+  size_t _used;
+  std::byte* _data;
+  Bytes _adopted;
+  Slab* _next_free = nullptr;
+};
+
+// Owning handle to a Slab, copying it shares the slab
+struct SlabRef {
+ public:
+  SlabRef();
+  explicit SlabRef(Slab* slab);
+
+  SlabRef(const SlabRef& other);
+  SlabRef(SlabRef&& other) noexcept;
+
+  SlabRef& operator=(const SlabRef& other);
+  SlabRef& operator=(SlabRef&& other) noexcept;
+
+  ~SlabRef() noexcept;
+
+  Slab* get() const;
+  Slab* operator->() const;
+
+  bool has_value() const;
+
+ private:
+  Slab* _slab;
+};
+
+} // namespace bee
@@ -135,12 +135,20 @@ const Span Span::min = Span::of_nanos(std::numeric_limits<int64_t>::min());
 const Span Span::max = Span::of_nanos(std::numeric_limits<int64_t>::max());
 
 std::string Span::to_string(const FormatParams& p) const
+{
+  std::string output;
+  append_to(output, p);
+  return output;
+}
+
+void Span::append_to(std::string& out, const FormatParams& p) const
 {
   auto abs_span = std::abs(_span_nanos);
   double value;
   const char* suffix;
   if (abs_span == 0) {
-    return "0s";
+    out += "0s";
+    return;
   } else if (abs_span < Constants::micro) {
     value = to_nanos();
     suffix = "ns";
@@ -160,7 +168,8 @@ std::string Span::to_string(const FormatParams& p) const
     value = double(_span_nanos) / Constants::hour;
     suffix = "h";
   }
-  return bee::to_string(value, p) + suffix;
+  format_to(out, value, p);
+  out += suffix;
 }
 
 const Error invalid_format_error("Invalid format");
@@ -61,6 +61,7 @@ struct Span {
   static Span zero();
 
   std::string to_string(const FormatParams& = {}) const;
+  void append_to(std::string& out, const FormatParams& = {}) const;
   static OrError<Span> of_string(const std::string& str);
 
   void sleep() const;
@@ -385,6 +385,12 @@ OrError<SubProcess::ptr> SubProcess::spawn(
 
     if (getppid() == 1) { exit(1); }
 
+    // The mask is inherited through exec, and the parent may have blocked
+    // signals it handles with a signalfd, like SIGCHLD in EventLoop
+    sigset_t no_signals;
+    sigemptyset(&no_signals);
+    sigprocmask(SIG_SETMASK, &no_signals, nullptr);
+
     if (args.cwd.has_value()) {
       std::filesystem::current_path(args.cwd->to_std_path());
     }
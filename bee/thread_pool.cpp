@@ -0,0 +1,143 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+#include "span.hpp"
+
+namespace bee {
+namespace {
+
+// Set on the workers of a pool, -1 elsewhere
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int current_index = -1;
+
+} // namespace
+
+ThreadPool::ThreadPool(int num_workers)
+{
+  num_workers = std::max(num_workers, 1);
+  for (int i = 0; i < num_workers; i++) {
+    _workers.push_back(std::make_unique<Worker>());
+  }
+  // Only start the threads once all deques exist, they steal from each other
+  for (int i = 0; i < num_workers; i++) {
+    _workers[i]->thread = std::thread([this, i]() { _worker_loop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() noexcept
+{
+  {
+    std::unique_lock lk(_sleep_mutex);
+    _stopping = true;
+  }
+  _sleep_cv.notify_all();
+  for (auto& worker : _workers) { worker->thread.join(); }
+}
+
+ThreadPool::ptr ThreadPool::create(int num_workers)
+{
+  return ptr(new ThreadPool(num_workers));
+}
+
+ThreadPool& ThreadPool::global()
+{
+  // Never destroyed, tasks may still be running while static destructors run
+  static ThreadPool* pool = new ThreadPool(std::thread::hardware_concurrency());
+  return *pool;
+}
+
+int ThreadPool::num_workers() const { return _workers.size(); }
+
+bool ThreadPool::is_worker_thread() const { return current_pool == this; }
+
+void ThreadPool::execute(Task&& task)
+{
+  int index = is_worker_thread()
+                ? current_index
+                : _next_worker.fetch_add(1, std::memory_order_relaxed) %
+                    _workers.size();
+  auto& worker = *_workers[index];
+  {
+    std::unique_lock lk(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  // Pairs with the check of _pending by sleeping workers, either they see the
+  // task or this sees them sleeping
+  _pending.fetch_add(1);
+  if (_sleeping.load() > 0) {
+    std::unique_lock lk(_sleep_mutex);
+    _sleep_cv.notify_one();
+  }
+}
+
+bool ThreadPool::_take(int index, Task& task)
+{
+  if (_pending.load(std::memory_order_relaxed) == 0) { return false; }
+  int n = _workers.size();
+  if (index >= 0) {
+    auto& own = *_workers[index];
+    std::unique_lock lk(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      _pending.fetch_sub(1);
+      return true;
+    }
+  }
+  int start = index >= 0 ? index + 1 : 0;
+  for (int i = 0; i < n; i++) {
+    auto& victim = *_workers[(start + i) % n];
+    std::unique_lock lk(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      _pending.fetch_sub(1);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::run_one()
+{
+  Task task;
+  if (!_take(is_worker_thread() ? current_index : -1, task)) { return false; }
+  task();
+  return true;
+}
+
+void ThreadPool::help_until(const std::function<bool()>& done)
+{
+  int idle = 0;
+  while (!done()) {
+    if (run_one()) {
+      idle = 0;
+    } else if (idle++ < 64) {
+      std::this_thread::yield();
+    } else {
+      Span::of_micros(50).sleep();
+    }
+  }
+}
+
+void ThreadPool::_worker_loop(int index)
+{
+  current_pool = this;
+  current_index = index;
+  Task task;
+  while (true) {
+    if (_take(index, task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    std::unique_lock lk(_sleep_mutex);
+    _sleeping.fetch_add(1);
+    _sleep_cv.wait(lk, [this]() { return _pending.load() > 0 || _stopping; });
+    _sleeping.fetch_sub(1);
+    if (_stopping && _pending.load() == 0) { break; }
+  }
+}
+
+} // namespace bee
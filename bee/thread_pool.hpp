@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace bee {
+
+// Fixed set of worker threads, each with its own deque of tasks. A worker runs
+// the newest task of its own deque first and steals the oldest task of
+// another worker when it runs out. Tasks submitted from a worker go to that
+// worker's deque, tasks submitted from other threads are spread round robin.
+//
+// A task may submit more tasks and wait for them, wait() and help_until() run
+// queued tasks on the waiting thread in the meantime, so nested parallelism
+// can't starve the pool.
+struct ThreadPool {
+ public:
+  using ptr = std::unique_ptr<ThreadPool>;
+  using Task = std::function<void()>;
+
+  static ptr create(int num_workers);
+
+  // Process wide pool with one worker per core, shared by everything that
+  // doesn't need a dedicated pool
+  static ThreadPool& global();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  // Runs the tasks that are still queued and joins the workers
+  ~ThreadPool() noexcept;
+
+  int num_workers() const;
+
+  void execute(Task&& task);
+
+  template <class F, class R = std::invoke_result_t<std::decay_t<F>>>
+  std::future<R> submit(F&& fn)
+  {
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+    auto future = task->get_future();
+    execute([task = std::move(task)]() { (*task)(); });
+    return future;
+  }
+
+  // Waits until the future is ready. On a worker of this pool the worker keeps
+  // running tasks while it waits instead of blocking.
+  template <class T> void wait(const std::future<T>& future)
+  {
+    if (!is_worker_thread()) {
+      future.wait();
+      return;
+    }
+    help_until([&]() {
+      return future.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+    });
+  }
+
+  // Runs queued tasks on the calling thread until done returns true
+  void help_until(const std::function<bool()>& done);
+
+  // Runs one queued task on the calling thread, returns false if there was
+  // none
+  bool run_one();
+
+  // Whether the calling thread is one of the workers of this pool
+  bool is_worker_thread() const;
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  explicit ThreadPool(int num_workers);
+
+  void _worker_loop(int index);
+
+  // Own deque from the back first, then the front of the others starting from
+  // the next worker
+  bool _take(int index, Task& task);
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+
+  // Tasks queued and not yet taken by any thread
+  std::atomic<int64_t> _pending = 0;
+  std::atomic<uint64_t> _next_worker = 0;
+
+  std::mutex _sleep_mutex;
+  std::condition_variable _sleep_cv;
+  std::atomic<int> _sleeping = 0;
+  bool _stopping = false;
+};
+
+} // namespace bee
@@ -0,0 +1,106 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <vector>
+
+#include "parallel_map.hpp"
+#include "testing.hpp"
+
+using std::vector;
+
+namespace bee {
+namespace {
+
+TEST(submit)
+{
+  auto pool = ThreadPool::create(4);
+  P("num_workers: $", pool->num_workers());
+  vector<std::future<int>> futures;
+  for (int i = 0; i < 100; i++) {
+    futures.push_back(pool->submit([i]() { return i * i; }));
+  }
+  int sum = 0;
+  for (auto& f : futures) { sum += f.get(); }
+  P("sum: $", sum);
+}
+
+TEST(exception)
+{
+  auto pool = ThreadPool::create(2);
+  auto f = pool->submit([]() -> int { throw std::runtime_error("oops"); });
+  try {
+    f.get();
+  } catch (const std::runtime_error& e) {
+    P("caught: $", e.what());
+  }
+}
+
+int64_t fib(ThreadPool& pool, int n)
+{
+  if (n < 2) { return n; }
+  auto left = pool.submit([&pool, n]() { return fib(pool, n - 1); });
+  int64_t right = fib(pool, n - 2);
+  pool.wait(left);
+  return left.get() + right;
+}
+
+TEST(nested)
+{
+  // Every task blocks on a subtask, far more of them than there are workers
+  auto pool = ThreadPool::create(2);
+  auto f = pool->submit([&]() { return fib(*pool, 20); });
+  P("fib(20): $", f.get());
+}
+
+TEST(nested_parallel_map)
+{
+  vector<int> outer = {1, 2, 3, 4, 5, 6, 7, 8};
+  int64_t total = 0;
+  for (int64_t r : ParallelMap::go(outer, 8, [](int n) {
+         vector<int> inner;
+         for (int i = 0; i < 1000; i++) { inner.push_back(i * n); }
+         int64_t sum = 0;
+         for (int v : ParallelMap::go(inner, 4, [](int v) { return v; })) {
+           sum += v;
+         }
+         return sum;
+       })) {
+    total += r;
+  }
+  P("total: $", total);
+}
+
+TEST(destructor_runs_queued_tasks)
+{
+  std::atomic<int> count = 0;
+  {
+    auto pool = ThreadPool::create(1);
+    for (int i = 0; i < 1000; i++) {
+      pool->execute([&]() { count++; });
+    }
+  }
+  P("count: $", count.load());
+}
+
+TEST(help_from_outside)
+{
+  auto pool = ThreadPool::create(1);
+  std::atomic<bool> started = false;
+  std::atomic<bool> release = false;
+  // Keep the only worker busy, the calling thread runs the rest
+  pool->execute([&]() {
+    started = true;
+    while (!release) { std::this_thread::yield(); }
+  });
+  while (!started) { std::this_thread::yield(); }
+  std::atomic<int> count = 0;
+  for (int i = 0; i < 10; i++) {
+    pool->execute([&]() { count++; });
+  }
+  pool->help_until([&]() { return count == 10; });
+  release = true;
+  P("count: $ worker thread: $", count.load(), pool->is_worker_thread());
+}
+
+} // namespace
+} // namespace bee
@@ -111,7 +111,7 @@ OrError<Time> Time::of_string(const std::string& str)
   return of_date(date) + Span::of_seconds(m * 60 + h * 60 * 60 + s);
 }
 
-string Time::_time_of_day() const
+void Time::_append_time_of_day(std::string& out) const
 {
   auto ts = to_nanos_since_epoch();
   ts %= day_in_nanos;
@@ -124,19 +124,35 @@ string Time::_time_of_day() const
 
   double seconds = ts / double(second_in_nanos);
 
-  return F("{02}:{02}:{02.9}", hours, minutes, seconds);
+  format_to(out, "{02}:{02}:{02.9}", hours, minutes, seconds);
 }
 
-string Time::_date() const
+Date Time::_date() const
 {
-  return (unix_epoch_date + to_nanos_since_epoch() / day_in_nanos).to_string();
+  return unix_epoch_date + to_nanos_since_epoch() / day_in_nanos;
 }
 
-string Time::to_string() const { return F("$ $", _date(), _time_of_day()); }
+string Time::to_string() const
+{
+  string output;
+  append_to(output);
+  return output;
+}
 
 string Time::to_string_filename() const
 {
-  return F("$_$", _date(), _time_of_day());
+  string output;
+  _date().append_to(output);
+  output += '_';
+  _append_time_of_day(output);
+  return output;
+}
+
+void Time::append_to(std::string& out) const
+{
+  _date().append_to(out);
+  out += ' ';
+  _append_time_of_day(out);
 }
 
 } // namespace bee
@@ -46,12 +46,13 @@ struct Time {
   static OrError<Time> of_string(const std::string& str);
   std::string to_string() const;
   std::string to_string_filename() const;
+  void append_to(std::string& out) const;
 
  private:
   explicit Time(int64_t ts);
 
-  std::string _time_of_day() const;
-  std::string _date() const;
+  void _append_time_of_day(std::string& out) const;
+  Date _date() const;
 
   int64_t _ts_nanos;
 };
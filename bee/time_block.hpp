@@ -2,22 +2,40 @@
 
 #include <functional>
 
+#include "cycle_clock.hpp"
 #include "span.hpp"
-#include "time.hpp"
+#include "trace.hpp"
 
 namespace bee {
 
 struct TimeBlock {
  public:
   template <class F>
-  TimeBlock(F&& fn) : _start(Time::monotonic()), _fn(std::forward<F>(fn))
+  TimeBlock(F&& fn) : _start(CycleClock::now()), _fn(std::forward<F>(fn))
   {}
 
-  ~TimeBlock() { _fn(Time::monotonic() - _start); }
+  // Also recorded by Trace under trace_name, which has to outlive the trace
+  template <class F>
+  TimeBlock(const char* trace_name, F&& fn)
+      : _start(CycleClock::now()),
+        _fn(std::forward<F>(fn)),
+        _trace_name(trace_name)
+  {}
+
+  ~TimeBlock()
+  {
+    auto duration = CycleClock::to_span(CycleClock::now() - _start);
+    if (_trace_name != nullptr && Trace::is_recording()) {
+      Trace::record(_trace_name, CycleClock::to_time(_start), duration);
+    }
+    _fn(duration);
+  }
 
  private:
-  Time _start;
+  // CycleClock reading
+  int64_t _start;
   std::function<void(Span)> _fn;
+  const char* _trace_name = nullptr;
 };
 
 } // namespace bee
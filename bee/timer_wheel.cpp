@@ -0,0 +1,213 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace bee {
+
+TimerWheel::TimerWheel(Time start, Span resolution)
+    : _start(start),
+      _resolution_nanos(std::max<int64_t>(resolution.to_nanos(), 1))
+{
+  _heads.fill(Nil);
+  _tails.fill(Nil);
+  _occupied.fill(0);
+}
+
+TimerId TimerWheel::add(Time deadline, callback&& fn)
+{
+  uint32_t index = _allocate();
+  auto& node = _nodes[index];
+  node.tick = _ticks_until(deadline, true);
+  node.deadline = deadline;
+  node.fn = std::move(fn);
+  node.active = true;
+  _link(index);
+  _size++;
+  return TimerId{.index = index, .generation = node.generation};
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+  if (id.index >= _nodes.size()) { return false; }
+  auto& node = _nodes[id.index];
+  if (!node.active || node.generation != id.generation) { return false; }
+  _unlink(id.index);
+  node.fn = nullptr;
+  _release(id.index);
+  return true;
+}
+
+size_t TimerWheel::expire(Time now, std::vector<Expired>& out)
+{
+  size_t initial_size = out.size();
+  uint64_t target = _ticks_until(now, false);
+  _take_bucket(DueBucket, out);
+  while (true) {
+    auto next = _next_tick();
+    if (!next.has_value() || *next > target) { break; }
+    _now = *next;
+    if ((_now & ((uint64_t(1) << HorizonBits) - 1)) == 0) {
+      _relink_bucket(ParkedBucket);
+    }
+    // From the top, a timer can move down several levels in one go
+    for (int level = NumLevels - 1; level > 0; level--) {
+      int shift = level * SlotBits;
+      if ((_now & ((uint64_t(1) << shift) - 1)) != 0) { continue; }
+      _relink_bucket(level * NumSlots + ((_now >> shift) & (NumSlots - 1)));
+    }
+    _take_bucket(_now & (NumSlots - 1), out);
+    // Timers that moved down to exactly this tick
+    _take_bucket(DueBucket, out);
+  }
+  // Nothing is due before target, so every timer stays in the same slot
+  _now = std::max(_now, target);
+  return out.size() - initial_size;
+}
+
+std::optional<Time> TimerWheel::next_wakeup() const
+{
+  std::optional<uint64_t> tick;
+  if (_heads[DueBucket] != Nil) {
+    tick = _now;
+  } else {
+    tick = _next_tick();
+  }
+  if (!tick.has_value()) { return std::nullopt; }
+  return _start + Span::of_nanos(*tick * _resolution_nanos);
+}
+
+size_t TimerWheel::size() const { return _size; }
+
+bool TimerWheel::empty() const { return _size == 0; }
+
+uint64_t TimerWheel::_ticks_until(Time t, bool round_up) const
+{
+  int64_t nanos = (t - _start).to_nanos();
+  if (nanos <= 0) { return 0; }
+  if (round_up) { nanos += _resolution_nanos - 1; }
+  return nanos / _resolution_nanos;
+}
+
+std::optional<uint64_t> TimerWheel::_next_tick() const
+{
+  // Occupied slots are always past the current one of their level, and a
+  // level is reached before anything in the levels above, so the lowest
+  // occupied slot of the lowest non-empty level comes first
+  for (int level = 0; level < NumLevels; level++) {
+    if (_occupied[level] == 0) { continue; }
+    int shift = level * SlotBits;
+    uint64_t slot = std::countr_zero(_occupied[level]);
+    int rotation_shift = shift + SlotBits;
+    uint64_t rotation_start = (_now >> rotation_shift) << rotation_shift;
+    return rotation_start + (slot << shift);
+  }
+  if (_heads[ParkedBucket] != Nil) {
+    // Where the levels start over
+    return ((_now >> HorizonBits) + 1) << HorizonBits;
+  }
+  return std::nullopt;
+}
+
+uint32_t TimerWheel::_allocate()
+{
+  if (_free != Nil) {
+    uint32_t index = _free;
+    _free = _nodes[index].next;
+    return index;
+  }
+  _nodes.emplace_back();
+  return _nodes.size() - 1;
+}
+
+void TimerWheel::_release(uint32_t index)
+{
+  auto& node = _nodes[index];
+  node.active = false;
+  node.generation++;
+  node.prev = Nil;
+  node.next = _free;
+  _free = index;
+  _size--;
+}
+
+void TimerWheel::_link(uint32_t index)
+{
+  auto& node = _nodes[index];
+  int bucket = DueBucket;
+  if (node.tick > _now) {
+    int level = (std::bit_width(node.tick ^ _now) - 1) / SlotBits;
+    if (level >= NumLevels) {
+      bucket = ParkedBucket;
+    } else {
+      int slot = (node.tick >> (level * SlotBits)) & (NumSlots - 1);
+      bucket = level * NumSlots + slot;
+      _occupied[level] |= uint64_t(1) << slot;
+    }
+  }
+  node.bucket = bucket;
+  node.prev = _tails[bucket];
+  node.next = Nil;
+  if (node.prev == Nil) {
+    _heads[bucket] = index;
+  } else {
+    _nodes[node.prev].next = index;
+  }
+  _tails[bucket] = index;
+}
+
+void TimerWheel::_unlink(uint32_t index)
+{
+  auto& node = _nodes[index];
+  int bucket = node.bucket;
+  if (node.prev == Nil) {
+    _heads[bucket] = node.next;
+  } else {
+    _nodes[node.prev].next = node.next;
+  }
+  if (node.next == Nil) {
+    _tails[bucket] = node.prev;
+  } else {
+    _nodes[node.next].prev = node.prev;
+  }
+  if (_heads[bucket] == Nil && bucket < DueBucket) {
+    _occupied[bucket / NumSlots] &= ~(uint64_t(1) << (bucket % NumSlots));
+  }
+}
+
+void TimerWheel::_relink_bucket(int bucket)
+{
+  uint32_t index = _heads[bucket];
+  if (index == Nil) { return; }
+  _heads[bucket] = Nil;
+  _tails[bucket] = Nil;
+  if (bucket < DueBucket) {
+    _occupied[bucket / NumSlots] &= ~(uint64_t(1) << (bucket % NumSlots));
+  }
+  while (index != Nil) {
+    uint32_t next = _nodes[index].next;
+    _link(index);
+    index = next;
+  }
+}
+
+void TimerWheel::_take_bucket(int bucket, std::vector<Expired>& out)
+{
+  uint32_t index = _heads[bucket];
+  if (index == Nil) { return; }
+  _heads[bucket] = Nil;
+  _tails[bucket] = Nil;
+  if (bucket != DueBucket) {
+    _occupied[bucket / NumSlots] &= ~(uint64_t(1) << (bucket % NumSlots));
+  }
+  while (index != Nil) {
+    auto& node = _nodes[index];
+    uint32_t next = node.next;
+    out.push_back(Expired{.deadline = node.deadline, .fn = std::move(node.fn)});
+    node.fn = nullptr;
+    _release(index);
+    index = next;
+  }
+}
+
+} // namespace bee
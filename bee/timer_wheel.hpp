@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "span.hpp"
+#include "time.hpp"
+
+namespace bee {
+
+// Identifies a timer of a TimerWheel. Stays safe to cancel after the timer
+// fired or was cancelled, cancelling it then just does nothing.
+struct TimerId {
+  uint32_t index = UINT32_MAX;
+  uint32_t generation = 0;
+
+  bool operator==(const TimerId& other) const = default;
+};
+
+// Hierarchical timing wheel, in the style of the Linux kernel timers. Time is
+// cut in ticks of the given resolution, and a timer goes in the level where
+// its deadline first differs from the current tick, each level having 64
+// slots. A timer in a higher level moves down when the wheel reaches its slot,
+// at most once per level, so add and cancel are O(1) and expiring costs O(1)
+// per timer plus one step per non-empty slot.
+//
+// Timers never fire early, but may fire up to one tick late. Timers due on
+// the same tick come out in no particular order.
+//
+// Not thread safe.
+struct TimerWheel {
+ public:
+  using callback = std::function<void()>;
+
+  struct Expired {
+    Time deadline;
+    callback fn;
+  };
+
+  explicit TimerWheel(Time start, Span resolution = Span::of_millis(1));
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel(TimerWheel&&) = default;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+  TimerWheel& operator=(TimerWheel&&) = default;
+
+  // Deadlines in the past are due on the next call to expire. Deadlines past
+  // the reach of the levels, 2^48 ticks, wait in a list of their own that
+  // moves into the wheel every time it gets through 2^48 ticks.
+  TimerId add(Time deadline, callback&& fn);
+
+  // Returns false if the timer already fired or was cancelled
+  bool cancel(TimerId id);
+
+  // Moves every timer due by now to the end of out, in tick order, and returns
+  // how many there were
+  size_t expire(Time now, std::vector<Expired>& out);
+
+  // When expire should be called next, nullopt if there are no timers. For
+  // timers far away this is when they move down a level, so it can come
+  // before the earliest deadline.
+  std::optional<Time> next_wakeup() const;
+
+  size_t size() const;
+  bool empty() const;
+
+ private:
+  static constexpr int SlotBits = 6;
+  static constexpr int NumSlots = 1 << SlotBits;
+  static constexpr int NumLevels = 8;
+  static constexpr int HorizonBits = SlotBits * NumLevels;
+  static constexpr int DueBucket = NumSlots * NumLevels;
+  static constexpr int ParkedBucket = DueBucket + 1;
+  static constexpr int NumBuckets = ParkedBucket + 1;
+  static constexpr uint32_t Nil = UINT32_MAX;
+
+  struct Node {
+    uint64_t tick = 0;
+    Time deadline = Time::zero();
+    callback fn;
+    uint32_t prev = Nil;
+    uint32_t next = Nil;
+    uint32_t generation = 0;
+    uint16_t bucket = 0;
+    bool active = false;
+  };
+
+  uint64_t _ticks_until(Time t, bool round_up) const;
+  std::optional<uint64_t> _next_tick() const;
+
+  uint32_t _allocate();
+  void _release(uint32_t index);
+
+  // Puts the node in the bucket for its tick
+  void _link(uint32_t index);
+  void _unlink(uint32_t index);
+  void _relink_bucket(int bucket);
+  void _take_bucket(int bucket, std::vector<Expired>& out);
+
+  Time _start;
+  int64_t _resolution_nanos;
+
+  // Last tick expire got to
+  uint64_t _now = 0;
+
+  // Nodes live in a slab and are recycled through a free list, so adding a
+  // timer doesn't allocate once the slab has grown
+  std::vector<Node> _nodes;
+  uint32_t _free = Nil;
+  size_t _size = 0;
+
+  // Doubly linked list per bucket, appended at the tail
+  std::array<uint32_t, NumBuckets> _heads;
+  std::array<uint32_t, NumBuckets> _tails;
+
+  // One bit per non-empty slot, the due and parked buckets have none
+  std::array<uint64_t, NumLevels> _occupied;
+};
+
+} // namespace bee
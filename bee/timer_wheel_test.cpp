@@ -0,0 +1,158 @@
+#include "timer_wheel.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "format_vector.hpp"
+#include "testing.hpp"
+
+using std::string;
+using std::vector;
+
+namespace bee {
+namespace {
+
+const Time start = Time::epoch();
+
+Time at_millis(double millis) { return start + Span::of_millis(millis); }
+
+void expire_and_run(TimerWheel& wheel, Time now)
+{
+  vector<TimerWheel::Expired> due;
+  wheel.expire(now, due);
+  for (auto& timer : due) { timer.fn(); }
+}
+
+string next_wakeup(const TimerWheel& wheel)
+{
+  auto wakeup = wheel.next_wakeup();
+  if (!wakeup.has_value()) { return "none"; }
+  return F(*wakeup - start);
+}
+
+TEST(levels)
+{
+  TimerWheel wheel(start);
+  vector<string> fired;
+  auto add = [&](double millis) {
+    wheel.add(at_millis(millis), [&fired, millis]() {
+      fired.push_back(F(Span::of_millis(millis)));
+    });
+  };
+  for (double millis : {5.0, 1.0, 0.5, 70.0, 5000.0, 300000.0, 1e7}) {
+    add(millis);
+  }
+  P("size: $", wheel.size());
+  for (double now :
+       {0.0, 1.0, 4.9, 5.0, 69.0, 80.0, 5000.0, 299999.0, 3e5, 1e8}) {
+    expire_and_run(wheel, at_millis(now));
+    P("$: fired:$ next:$", Span::of_millis(now), fired, next_wakeup(wheel));
+    fired.clear();
+  }
+  P("empty: $", wheel.empty());
+}
+
+TEST(cancel)
+{
+  TimerWheel wheel(start);
+  vector<int> fired;
+  auto a = wheel.add(at_millis(10), [&]() { fired.push_back(1); });
+  auto b = wheel.add(at_millis(10), [&]() { fired.push_back(2); });
+  auto c = wheel.add(at_millis(1e6), [&]() { fired.push_back(3); });
+  P("cancel c: $", wheel.cancel(c));
+  P("cancel a: $", wheel.cancel(a));
+  P("cancel a again: $", wheel.cancel(a));
+  P("size: $", wheel.size());
+
+  // Reuses the node of a, the old id must not cancel it
+  auto d = wheel.add(at_millis(20), [&]() { fired.push_back(4); });
+  P("reused node: $ stale cancel: $", d.index == a.index, wheel.cancel(a));
+  expire_and_run(wheel, at_millis(30));
+  P("fired: $", fired);
+  P("cancel after firing: $", wheel.cancel(b));
+  P("cancel default id: $", wheel.cancel(TimerId()));
+}
+
+TEST(past_deadline)
+{
+  TimerWheel wheel(at_millis(100));
+  vector<int> fired;
+  expire_and_run(wheel, at_millis(200));
+  wheel.add(at_millis(50), [&]() { fired.push_back(1); });
+  wheel.add(at_millis(199), [&]() { fired.push_back(2); });
+  P("next: $", next_wakeup(wheel));
+  expire_and_run(wheel, at_millis(200));
+  P("fired: $", fired);
+}
+
+TEST(beyond_the_levels)
+{
+  // 2^48 ticks of a microsecond are about 9 years, of a nanosecond 78 hours
+  TimerWheel micros(start, Span::of_micros(1));
+  vector<int> fired;
+  expire_and_run(micros, at_millis(5));
+  micros.add(Time::max(), [&]() { fired.push_back(1); });
+  micros.add(at_millis(6), [&]() { fired.push_back(2); });
+  expire_and_run(micros, at_millis(10));
+  P("fired: $ size: $", fired, micros.size());
+
+  TimerWheel nanos(start, Span::of_nanos(1));
+  expire_and_run(nanos, at_millis(5));
+  auto deadline = at_millis(5) + Span::of_hours(200);
+  nanos.add(deadline, [&]() { fired.push_back(3); });
+  P("next: $", next_wakeup(nanos));
+  expire_and_run(nanos, deadline + Span::of_nanos(-1));
+  P("fired: $ next: $", fired, next_wakeup(nanos));
+  expire_and_run(nanos, deadline);
+  P("fired: $ size: $", fired, nanos.size());
+}
+
+TEST(random)
+{
+  // Checks against the deadlines directly: every timer that isn't cancelled
+  // fires once, never early and at most one tick plus one step late
+  TimerWheel wheel(start);
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int64_t> timeout_ms(0, 1000000);
+  std::uniform_int_distribution<int64_t> step_ms(0, 5000);
+  struct Timer {
+    Time deadline;
+    TimerId id;
+    int fired = 0;
+    bool cancelled = false;
+  };
+  vector<Timer> timers(20000);
+  auto now = start;
+  int errors = 0;
+  size_t next = 0;
+  while (true) {
+    for (int i = 0; i < 500 && next < timers.size(); i++, next++) {
+      auto& timer = timers[next];
+      timer.deadline = now + Span::of_millis(timeout_ms(gen));
+      timer.id = wheel.add(timer.deadline, [&, next]() {
+        auto& t = timers[next];
+        if (t.fired++ > 0 || t.cancelled || now < t.deadline) { errors++; }
+        if (now - t.deadline > Span::of_millis(5001)) { errors++; }
+      });
+    }
+    for (int i = 0; i < 100; i++) {
+      auto& timer = timers[gen() % next];
+      bool cancelled = wheel.cancel(timer.id);
+      if (cancelled != (timer.fired == 0 && !timer.cancelled)) { errors++; }
+      timer.cancelled = timer.cancelled || cancelled;
+    }
+    if (next == timers.size() && wheel.empty()) { break; }
+    now += Span::of_millis(step_ms(gen));
+    expire_and_run(wheel, now);
+  }
+  int fired = 0;
+  for (auto& timer : timers) {
+    if (!timer.cancelled && timer.fired != 1) { errors++; }
+    fired += timer.fired;
+  }
+  P("errors: $ fired: $", errors, fired > 0);
+}
+
+} // namespace
+} // namespace bee
@@ -20,6 +20,12 @@ const char* to_string_t<bool>::convert(bool value)
   return value ? "true" : "false";
 }
 
+void to_string_t<bool>::append(
+  std::string& out, bool value, const FormatParams&)
+{
+  out += convert(value);
+}
+
 // char
 
 std::string to_string_t<char>::convert(char value)
@@ -27,6 +33,12 @@ std::string to_string_t<char>::convert(char value)
   return std::string(1, value);
 }
 
+void to_string_t<char>::append(
+  std::string& out, char value, const FormatParams&)
+{
+  out += value;
+}
+
 // std::string
 
 std::string to_string_t<std::string>::convert(
@@ -51,6 +63,15 @@ std::string to_string_t<std::string>::convert(
   }
 }
 
+void to_string_t<std::string>::append(
+  std::string& out, const std::string& value, const FormatParams& p)
+{
+  out += value;
+  if (std::ssize(value) < p.left_pad_spaces) {
+    out.append(p.left_pad_spaces - value.size(), ' ');
+  }
+}
+
 // void*
 
 std::string to_string_t<void*>::convert(const void* value)
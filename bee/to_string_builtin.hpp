@@ -12,15 +12,19 @@ namespace bee {
 
 template <> struct to_string_t<bool> {
   static const char* convert(bool value);
+  static void append(std::string& out, bool value, const FormatParams&);
 };
 
 template <> struct to_string_t<char> {
   static std::string convert(char value);
+  static void append(std::string& out, char value, const FormatParams&);
 };
 
 template <> struct to_string_t<std::string> {
   static std::string convert(const std::string& value, const FormatParams&);
   static std::string convert(std::string&& value, const FormatParams&);
+  static void append(
+    std::string& out, const std::string& value, const FormatParams&);
 
   template <class T> static auto&& convert(T&& value)
   {
@@ -30,10 +34,18 @@ template <> struct to_string_t<std::string> {
 
 template <> struct to_string_t<char*> {
   static char* convert(char* value) { return value; }
+  static void append(std::string& out, const char* value, const FormatParams&)
+  {
+    out += value;
+  }
 };
 
 template <> struct to_string_t<const char*> {
   static const char* convert(const char* value) { return value; }
+  static void append(std::string& out, const char* value, const FormatParams&)
+  {
+    out += value;
+  }
 };
 
 template <> struct to_string_t<void*> {
@@ -46,6 +58,11 @@ template <> struct to_string_t<const void*> {
 
 template <> struct to_string_t<std::string_view> {
   static std::string convert(const std::string_view& value);
+  static void append(
+    std::string& out, const std::string_view& value, const FormatParams&)
+  {
+    out += value;
+  }
 };
 
 } // namespace bee
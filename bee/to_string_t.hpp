@@ -27,6 +27,17 @@ concept has_to_string_with_params =
     { t.to_string(p) } -> std::convertible_to<std::string>;
   };
 
+template <class T>
+concept has_append_to = requires(const T& t, std::string& out) {
+  { t.append_to(out) };
+};
+
+template <class T>
+concept has_append_to_with_params =
+  requires(const T& t, std::string& out, const FormatParams& p) {
+    { t.append_to(out, p) };
+  };
+
 } // namespace to_string_t_details
 
 template <to_string_t_details::has_to_string T>
@@ -34,6 +45,12 @@ template <to_string_t_details::has_to_string T>
 struct to_string_t<T> {
   static std::string convert(const T& value) { return value.to_string(); }
   static std::string convert(T&& value) { return std::move(value).to_string(); }
+
+  static void append(std::string& out, const T& value, const FormatParams&)
+    requires to_string_t_details::has_append_to<T>
+  {
+    value.append_to(out);
+  }
 };
 
 template <to_string_t_details::has_to_string_with_params T>
@@ -47,6 +64,13 @@ struct to_string_t<T> {
   {
     return std::move(value).to_string(params);
   }
+
+  static void append(
+    std::string& out, const T& value, const FormatParams& params)
+    requires to_string_t_details::has_append_to_with_params<T>
+  {
+    value.append_to(out, params);
+  }
 };
 
 } // namespace bee
@@ -0,0 +1,260 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "file_writer.hpp"
+#include "format.hpp"
+
+namespace bee {
+namespace {
+
+struct Event {
+  std::atomic<const char*> name = nullptr;
+  std::atomic<int64_t> start_nanos = 0;
+  std::atomic<int64_t> duration_nanos = 0;
+};
+
+struct ThreadBuffer {
+ public:
+  explicit ThreadBuffer(int tid) : tid(tid) {}
+
+  const int tid;
+
+  // Owned by the thread, replaced when a recording starts with a different
+  // size. Readers hold the mutex of the recorder, which the thread also takes
+  // to replace them.
+  std::atomic<std::vector<Event>*> events = nullptr;
+  std::unique_ptr<std::vector<Event>> events_storage;
+
+  // Number of events written since the recording started, and number of
+  // slots claimed for writing, which is one more while an event is written
+  std::atomic<uint64_t> head = 0;
+  std::atomic<uint64_t> claimed = 0;
+  std::atomic<uint64_t> generation = 0;
+};
+
+struct Copy {
+  const char* name;
+  int64_t start_nanos;
+  int64_t duration_nanos;
+  int tid;
+};
+
+struct Recorder {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> threads;
+  // Latest events of the threads that exited during the recording
+  std::deque<Copy> exited;
+
+  std::atomic<uint64_t> generation = 0;
+  std::atomic<size_t> events_per_thread = 0;
+  std::atomic<int64_t> origin_nanos = 0;
+};
+
+Recorder& recorder()
+{
+  // Never destroyed, threads may still record during static destruction
+  static Recorder* recorder = new Recorder();
+  return *recorder;
+}
+
+// Appends the events of the current recording in buffer to out, without the
+// ones the thread overwrote while they were copied. Called with the mutex of
+// the recorder held.
+void copy_events(
+  const ThreadBuffer& buffer, uint64_t generation, std::vector<Copy>& out)
+{
+  if (buffer.generation.load(std::memory_order_acquire) != generation) {
+    return;
+  }
+  auto& events = *buffer.events.load(std::memory_order_acquire);
+  uint64_t size = events.size();
+  uint64_t head = buffer.head.load(std::memory_order_acquire);
+  uint64_t begin = head > size ? head - size : 0;
+  size_t first = out.size();
+  for (uint64_t i = begin; i < head; i++) {
+    auto& event = events[i % size];
+    out.push_back({
+      .name = event.name.load(std::memory_order_relaxed),
+      .start_nanos = event.start_nanos.load(std::memory_order_relaxed),
+      .duration_nanos = event.duration_nanos.load(std::memory_order_relaxed),
+      .tid = buffer.tid,
+    });
+  }
+  // Slots the thread claimed again while they were copied may be torn, and
+  // a new recording may have started over
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (buffer.generation.load(std::memory_order_relaxed) != generation) {
+    out.resize(first);
+    return;
+  }
+  uint64_t claimed = buffer.claimed.load(std::memory_order_relaxed);
+  uint64_t valid_from = claimed > size ? claimed - size : 0;
+  if (valid_from > begin) {
+    size_t torn = std::min(valid_from, head) - begin;
+    out.erase(out.begin() + first, out.begin() + first + torn);
+  }
+}
+
+thread_local ThreadBuffer* current_buffer = nullptr;
+
+// Frees the buffer of a thread when it exits, after moving its events to the
+// events of the exited threads
+struct BufferOwner {
+ public:
+  ThreadBuffer* buffer = nullptr;
+
+  ~BufferOwner()
+  {
+    current_buffer = nullptr;
+    auto& r = recorder();
+    std::unique_lock lk(r.mutex);
+    std::vector<Copy> copies;
+    copy_events(*buffer, r.generation.load(), copies);
+    r.exited.insert(r.exited.end(), copies.begin(), copies.end());
+    size_t max_size = r.events_per_thread.load();
+    while (r.exited.size() > max_size) { r.exited.pop_front(); }
+    std::erase_if(
+      r.threads, [&](const auto& b) { return b.get() == buffer; });
+  }
+};
+
+ThreadBuffer& thread_buffer()
+{
+  if (current_buffer == nullptr) [[unlikely]] {
+    static thread_local BufferOwner owner;
+    auto buffer = std::make_unique<ThreadBuffer>(::syscall(SYS_gettid));
+    owner.buffer = buffer.get();
+    current_buffer = buffer.get();
+    auto& r = recorder();
+    std::unique_lock lk(r.mutex);
+    r.threads.push_back(std::move(buffer));
+  }
+  return *current_buffer;
+}
+
+void append_json_string(std::string& out, const char* str)
+{
+  out += '"';
+  for (const char* c = str; *c != 0; c++) {
+    if (*c == '"' || *c == '\\') {
+      out += '\\';
+      out += *c;
+    } else if (uint8_t(*c) < 0x20) {
+      out += "\\u00";
+      out += "0123456789abcdef"[*c >> 4];
+      out += "0123456789abcdef"[*c & 0xf];
+    } else {
+      out += *c;
+    }
+  }
+  out += '"';
+}
+
+// Microseconds with nanosecond precision, the unit of the format
+std::string micros(int64_t nanos) { return F("{.3f}", nanos / 1000.0); }
+
+} // namespace
+
+std::atomic<bool> Trace::_recording = false;
+
+void Trace::start(size_t events_per_thread)
+{
+  auto& r = recorder();
+  std::unique_lock lk(r.mutex);
+  r.events_per_thread = std::max<size_t>(events_per_thread, 1);
+  r.origin_nanos = Time::monotonic().to_nanos_since_epoch();
+  // Threads notice the new generation on their next event and start over
+  r.generation++;
+  r.exited.clear();
+  _recording = true;
+}
+
+void Trace::stop() { _recording = false; }
+
+void Trace::record(const char* name, Time start, Span duration)
+{
+  auto& r = recorder();
+  auto& buffer = thread_buffer();
+  uint64_t generation = r.generation.load(std::memory_order_acquire);
+  if (buffer.generation.load(std::memory_order_relaxed) != generation) {
+    size_t size = r.events_per_thread.load(std::memory_order_relaxed);
+    auto* events = buffer.events.load(std::memory_order_relaxed);
+    if (events == nullptr || events->size() != size) {
+      std::unique_lock lk(r.mutex);
+      buffer.events_storage = std::make_unique<std::vector<Event>>(size);
+      events = buffer.events_storage.get();
+    }
+    buffer.head.store(0, std::memory_order_relaxed);
+    buffer.claimed.store(0, std::memory_order_relaxed);
+    buffer.events.store(events, std::memory_order_release);
+    buffer.generation.store(generation, std::memory_order_release);
+  }
+  auto& events = *buffer.events.load(std::memory_order_relaxed);
+  uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  // Readers that see any of the writes below also see the slot claimed, and
+  // drop the event that was in it
+  buffer.claimed.store(head + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  auto& event = events[head % events.size()];
+  event.name.store(name, std::memory_order_relaxed);
+  event.start_nanos.store(
+    start.to_nanos_since_epoch(), std::memory_order_relaxed);
+  event.duration_nanos.store(duration.to_nanos(), std::memory_order_relaxed);
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+std::string Trace::to_chrome_trace()
+{
+  auto& r = recorder();
+  std::unique_lock lk(r.mutex);
+  uint64_t generation = r.generation.load(std::memory_order_acquire);
+  int64_t origin = r.origin_nanos.load();
+  int pid = ::getpid();
+
+  std::vector<Copy> copies;
+  for (const auto& buffer : r.threads) {
+    copy_events(*buffer, generation, copies);
+  }
+  copies.insert(copies.end(), r.exited.begin(), r.exited.end());
+
+  std::string out = "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& copy : copies) {
+    out += first ? "\n" : ",\n";
+    first = false;
+    out += "{\"name\":";
+    append_json_string(out, copy.name);
+    out += F(
+      ",\"ph\":\"X\",\"ts\":$,\"dur\":$,\"pid\":$,\"tid\":$}",
+      micros(copy.start_nanos - origin),
+      micros(copy.duration_nanos),
+      pid,
+      copy.tid);
+  }
+  out += "\n],\"displayTimeUnit\":\"ns\"}\n";
+  return out;
+}
+
+OrError<> Trace::write_chrome_trace(Writer& writer)
+{
+  bail_unit(writer.write(to_chrome_trace()));
+  return ok();
+}
+
+OrError<> Trace::write_chrome_trace(const FilePath& path)
+{
+  bail(writer, FileWriter::create(path));
+  bail_unit(write_chrome_trace(*writer));
+  bail_unit(writer->flush());
+  return ok();
+}
+
+} // namespace bee
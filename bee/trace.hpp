@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+#include "file_path.hpp"
+#include "or_error.hpp"
+#include "span.hpp"
+#include "time.hpp"
+#include "writer.hpp"
+
+namespace bee {
+
+// Records timed scopes into per thread ring buffers and writes them out in the
+// Chrome trace event format, which chrome://tracing and Perfetto open.
+// SimpleTimer scopes and named TimeBlocks are recorded while recording is on.
+// When it is off, recording a scope is a single relaxed load.
+//
+// A thread only writes its own buffer, and keeps its latest events once the
+// buffer is full. When a thread exits its buffer is freed, its events move to
+// a buffer shared by the threads that exited, which keeps the latest ones the
+// same way. The buffers can be written out while recording, events
+// overwritten while they are being read are dropped.
+struct Trace {
+ public:
+  // Starts recording, dropping everything recorded before
+  static void start(size_t events_per_thread = 1 << 16);
+  static void stop();
+
+  static bool is_recording()
+  {
+    return _recording.load(std::memory_order_relaxed);
+  }
+
+  // The name is not copied, it has to outlive the trace
+  static void record(const char* name, Time start, Span duration);
+
+  static OrError<> write_chrome_trace(Writer& writer);
+  static OrError<> write_chrome_trace(const FilePath& path);
+  static std::string to_chrome_trace();
+
+ private:
+  static std::atomic<bool> _recording;
+};
+
+} // namespace bee
@@ -0,0 +1,141 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "file_reader.hpp"
+#include "format_vector.hpp"
+#include "scoped_tmp_dir.hpp"
+#include "simple_timer.hpp"
+#include "testing.hpp"
+#include "time_block.hpp"
+
+using std::string;
+using std::vector;
+
+namespace bee {
+namespace {
+
+vector<string> event_names(const string& trace)
+{
+  vector<string> names;
+  const string key = "{\"name\":\"";
+  for (size_t pos = trace.find(key); pos != string::npos;
+       pos = trace.find(key, pos + 1)) {
+    size_t begin = pos + key.size();
+    names.push_back(trace.substr(begin, trace.find('"', begin) - begin));
+  }
+  return names;
+}
+
+auto step_timer = SimpleTimer::create_timer("step");
+
+TEST(record_scopes)
+{
+  { auto scope = step_timer(); }
+  Trace::start();
+  P("recording: $", Trace::is_recording());
+  {
+    auto scope = step_timer();
+    TimeBlock block("block", [](Span) {});
+  }
+  std::thread([]() { auto scope = step_timer(); }).join();
+  Trace::stop();
+  { auto scope = step_timer(); }
+  auto trace = Trace::to_chrome_trace();
+  P("events: $", event_names(trace));
+  P("complete events: $", trace.find("\"ph\":\"X\"") != string::npos);
+  SimpleTimer::reset_all();
+}
+
+TEST(ring_buffer)
+{
+  const char* names[] = {"e0", "e1", "e2", "e3", "e4", "e5", "e6"};
+  Trace::start(4);
+  for (const char* name : names) {
+    Trace::record(name, Time::monotonic(), Span::of_micros(1.5));
+  }
+  Trace::stop();
+  auto trace = Trace::to_chrome_trace();
+  P("kept: $", event_names(trace));
+  P("duration: $", trace.find("\"dur\":1.5,") != string::npos);
+
+  // A new recording drops what was recorded before
+  Trace::start(4);
+  Trace::stop();
+  P("after restart: $", event_names(Trace::to_chrome_trace()));
+}
+
+// The writer keeps overwriting a small buffer while it is read. An event's
+// duration in micros matches the digit in its name, and the slot's previous
+// event had another digit, so a torn event shows as a mismatch.
+TEST(concurrent_writer)
+{
+  const char* names[] = {"n0", "n1", "n2", "n3", "n4", "n5", "n6", "n7"};
+  Trace::start(5);
+  std::atomic<bool> done = false;
+  std::thread writer([&]() {
+    for (int i = 0; !done; i++) {
+      Trace::record(names[i % 8], Time::monotonic(), Span::of_micros(i % 8));
+    }
+  });
+  int events = 0;
+  int torn = 0;
+  auto until = Time::monotonic() + Span::of_millis(200);
+  while (Time::monotonic() < until || events == 0) {
+    auto trace = Trace::to_chrome_trace();
+    const string key = "{\"name\":\"n";
+    for (size_t pos = trace.find(key); pos != string::npos;
+         pos = trace.find(key, pos + 1)) {
+      char digit = trace[pos + key.size()];
+      size_t dur = trace.find("\"dur\":", pos) + 6;
+      events++;
+      if (trace[dur] != digit) { torn++; }
+    }
+  }
+  done = true;
+  writer.join();
+  Trace::stop();
+  P("read events: $", events > 0);
+  P("torn events: $", torn);
+}
+
+TEST(exited_threads)
+{
+  // Threads that exited share one buffer, with their latest events
+  const char* names[] = {"t0", "t1", "t2", "t3", "t4", "t5"};
+  Trace::start(4);
+  for (const char* name : names) {
+    std::thread([name]() {
+      Trace::record(name, Time::monotonic(), Span::zero());
+    }).join();
+  }
+  Trace::record("main", Time::monotonic(), Span::zero());
+  Trace::stop();
+  P("events: $", event_names(Trace::to_chrome_trace()));
+}
+
+TEST(escape)
+{
+  Trace::start();
+  Trace::record("quote\" back\\slash\n", Time::monotonic(), Span::zero());
+  Trace::stop();
+  auto trace = Trace::to_chrome_trace();
+  P(trace.substr(trace.find("{\"name\""), 35));
+}
+
+TEST(write_file)
+{
+  must(dir, ScopedTmpDir::create());
+  auto path = dir.path() / "trace.json";
+  Trace::start();
+  Trace::record("written", Time::monotonic(), Span::zero());
+  Trace::stop();
+  must_unit(Trace::write_chrome_trace(path));
+  must(content, FileReader::read_file(path));
+  P("events: $", event_names(content));
+}
+
+} // namespace
+} // namespace bee
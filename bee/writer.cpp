@@ -17,11 +17,24 @@ OrError<size_t> Writer::write(const std::vector<std::byte>& data)
 }
 
 OrError<size_t> Writer::write(const DataBuffer& data)
+{
+  return write_raw_blocks(data);
+}
+
+OrError<size_t> Writer::write_raw_blocks(const DataBuffer& data)
 {
   size_t written = 0;
   for (const auto& block : data) {
-    bail_unit(write(block.data(), block.size()));
-    written += block.size();
+    size_t written_in_block = 0;
+    while (written_in_block < block.size()) {
+      bail(
+        ret,
+        write_raw(
+          block.data() + written_in_block, block.size() - written_in_block));
+      if (ret == 0) { return written + written_in_block; }
+      written_in_block += ret;
+    }
+    written += written_in_block;
   }
   return written;
 }
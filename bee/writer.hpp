@@ -18,6 +18,8 @@ struct Writer {
   OrError<size_t> write(const char* data, size_t size);
   OrError<size_t> write(const char* data);
   OrError<size_t> write(const std::vector<std::byte>& data);
+  // Returns the number of bytes written, which can be less than data.size()
+  // when writing would block. It doesn't consume data.
   OrError<size_t> write(const DataBuffer& data);
   OrError<size_t> write(const std::string& data);
 
@@ -25,6 +27,10 @@ struct Writer {
 
  protected:
   virtual OrError<size_t> write_raw(const std::byte* data, size_t size) = 0;
+
+  // Writes every block in data, by default by calling write_raw once per
+  // block. Writers that can do better, like FD with writev, override it.
+  virtual OrError<size_t> write_raw_blocks(const DataBuffer& data);
 };
 
 } // namespace bee